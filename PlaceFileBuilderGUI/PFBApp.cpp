@@ -1925,6 +1925,10 @@ void PFBApp::exportPlaceFileAction_()
       {
         status = future.wait_for(chrono::milliseconds(50));
       }
+
+      // Rethrow anything savePlaceFile threw, such as a file it could not
+      // replace.
+      future.get();
     }
     catch (const runtime_error& e)
     {
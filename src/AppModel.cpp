@@ -9,10 +9,16 @@
 #include <string>
 #include <stdexcept>
 #include <cstdlib>
+#include <thread>
 
 #include "PlaceFileColor.hpp"
 #include "OGR_RangeRing.hpp"
+#include "LayerReader.hpp"
+#include "SpillFile.hpp"
 
+#include "cpl_conv.h"
+#include "cpl_string.h"
+#include "cpl_vsi.h"
 #include "ogrsf_frmts.h"
 #include "ogr_api.h"
 
@@ -22,10 +28,16 @@ AppModel::AppModel()
 {
   // Initialize GDAL/OGR
   OGRRegisterAll();
+
+  // Spill files from a run that did not exit cleanly
+  SpillFile::removeStale();
 }
 
 AppModel::~AppModel()
 {
+  // Removes the spill files the kept layers use
+  layerCache_.clear();
+
   // Clean up GDAL/OGR
   OGRCleanupAll();
 }
@@ -202,23 +214,54 @@ void AppModel::savePlaceFile(const string& fileName)
   pf.setTitle(pfTitle_);
   if (refreshSeconds_ > 0) pf.setRefreshSeconds(refreshSeconds_);
   else pf.setRefreshMinutes(refreshMinutes_);
+  pf.setGroupByStyle(groupByStyle_);
+  pf.setHilbertOrder(hilbertOrder_);
+  pf.setFormatEarly(true);
+  if (spillToDisk_) pf.setSpillPath(SpillFile::tempPrefix());
+  pf.setPrecision(pfPrecision_);
+  const ClipRegion clip = getClipRegion();
+  pf.setClipRegion(clip);
+
+  // Layers that have not changed since the last save reuse the text kept from
+  // then. Remember where each layer went to keep its text for next time.
+  pf.setKeepFormattedLayers(true);
+  struct SavedLayer
+  {
+    string cacheId;
+    string key;
+    size_t index;
+  };
+  vector<SavedLayer> savedLayers;
+
+  // The save is a pipeline. Layers are read and transformed on worker
+  // threads, see LayerReader, this thread turns them into features, and each
+  // layer is formatted on other workers once it ends while the next is
+  // built. Each stage only gets a little ahead of the next. Work out which
+  // layers need reading first, those kept from the last save fill in between.
+  struct LayerStep
+  {
+    const string* layerName;
+    const LayerOptions* options;
+    string cacheId;
+    string key;
+    bool cached;
+    size_t job;
+  };
+  vector<LayerStep> steps;
+  LayerReader reader(clip, transformError_);
 
-  // Add the requested layers
   for(auto sIt = srcs_.begin(); sIt != srcs_.end(); ++sIt)
   {
     const string& srcName = sIt->first;
+    const string& path = get<IDX_path>(sIt->second);
     const LayerInfo& lyrs = get<IDX_layerInfo>(sIt->second);
 
-    OGRDataSourceWrapper& src = get<IDX_ogrData>(sIt->second);
+    reader.lend(path, &*get<IDX_ogrData>(sIt->second));
 
     for(auto lIt = lyrs.begin(); lIt != lyrs.end(); ++lIt)
     {
-      const string& layerName     = lIt->first;
-      const string& labelField    = lIt->second.labelField;
-      const PlaceFileColor& color = lIt->second.color;
-      const int& lineWidth        = lIt->second.lineWidth;
-      const bool polyAsLine       = lIt->second.polyAsLine;
-      const int displayThresh     = lIt->second.displayThresh;
+      const string& layerName = lIt->first;
+      const string& labelField = lIt->second.labelField;
 
       /*
       cerr << "srcName " << srcName << endl;
@@ -228,41 +271,62 @@ void AppModel::savePlaceFile(const string& fileName)
 
       if (labelField == DO_NOT_USE_LAYER) continue;
 
-      OGRLayer *layer = src->GetLayerByName(layerName.c_str());
-
-      // Check for a transform for this layer
-      OGRCoordinateTransformation *trans = nullptr;
-      OGRSpatialReference *srcCS = layer->GetSpatialRef();
-      OGRSpatialReference trgtCS;
-      trgtCS.SetWellKnownGeogCS("WGS84");
-      if (srcCS != nullptr)
+      LayerStep step{ &layerName, &lIt->second, srcName + "\n" + layerName, 
+        layerKey_(path, lIt->second), false, 0 };
+      auto cached = layerCache_.find(step.cacheId);
+      step.cached = cached != layerCache_.end() && cached->second.key == step.key;
+      if (!step.cached)
       {
-        trans = OGRCreateCoordinateTransformation(srcCS, &trgtCS);
-        if (trans == nullptr && srcCS->IsProjected()) // Failure!!
-        {
-          throw runtime_error(
-            string("Unable to create coordinate transformation for source ") + 
-            srcName + " and layer " + layerName);
-        }
+        step.job = reader.addJob(LayerReader::Job{ path, srcName, layerName, 
+          labelField == NO_LABEL ? string() : labelField });
       }
+      steps.push_back(move(step));
+    }
+  }
 
-      layer->ResetReading();
-      OGRFeatureWrapper feature;
-      while(feature = layer->GetNextFeature())
-      {
-        string label;
-        
-        if (labelField == NO_LABEL) label = "";
-        else label = feature->GetFieldAsString(labelField.c_str());
+  unsigned int numThreads = thread::hardware_concurrency();
+  if (numThreads == 0) numThreads = 1;
+  reader.start(parallelRead_ ? numThreads : 1);
 
-        OGRGeometry *geo = feature->GetGeometryRef();
+  // Add the requested layers
+  for (const LayerStep& step : steps)
+  {
+    const string& layerName = *step.layerName;
+    const LayerOptions& options = *step.options;
 
-        pf.addOGRGeometry(label, color, *geo, trans, polyAsLine, displayThresh, lineWidth);
-      }
+    if (step.cached)
+    {
+      const size_t index = 
+        pf.addFormattedLayer(layerName, layerCache_.at(step.cacheId).formatted);
+      savedLayers.push_back(SavedLayer{ step.cacheId, step.key, index });
+      continue;
+    }
 
-      if(trans != nullptr) 
+    const PlaceFileColor& color = options.color;
+    const int& lineWidth        = options.lineWidth;
+    const bool polyAsLine       = options.polyAsLine;
+    const int displayThresh     = options.displayThresh;
+
+    GeometryOptions geo;
+    geo.simplify = options.simplify;
+    geo.toleranceMeters = options.simplifyTolerance;
+    geo.detailThresholds = options.detailThresholds;
+    geo.preserveTopology = options.preserveTopology;
+    geo.shareEdges = options.shareEdges;
+    geo.labelSharedEdges = options.labelSharedEdges;
+    geo.mergeLines = options.mergeLines;
+    geo.cleanVertices = options.cleanVertices;
+
+    savedLayers.push_back(
+      SavedLayer{ step.cacheId, step.key, pf.beginLayer(layerName, options.precision) });
+
+    LayerReader::Batch batch;
+    while (reader.next(step.job, batch))
+    {
+      for (size_t i = 0; i != batch.geometries.size(); ++i)
       {
-        OGRCoordinateTransformation::DestroyCT(trans);
+        pf.addOGRGeometry(batch.labels[i], color, *batch.geometries[i], nullptr, polyAsLine, 
+          displayThresh, lineWidth, geo);
       }
     }
   }
@@ -274,16 +338,146 @@ void AppModel::savePlaceFile(const string& fileName)
     const auto& dispThresh = options.displayThresh;
     const auto& lw = options.lineWidth;
     const auto& clr = options.color;
+
+    const string cacheId = RangeRingSrc + "\n" + rrIt->first.name();
+    const string key = rangeRingKey_(rrIt->first, options);
+    auto cached = layerCache_.find(cacheId);
+    if (cached != layerCache_.end() && cached->second.key == key)
+    {
+      const size_t index = 
+        pf.addFormattedLayer(rrIt->first.name(), cached->second.formatted);
+      savedLayers.push_back(SavedLayer{ cacheId, key, index });
+      continue;
+    }
+
     auto features = rrIt->first.getPlaceFileFeatures(dispThresh, lw, clr);
 
+    savedLayers.push_back(
+      SavedLayer{ cacheId, key, pf.beginLayer(rrIt->first.name(), options.precision) });
+
     for(size_t i = 0; i < features.size(); ++i) pf.addFeature(move(features[i]));
   }
 
-  // Save the file
-  pf.saveFile(fileName);
+  // Save the file, leaving it alone if nothing changed since the last save.
+  const uint64_t previousHash = 
+    fileName == lastPlaceFileSaved_ ? lastSaveStats_.hash : 0;
+  pf.saveFile(fileName, saveOutput_, previousHash);
 
-  // Remember saving it!
+  // Remember saving it! Only layers in this file are kept.
   lastPlaceFileSaved_ = fileName;
+  lastSaveStats_ = pf.getSaveStats();
+
+  unordered_map<string, CachedLayer> cache;
+  for (const SavedLayer& saved : savedLayers)
+  {
+    cache[saved.cacheId] = CachedLayer{ saved.key, pf.getFormattedLayer(saved.index) };
+  }
+  layerCache_ = move(cache);
+}
+
+namespace
+{
+  // The newest modification time, total size and number of the files a
+  // source is read from. A shapefile is several files with the same name,
+  // and editing the labels only touches the .dbf. A directory source, such
+  // as a file geodatabase, changes the files inside it but not the directory.
+  string sourceStamp(const string& path)
+  {
+    VSIStatBufL stat;
+    if (VSIStatL(path.c_str(), &stat) != 0) return string();
+
+    vector<string> files;
+    if (VSI_ISDIR(stat.st_mode))
+    {
+      char **names = VSIReadDirRecursive(path.c_str());
+      for (int i = 0; names && names[i]; ++i)
+      {
+        files.push_back(CPLFormFilename(path.c_str(), names[i], nullptr));
+      }
+      CSLDestroy(names);
+    }
+    else
+    {
+      const string dir = CPLGetPath(path.c_str());
+      const string base = CPLGetBasename(path.c_str());
+      char **names = VSIReadDir(dir.empty() ? "." : dir.c_str());
+      for (int i = 0; names && names[i]; ++i)
+      {
+        if (EQUAL(CPLGetBasename(names[i]), base.c_str()))
+        {
+          files.push_back(CPLFormFilename(dir.c_str(), names[i], nullptr));
+        }
+      }
+      CSLDestroy(names);
+      if (files.empty()) files.push_back(path);
+    }
+
+    long long newest = 0, size = 0;
+    int count = 0;
+    for (const string& file : files)
+    {
+      if (VSIStatL(file.c_str(), &stat) != 0 || VSI_ISDIR(stat.st_mode)) continue;
+      newest = max(newest, static_cast<long long>(stat.st_mtime));
+      size += static_cast<long long>(stat.st_size);
+      ++count;
+    }
+
+    ostringstream stamp;
+    stamp << newest << " " << size << " " << count;
+    return stamp.str();
+  }
+}
+
+string AppModel::layerKey_(const string& path, const LayerOptions& opts)
+{
+  // The files changing on disk change the key.
+  ostringstream key;
+  key.precision(17);
+  key << path << "\n" << sourceStamp(path) << "\n" << opts.labelField << "\n" << 
+    opts.color.getPlaceFileColorString() << "\n" << opts.lineWidth << " " << opts.polyAsLine << " " <<
+    opts.displayThresh << " " << opts.precision << " " << pfPrecision_ << " " <<
+    groupByStyle_ << " " << hilbertOrder_ << " " << static_cast<int>(opts.simplify) << " " << 
+    opts.simplifyTolerance << " " << transformError_;
+  key << " " << opts.preserveTopology << " " << opts.shareEdges << " " << 
+    opts.labelSharedEdges << " " << opts.mergeLines << " " << opts.cleanVertices;
+  for (const int thresh : opts.detailThresholds) key << " " << thresh;
+  const ClipRegion clip = getClipRegion();
+  if (clip.isSet())
+  {
+    key << "\n" << clip.south() << " " << clip.west() << " " << clip.north() << " " << 
+      clip.east();
+  }
+  return key.str();
+}
+
+string AppModel::rangeRingKey_(const RangeRing& rr, const LayerOptions& opts)
+{
+  ostringstream key;
+  key.precision(17);
+  key << rr.name() << "\n" << rr.getCenterPoint().latitude << " " << rr.getCenterPoint().longitude;
+  for (const double rng : rr.getRanges()) key << " " << rng;
+  key << "\n" << opts.color.getPlaceFileColorString() << "\n" << opts.lineWidth << " " << 
+    opts.displayThresh << " " << opts.precision << " " << pfPrecision_ << " " <<
+    groupByStyle_ << " " << hilbertOrder_;
+  return key.str();
+}
+
+ClipRegion AppModel::getClipRegion()
+{
+  if (clipRangeRing_.empty()) return clipBox_;
+
+  for (const RRPair& rr : rangeRings_)
+  {
+    const vector<double>& ranges = rr.first.getRanges();
+    if (rr.first.name() == clipRangeRing_ && !ranges.empty())
+    {
+      return ClipRegion::around(rr.first.getCenterPoint(), 
+        *max_element(ranges.begin(), ranges.end()));
+    }
+  }
+
+  // The range ring was removed or has no rings, do not clip.
+  return ClipRegion();
 }
 
 int AppModel::getRefreshMinutes() { return refreshMinutes_; }
@@ -617,6 +811,132 @@ void AppModel::setLineWidth(const string& source, const string& layer, int lw)
   }
 }
 
+int AppModel::getLayerPrecision(const string& source, const string& layer) 
+{ 
+  if(source == RangeRingSrc)
+  {
+    // Find the layer
+    auto start = rangeRings_.cbegin();
+    auto end = rangeRings_.cend();
+    auto lyr = find_if(start, end, [&layer](RRPair pp)->bool{ return pp.first.name() == layer; } );
+    
+    // Get the value if found, throw otherwise.
+    if(lyr != end) return get<1>(*lyr).precision;
+    else throw out_of_range("No such range ring.");
+  }
+
+  return get<IDX_layerInfo>(srcs_.at(source)).at(layer).precision; 
+}
+
+void AppModel::setLayerPrecision(const string& source, const string& layer, int precision)
+{
+  if(source == RangeRingSrc)
+  {
+    // Find the layer
+    auto start = rangeRings_.begin();
+    auto end = rangeRings_.end();
+    auto lyr = find_if(start, end, [&layer](RRPair pp)->bool{ return pp.first.name() == layer; } );
+    
+    // Set the value if found, throw otherwise.
+    if(lyr != end)
+    {
+      auto& opts = get<1>(*lyr);
+      opts.precision = precision;
+    }
+    else
+    {
+      throw out_of_range("No such range ring.");
+    }
+  }
+  else
+  {
+    auto& opts = get<IDX_layerInfo>(srcs_.at(source)).at(layer);
+    opts.precision = precision;
+  }
+}
+
+SimplifyMethod AppModel::getSimplifyMethod(const string& source, const string& layer)
+{
+  return get<IDX_layerInfo>(srcs_.at(source)).at(layer).simplify;
+}
+
+void AppModel::setSimplifyMethod(const string& source, const string& layer, 
+  SimplifyMethod method)
+{
+  get<IDX_layerInfo>(srcs_.at(source)).at(layer).simplify = method;
+}
+
+double AppModel::getSimplifyTolerance(const string& source, const string& layer)
+{
+  return get<IDX_layerInfo>(srcs_.at(source)).at(layer).simplifyTolerance;
+}
+
+void AppModel::setSimplifyTolerance(const string& source, const string& layer, double meters)
+{
+  get<IDX_layerInfo>(srcs_.at(source)).at(layer).simplifyTolerance = meters;
+}
+
+vector<int> AppModel::getDetailThresholds(const string& source, const string& layer)
+{
+  return get<IDX_layerInfo>(srcs_.at(source)).at(layer).detailThresholds;
+}
+
+void AppModel::setDetailThresholds(const string& source, const string& layer, 
+  const vector<int>& thresholds)
+{
+  get<IDX_layerInfo>(srcs_.at(source)).at(layer).detailThresholds = thresholds;
+}
+
+bool AppModel::getPreserveTopology(const string& source, const string& layer)
+{
+  return get<IDX_layerInfo>(srcs_.at(source)).at(layer).preserveTopology;
+}
+
+void AppModel::setPreserveTopology(const string& source, const string& layer, bool preserve)
+{
+  get<IDX_layerInfo>(srcs_.at(source)).at(layer).preserveTopology = preserve;
+}
+
+bool AppModel::getShareEdges(const string& source, const string& layer)
+{
+  return get<IDX_layerInfo>(srcs_.at(source)).at(layer).shareEdges;
+}
+
+void AppModel::setShareEdges(const string& source, const string& layer, bool share)
+{
+  get<IDX_layerInfo>(srcs_.at(source)).at(layer).shareEdges = share;
+}
+
+bool AppModel::getLabelSharedEdges(const string& source, const string& layer)
+{
+  return get<IDX_layerInfo>(srcs_.at(source)).at(layer).labelSharedEdges;
+}
+
+void AppModel::setLabelSharedEdges(const string& source, const string& layer, bool label)
+{
+  get<IDX_layerInfo>(srcs_.at(source)).at(layer).labelSharedEdges = label;
+}
+
+bool AppModel::getMergeLines(const string& source, const string& layer)
+{
+  return get<IDX_layerInfo>(srcs_.at(source)).at(layer).mergeLines;
+}
+
+void AppModel::setMergeLines(const string& source, const string& layer, bool merge)
+{
+  get<IDX_layerInfo>(srcs_.at(source)).at(layer).mergeLines = merge;
+}
+
+bool AppModel::getCleanVertices(const string& source, const string& layer)
+{
+  return get<IDX_layerInfo>(srcs_.at(source)).at(layer).cleanVertices;
+}
+
+void AppModel::setCleanVertices(const string& source, const string& layer, bool clean)
+{
+  get<IDX_layerInfo>(srcs_.at(source)).at(layer).cleanVertices = clean;
+}
+
 point AppModel::getRangeRingCenter(const string& source, const string& layer)
 {
   if(source == RangeRingSrc)
@@ -954,26 +1274,43 @@ void AppModel::saveState(const string& pathToStateFile)
          3:  refreshMinutes: integer
          4:  refreshSeconds: integer
          5:  title: title text
-         6:  Source Start: srcName
-         7:  Path: path to file
-         8:  Layer Start: layerName
-         9:  labelField: labelField
-        10:  color: rrr ggg bbb
-        11:  lineWidth: integer
-        12:  polyAsLine: True (or False)
-        13:  visible: True (or False)
-        14:  displayThresh: integer value
-        15:  Layer End: layerName
-        16:  .......
+         6:  groupByStyle: True (or False)
+         7:  precision: integer (-1 full, -2 auto, else decimal places)
+         8:  saveOutput: Plain, Gzip, or Both
+         9:  clip: None, Box south west north east, or RangeRing name
+        10:  hilbertOrder: True (or False)
+        11:  transformError: meters (0 for exact)
+        12:  parallelRead: True (or False)
+        13:  spillToDisk: True (or False)
+        14:  Source Start: srcName
+        15:  Path: path to file
+        16:  Layer Start: layerName
+        17:  labelField: labelField
+        18:  color: rrr ggg bbb
+        19:  lineWidth: integer
+        20:  polyAsLine: True (or False)
+        21:  visible: True (or False)
+        22:  displayThresh: integer value
+        23:  precision: integer (-3 use placefile precision)
+        24:  simplify: None, DP, or VW
+        25:  simplifyTolerance: meters
+        26:  detailThresholds: thresh1 thresh2 ...
+        27:  preserveTopology: True (or False)
+        28:  shareEdges: True (or False)
+        29:  labelSharedEdges: True (or False)
+        30:  mergeLines: True (or False)
+        31:  cleanVertices: True (or False)
+        32:  Layer End: layerName
+        33:  .......
         . :
         . :
-        . :  repeat 8-15 for each layer
+        . :  repeat 16-32 for each layer
         . :
         . :
         m :  Source End: srcName
         . :
         . :
-        n :  Repeat 6-m for each source
+        n :  Repeat 14-m for each source
         . :
         . :
         p :  Range Ring: name
@@ -982,6 +1319,7 @@ void AppModel::saveState(const string& pathToStateFile)
         . :  color: rrr ggg bbb
         . :  lineWidth: integer
         . :  displayThresh: integer value
+        . :  precision: integer (-3 use placefile precision)
         q :  Range Ring End:
         . :
         . :
@@ -1004,6 +1342,22 @@ void AppModel::saveState(const string& pathToStateFile)
       statefile << "refreshMinutes: " << refreshMinutes_ << "\n";
       statefile << "refreshSeconds: " << refreshSeconds_ << "\n";
       statefile << "title: " << pfTitle_ << "\n";
+      statefile << "groupByStyle: " << (groupByStyle_ ? "True" : "False") << "\n";
+      statefile << "precision: " << pfPrecision_ << "\n";
+      statefile << "saveOutput: " << 
+        (saveOutput_ == PlaceFile::Output::GZIP ? "Gzip" :
+         saveOutput_ == PlaceFile::Output::PLAIN_AND_GZIP ? "Both" : "Plain") << "\n";
+      if (!clipRangeRing_.empty()) statefile << "clip: RangeRing " << clipRangeRing_ << "\n";
+      else if (clipBox_.isSet())
+      {
+        statefile << "clip: Box " << setprecision(17) << clipBox_.south() << " " << 
+          clipBox_.west() << " " << clipBox_.north() << " " << clipBox_.east() << "\n";
+      }
+      else statefile << "clip: None\n";
+      statefile << "hilbertOrder: " << (hilbertOrder_ ? "True" : "False") << "\n";
+      statefile << "transformError: " << transformError_ << "\n";
+      statefile << "parallelRead: " << (parallelRead_ ? "True" : "False") << "\n";
+      statefile << "spillToDisk: " << (spillToDisk_ ? "True" : "False") << "\n";
 
       for(auto srcIt = srcs_.begin(); srcIt != srcs_.end(); ++srcIt)
       {
@@ -1044,6 +1398,41 @@ void AppModel::saveState(const string& pathToStateFile)
           // displayThresh
           statefile << "displayThresh: " << lyrOpt.displayThresh << "\n";
 
+          // precision
+          statefile << "precision: " << lyrOpt.precision << "\n";
+
+          // simplification
+          statefile << "simplify: " <<
+            (lyrOpt.simplify == SimplifyMethod::DOUGLAS_PEUCKER ? "DP" :
+             lyrOpt.simplify == SimplifyMethod::VISVALINGAM_WHYATT ? "VW" : "None") << "\n";
+          statefile << "simplifyTolerance: " << lyrOpt.simplifyTolerance << "\n";
+
+          // detail thresholds
+          statefile << "detailThresholds: ";
+          for (const int thresh : lyrOpt.detailThresholds)
+          {
+            statefile << thresh << " ";
+          }
+          statefile << "\n";
+
+          // preserve topology
+          statefile << "preserveTopology: " << 
+            (lyrOpt.preserveTopology ? "True" : "False") << "\n";
+
+          // shared edges
+          statefile << "shareEdges: " << 
+            (lyrOpt.shareEdges ? "True" : "False") << "\n";
+          statefile << "labelSharedEdges: " << 
+            (lyrOpt.labelSharedEdges ? "True" : "False") << "\n";
+
+          // merged lines
+          statefile << "mergeLines: " << 
+            (lyrOpt.mergeLines ? "True" : "False") << "\n";
+
+          // vertex cleanup
+          statefile << "cleanVertices: " << 
+            (lyrOpt.cleanVertices ? "True" : "False") << "\n";
+
           statefile << "Layer End: " << lyrName << "\n";
         }
 
@@ -1084,6 +1473,9 @@ void AppModel::saveState(const string& pathToStateFile)
         // displayThresh
         statefile << "displayThresh: " << opt.displayThresh << "\n";
 
+        // precision
+        statefile << "precision: " << opt.precision << "\n";
+
         statefile << "Range Ring End: " << rr.name() << "\n";
       }
 
@@ -1210,6 +1602,65 @@ void AppModel::loadState(const string& pathToStateFile)
                   int dispThresh = atoi(line.substr(15).c_str());
                   setDisplayThreshold(srcName, lyrName, dispThresh);
                 }
+                // Parse precision
+                else if( line.find("precision: ") != string::npos )
+                {
+                  int precision = atoi(line.substr(11).c_str());
+                  setLayerPrecision(srcName, lyrName, precision);
+                }
+                // Parse simplification
+                else if( line.find("simplifyTolerance: ") != string::npos )
+                {
+                  double meters = atof(line.substr(19).c_str());
+                  setSimplifyTolerance(srcName, lyrName, meters);
+                }
+                else if( line.find("simplify: ") != string::npos )
+                {
+                  SimplifyMethod method = SimplifyMethod::NONE;
+                  if (line.find("DP") != string::npos) 
+                    method = SimplifyMethod::DOUGLAS_PEUCKER;
+                  else if (line.find("VW") != string::npos) 
+                    method = SimplifyMethod::VISVALINGAM_WHYATT;
+                  setSimplifyMethod(srcName, lyrName, method);
+                }
+                // Parse detail thresholds
+                else if( line.find("detailThresholds: ") != string::npos )
+                {
+                  stringstream threshStr(line.substr(18));
+                  vector<int> thresholds;
+                  int thresh;
+                  while (threshStr >> thresh) thresholds.push_back(thresh);
+                  setDetailThresholds(srcName, lyrName, thresholds);
+                }
+                // Parse preserve topology
+                else if( line.find("preserveTopology: ") != string::npos )
+                {
+                  bool preserve = line.find("True") != string::npos;
+                  setPreserveTopology(srcName, lyrName, preserve);
+                }
+                // Parse shared edges
+                else if( line.find("labelSharedEdges: ") != string::npos )
+                {
+                  bool label = line.find("True") != string::npos;
+                  setLabelSharedEdges(srcName, lyrName, label);
+                }
+                else if( line.find("shareEdges: ") != string::npos )
+                {
+                  bool share = line.find("True") != string::npos;
+                  setShareEdges(srcName, lyrName, share);
+                }
+                // Parse merged lines
+                else if( line.find("mergeLines: ") != string::npos )
+                {
+                  bool merge = line.find("True") != string::npos;
+                  setMergeLines(srcName, lyrName, merge);
+                }
+                // Parse vertex cleanup
+                else if( line.find("cleanVertices: ") != string::npos )
+                {
+                  bool clean = line.find("True") != string::npos;
+                  setCleanVertices(srcName, lyrName, clean);
+                }
                 // Get the next line and keep going, look for next parameter
                 getline(statefile, line);
               }
@@ -1302,6 +1753,12 @@ void AppModel::loadState(const string& pathToStateFile)
               opt.displayThresh = dispThresh;
             }
 
+            // Parse precision
+            else if (line.find("precision: ") != string::npos)
+            {
+              opt.precision = atoi(line.substr(11).c_str());
+            }
+
             // Get the next line
             getline(statefile, line);
           }
@@ -1325,6 +1782,70 @@ void AppModel::loadState(const string& pathToStateFile)
           pfTitle_ = line.substr(7);
         }
 
+        // Check for grouping by style
+        if (line.find("groupByStyle:") != string::npos)
+        {
+          groupByStyle_ = line.find("True") != string::npos;
+        }
+
+        // Check for coordinate precision, only at the start since a title
+        // could contain it.
+        if (line.find("precision:") == 0)
+        {
+          pfPrecision_ = atoi(line.substr(11).c_str());
+        }
+
+        // Check for which files to write
+        if (line.find("saveOutput:") == 0)
+        {
+          if (line.find("Gzip") != string::npos) saveOutput_ = PlaceFile::Output::GZIP;
+          else if (line.find("Both") != string::npos) 
+          {
+            saveOutput_ = PlaceFile::Output::PLAIN_AND_GZIP;
+          }
+          else saveOutput_ = PlaceFile::Output::PLAIN;
+        }
+
+        // Check for reading layers on several threads
+        if (line.find("parallelRead:") == 0)
+        {
+          parallelRead_ = line.find("True") != string::npos;
+        }
+
+        // Check for moving formatted text out to temporary files
+        if (line.find("spillToDisk:") == 0)
+        {
+          spillToDisk_ = line.find("True") != string::npos;
+        }
+
+        // Check for the approximate transformation error
+        if (line.find("transformError:") == 0)
+        {
+          setTransformError(atof(line.substr(15).c_str()));
+        }
+
+        // Check for sorting along a Hilbert curve
+        if (line.find("hilbertOrder:") == 0)
+        {
+          hilbertOrder_ = line.find("True") != string::npos;
+        }
+
+        // Check for the clip region
+        if (line.find("clip: ") == 0)
+        {
+          if (line.find("clip: RangeRing ") == 0) setClipRangeRing(line.substr(16));
+          else if (line.find("clip: Box ") == 0)
+          {
+            stringstream box(line.substr(10));
+            double south, west, north, east;
+            if (box >> south >> west >> north >> east)
+            {
+              setClipBox(ClipRegion(south, west, north, east));
+            }
+          }
+          else clearClip();
+        }
+
         // Check for lastPlaceFileSaved
         if(line.find("lastSaved:") != string::npos)
         {
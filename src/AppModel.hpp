@@ -66,6 +66,63 @@ public:
   int getRefreshSeconds();
   void setRefreshSeconds(int newVal);
 
+  // Get/Set whether features are grouped by style when saving a place file.
+  // This leaves out redundant Color: and Threshold: lines.
+  inline bool getGroupByStyle() { return groupByStyle_; }
+  inline void setGroupByStyle(bool group) { groupByStyle_ = group; }
+
+  // Get/Set whether the features of each layer are sorted along a Hilbert
+  // curve when saving a place file, so neighbors are written together.
+  inline bool getHilbertOrder() { return hilbertOrder_; }
+  inline void setHilbertOrder(bool order) { hilbertOrder_ = order; }
+
+  // Get/Set the largest error in meters allowed when transforming projected
+  // sources to latitude and longitude. Above zero, vertices are interpolated
+  // between exactly transformed control points, 0 transforms every vertex.
+  inline double getTransformError() { return transformError_; }
+  inline void setTransformError(double meters) { transformError_ = meters > 0.0 ? meters : 0.0; }
+
+  // Get/Set whether layers are read on as many threads as the hardware has
+  // when saving a place file, or one at a time. The place file is the same
+  // either way.
+  inline bool getParallelRead() { return parallelRead_; }
+  inline void setParallelRead(bool parallel) { parallelRead_ = parallel; }
+
+  // Get/Set whether the formatted text of layers is moved out to temporary
+  // files in the system temporary directory while saving, for sources too big
+  // to hold in memory. Layers kept for the next save keep their files until
+  // then, and the files are removed on exit.
+  inline bool getSpillToDisk() { return spillToDisk_; }
+  inline void setSpillToDisk(bool spill) { spillToDisk_ = spill; }
+
+  // Get/Set the coordinate precision policy of the place file, the number of
+  // decimal places or one of the CoordinateFormatter policies. Layers use
+  // this unless they have their own. PRECISION_FULL, the default, writes the
+  // same coordinates as before there was a choice.
+  inline int getPrecision() { return pfPrecision_; }
+  inline void setPrecision(int precision) { pfPrecision_ = precision; }
+
+  // Get/Set whether saving a place file writes the plain text, a gzip
+  // compressed copy with ".gz" added to the name, or both.
+  inline PlaceFile::Output getSaveOutput() { return saveOutput_; }
+  inline void setSaveOutput(PlaceFile::Output output) { saveOutput_ = output; }
+
+  // Get/Set the region the place file is clipped to, see ClipRegion. Either
+  // a box, or the box around the largest ring of a range ring, which follows
+  // the range ring as it is edited. Only the parts of layers inside are read
+  // and saved, range rings themselves are not clipped. An unset region clips
+  // nothing.
+  ClipRegion getClipRegion();
+  inline void setClipBox(const ClipRegion& box) { clipBox_ = box; clipRangeRing_.clear(); }
+  inline string getClipRangeRing() { return clipRangeRing_; }
+  inline void setClipRangeRing(const string& name) { clipRangeRing_ = name; clipBox_ = ClipRegion(); }
+  inline void clearClip() { clipBox_ = ClipRegion(); clipRangeRing_.clear(); }
+
+  // Statistics about the last place file saved, such as its size, the bytes
+  // saved by grouping by style, and the bytes saved in each layer by the
+  // coordinate precision.
+  inline const PlaceFile::SaveStats& getLastSaveStats() { return lastSaveStats_; }
+
   // Save a KML file
   void saveKMLFile(const string& fileName);
 
@@ -105,6 +162,47 @@ public:
   int getLineWidth(const string& source, const string& layer);
   void setLineWidth(const string& source, const string& layer, int lw);
 
+  // Get/Set the coordinate precision policy, PRECISION_DEFAULT uses the
+  // precision of the place file.
+  int getLayerPrecision(const string& source, const string& layer);
+  void setLayerPrecision(const string& source, const string& layer, int precision);
+
+  // Get/Set how lines and polygons are simplified as they are loaded, and the
+  // tolerance in meters. Range rings are not simplified.
+  SimplifyMethod getSimplifyMethod(const string& source, const string& layer);
+  void setSimplifyMethod(const string& source, const string& layer, SimplifyMethod method);
+  double getSimplifyTolerance(const string& source, const string& layer);
+  void setSimplifyTolerance(const string& source, const string& layer, double meters);
+
+  // Get/Set the display thresholds where lines and polygons get more detail,
+  // see PlaceFile::addOGRGeometry. Empty writes each feature once.
+  vector<int> getDetailThresholds(const string& source, const string& layer);
+  void setDetailThresholds(const string& source, const string& layer, 
+    const vector<int>& thresholds);
+
+  // Get/Set whether a layer is simplified as a whole so polygons that share
+  // a boundary still share it afterward, see PlaceFile::endLayer.
+  bool getPreserveTopology(const string& source, const string& layer);
+  void setPreserveTopology(const string& source, const string& layer, bool preserve);
+
+  // Get/Set whether boundaries shared by polygons displayed as lines are
+  // written once, and whether those lines keep the label of the polygon that
+  // owns them.
+  bool getShareEdges(const string& source, const string& layer);
+  void setShareEdges(const string& source, const string& layer, bool share);
+  bool getLabelSharedEdges(const string& source, const string& layer);
+  void setLabelSharedEdges(const string& source, const string& layer, bool label);
+
+  // Get/Set whether lines with the same label and style that meet end to end
+  // are joined into one line.
+  bool getMergeLines(const string& source, const string& layer);
+  void setMergeLines(const string& source, const string& layer, bool merge);
+
+  // Get/Set whether repeated, straight run and spike vertices are removed
+  // after rounding to the layer's precision.
+  bool getCleanVertices(const string& source, const string& layer);
+  void setCleanVertices(const string& source, const string& layer, bool clean);
+
   // Get/Set lat-lon for range ring
   point getRangeRingCenter(const string& source, const string& layer);
   void setRangeRingCenter(const string& source, const string& layer, const point pnt);
@@ -153,6 +251,29 @@ public:
     // Display threshold
     int displayThresh;
 
+    // Coordinate precision policy
+    int precision{ CoordinateFormatter::PRECISION_DEFAULT };
+
+    // Simplification of lines and polygons
+    SimplifyMethod simplify{ SimplifyMethod::NONE };
+    double simplifyTolerance{ 0.0 };
+
+    // Display thresholds where more detail is added
+    vector<int> detailThresholds;
+
+    // Simplify shared boundaries once for the whole layer
+    bool preserveTopology{ false };
+
+    // Write boundaries shared by polygons as lines once, with or without labels
+    bool shareEdges{ false };
+    bool labelSharedEdges{ false };
+
+    // Join line segments with the same label and style that meet end to end
+    bool mergeLines{ false };
+
+    // Remove vertices that do not change the shape
+    bool cleanVertices{ false };
+
     // Summary string
     string summary;
 
@@ -189,12 +310,36 @@ private:
   // Given a layer, analyze it's properties and create a string summarizing them
   const string summarize(OGRLayer *lyr);
 
+  // Formatted text of each layer from the last place file saved, and a key
+  // describing everything it was made from. Keyed on source and layer name.
+  struct CachedLayer
+  {
+    string key;
+    PlaceFile::FormattedLayerPtr formatted;
+  };
+  unordered_map<string, CachedLayer> layerCache_;
+
+  // Keys for the layer cache, if anything that changes the output of a layer
+  // changes, so does its key.
+  string layerKey_(const string& path, const LayerOptions& opts);
+  string rangeRingKey_(const RangeRing& rr, const LayerOptions& opts);
+
    // Variables for saving parameters that affect entire PlaceFile.
   string lastPlaceFileSaved_ {};
   string lastKMLSaved_{};
   int refreshMinutes_{ 1 };
   int refreshSeconds_{ 0 };
   string pfTitle_ = "Created by PlaceFile Builder";
+  bool groupByStyle_{ false };
+  bool hilbertOrder_{ false };
+  double transformError_{ 0.0 };
+  bool parallelRead_{ true };
+  bool spillToDisk_{ false };
+  int pfPrecision_{ CoordinateFormatter::PRECISION_FULL };
+  PlaceFile::Output saveOutput_{ PlaceFile::Output::PLAIN };
+  PlaceFile::SaveStats lastSaveStats_{};
+  ClipRegion clipBox_{};
+  string clipRangeRing_{};
 
 };
 
@@ -0,0 +1,188 @@
+#include "ArcTopology.hpp"
+
+#include <algorithm>
+
+#include "ContentHash.hpp"
+
+using namespace std;
+using PFB::ArcTopology;
+using PFB::point;
+using PFB::PointEqual;
+
+namespace
+{
+  const uint64_t HASH_PRIME = 1099511628211ULL;
+
+  inline bool lessPoint(const point& lhs, const point& rhs)
+  {
+    return lhs.latitude < rhs.latitude ||
+      (lhs.latitude == rhs.latitude && lhs.longitude < rhs.longitude);
+  }
+
+  inline uint64_t hashPoint(const point& pnt)
+  {
+    return PFB::PointHash()(pnt);
+  }
+
+  // A distinct vertex in the table, by index in the flat list of vertices.
+  struct Slot
+  {
+    uint32_t first;      // Where it was first seen, plus one, zero if empty
+    uint32_t prev, next; // Its neighbors there
+  };
+
+  bool isRing(const vector<point>& path)
+  {
+    return path.size() >= 4 && PointEqual()(path.front(), path.back());
+  }
+}
+
+ArcTopology::ArcTopology(const vector<vector<point>>& paths) :
+  pathArcs_(paths.size())
+{
+  // Copy the vertices into one list, leaving out the repeated end of rings,
+  // so finding them is a matter of indexing into contiguous memory.
+  vector<point> flat;
+  vector<size_t> starts{ 0 };
+  for (const vector<point>& path : paths)
+  {
+    const size_t n = isRing(path) ? path.size() - 1 : path.size();
+    flat.insert(flat.end(), path.begin(), path.begin() + n);
+    starts.push_back(flat.size());
+  }
+
+  // Find the junctions with an open addressing hash table of the distinct
+  // vertices. Each vertex is mapped to where it was first seen.
+  size_t capacity = 16;
+  while (capacity < 2 * flat.size()) capacity *= 2;
+  const size_t mask = capacity - 1;
+  vector<Slot> table(capacity, Slot{ 0, 0, 0 });
+  vector<uint32_t> firstSeen(flat.size());
+  vector<char> junction(flat.size(), 0);
+
+  for (size_t p = 0; p != paths.size(); ++p)
+  {
+    const size_t begin = starts[p];
+    const size_t n = starts[p + 1] - begin;
+    const bool ring = isRing(paths[p]);
+    for (size_t i = 0; i != n; ++i)
+    {
+      const size_t g = begin + i;
+      const uint32_t prev = static_cast<uint32_t>(begin + (i == 0 ? n - 1 : i - 1));
+      const uint32_t next = static_cast<uint32_t>(begin + (i + 1 == n ? 0 : i + 1));
+
+      size_t h = static_cast<size_t>(hashPoint(flat[g])) & mask;
+      while (table[h].first != 0 && !PointEqual()(flat[table[h].first - 1], flat[g]))
+      {
+        h = (h + 1) & mask;
+      }
+
+      Slot& slot = table[h];
+      if (slot.first == 0) slot = Slot{ static_cast<uint32_t>(g + 1), prev, next };
+      firstSeen[g] = slot.first - 1;
+
+      if (!ring && (i == 0 || i + 1 == n))
+      {
+        junction[firstSeen[g]] = 1;
+      }
+      else if (slot.first - 1 != g)
+      {
+        const point& a = flat[slot.prev];
+        const point& b = flat[slot.next];
+        const bool sameNeighbors = 
+          (PointEqual()(a, flat[prev]) && PointEqual()(b, flat[next])) ||
+          (PointEqual()(a, flat[next]) && PointEqual()(b, flat[prev]));
+        if (!sameNeighbors) junction[firstSeen[g]] = 1;
+      }
+    }
+  }
+  table = vector<Slot>();
+
+  // Cut the paths into arcs at the junctions.
+  unordered_multimap<uint64_t, size_t> byHash;
+  vector<size_t> cuts;
+  for (size_t p = 0; p != paths.size(); ++p)
+  {
+    const vector<point>& path = paths[p];
+    if (path.size() < 2) continue;
+
+    const bool ring = isRing(path);
+    const size_t begin = starts[p];
+    const size_t n = starts[p + 1] - begin;
+
+    cuts.clear();
+    for (size_t i = 0; i != n; ++i)
+    {
+      if (junction[firstSeen[begin + i]]) cuts.push_back(i);
+    }
+    if (cuts.empty())
+    {
+      size_t smallest = 0;
+      for (size_t i = 1; i != n; ++i)
+      {
+        if (lessPoint(path[i], path[smallest])) smallest = i;
+      }
+      cuts.push_back(smallest);
+    }
+
+    // A ring wraps from its last cut around to its first.
+    const size_t numArcs = ring ? cuts.size() : cuts.size() - 1;
+    for (size_t c = 0; c != numArcs; ++c)
+    {
+      const size_t first = cuts[c];
+      const size_t last = c + 1 < cuts.size() ? cuts[c + 1] : cuts[0] + n;
+
+      vector<point> arc;
+      arc.reserve(last - first + 1);
+      for (size_t i = first; i <= last; ++i) arc.push_back(path[i % n]);
+      pathArcs_[p].push_back(addArc_(move(arc), p, byHash));
+    }
+  }
+}
+
+vector<point> ArcTopology::buildPath(size_t path) const
+{
+  vector<point> out;
+  for (const ArcRef ref : pathArcs_[path])
+  {
+    const vector<point>& arc = arcs_[ref >= 0 ? ref : ~ref];
+
+    // Each arc starts where the one before ended.
+    const size_t skip = out.empty() ? 0 : 1;
+    if (ref >= 0) out.insert(out.end(), arc.begin() + skip, arc.end());
+    else out.insert(out.end(), arc.rbegin() + skip, arc.rend());
+  }
+  return out;
+}
+
+ArcTopology::ArcRef ArcTopology::addArc_(vector<point>&& pts, size_t path,
+  unordered_multimap<uint64_t, size_t>& byHash)
+{
+  // Store each arc in the direction that starts from the smaller end, so it
+  // is found whichever way it is traversed.
+  const size_t n = pts.size();
+  bool reversed = lessPoint(pts.back(), pts.front());
+  if (PointEqual()(pts.front(), pts.back()) && n > 2) reversed = lessPoint(pts[n - 2], pts[1]);
+  if (reversed) reverse(pts.begin(), pts.end());
+
+  uint64_t hash = HASH_SEED;
+  for (const point& pnt : pts) hash = hash * HASH_PRIME + hashPoint(pnt);
+
+  auto range = byHash.equal_range(hash);
+  for (auto it = range.first; it != range.second; ++it)
+  {
+    const vector<point>& arc = arcs_[it->second];
+    if (arc.size() == n && equal(arc.begin(), arc.end(), pts.begin(), PointEqual()))
+    {
+      ++uses_[it->second];
+      return reversed ? ~static_cast<ArcRef>(it->second) : static_cast<ArcRef>(it->second);
+    }
+  }
+
+  const size_t index = arcs_.size();
+  arcs_.push_back(move(pts));
+  uses_.push_back(1);
+  owner_.push_back(path);
+  byHash.emplace(hash, index);
+  return reversed ? ~static_cast<ArcRef>(index) : static_cast<ArcRef>(index);
+}
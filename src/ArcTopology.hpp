@@ -0,0 +1,65 @@
+/*
+Splits a set of lines and polygon rings into arcs, the pieces of boundary
+between the points where they meet, so a boundary shared by neighboring
+polygons is stored once.
+
+A vertex is a junction if it is the end of a line, or if it appears more than
+once with different neighbors on either side. Cutting every path at its
+junctions leaves arcs that are either identical, possibly reversed, or share
+only their end points. Identical arcs are found by hashing the coordinates.
+Rings without any junction are cut at their smallest vertex so an island and
+the hole it fills still share the same arc.
+
+Revisions:
+2026/10/16 - Initial version.
+
+*/
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+#include "point.hpp"
+
+namespace PFB
+{
+  class ArcTopology
+  {
+  public:
+    /// Index of an arc, or ~index if a path uses it in reverse.
+    using ArcRef = int64_t;
+
+    /// Find the arcs of the paths. A path is a ring if its first and last
+    /// points are the same, otherwise a line.
+    explicit ArcTopology(const std::vector<std::vector<point>>& paths);
+
+    /// The distinct arcs, they may be changed before rebuilding paths as
+    /// long as their end points stay the same.
+    std::vector<std::vector<point>>& arcs() { return arcs_; }
+    const std::vector<std::vector<point>>& arcs() const { return arcs_; }
+
+    /// Arcs making up a path, in order.
+    const std::vector<ArcRef>& pathArcs(size_t path) const { return pathArcs_[path]; }
+
+    /// Number of times paths use an arc, more than one if it is shared.
+    size_t arcUses(size_t arc) const { return uses_[arc]; }
+
+    /// The first path to use an arc.
+    size_t arcOwner(size_t arc) const { return owner_[arc]; }
+
+    /// Put a path back together from its arcs.
+    std::vector<point> buildPath(size_t path) const;
+
+  private:
+    std::vector<std::vector<point>> arcs_;
+    std::vector<std::vector<ArcRef>> pathArcs_;
+    std::vector<size_t> uses_;
+    std::vector<size_t> owner_;
+
+    // Add an arc, or find it if it is already there.
+    ArcRef addArc_(std::vector<point>&& pts, size_t path,
+      std::unordered_multimap<uint64_t, size_t>& byHash);
+  };
+}
@@ -0,0 +1,185 @@
+#include "ClipRegion.hpp"
+
+#include <cmath>
+
+using namespace std;
+using PFB::ClipRegion;
+using PFB::EARTH_RADIUS_MILES;
+using PFB::PI;
+using PFB::point;
+using PFB::PointEqual;
+
+namespace
+{
+  inline point between(const point& a, const point& b, double t)
+  {
+    return point(a.latitude + t * (b.latitude - a.latitude),
+      a.longitude + t * (b.longitude - a.longitude));
+  }
+
+  // The edges of the box, each keeps the points on one side of it.
+  enum Edge { WEST, EAST, SOUTH, NORTH };
+}
+
+ClipRegion::ClipRegion(double south, double west, double north, double east) :
+  south_(south), west_(west), north_(north), east_(east), set_(true)
+{
+  if (south_ > north_) swap(south_, north_);
+  if (west_ > east_) swap(west_, east_);
+}
+
+ClipRegion ClipRegion::around(const point& center, double radiusMiles)
+{
+  const double delta = radiusMiles / EARTH_RADIUS_MILES; // radians
+  const double dLat = delta * 180.0 / PI;
+
+  // The widest part of the circle, or all the way around near a pole.
+  const double sinLon = sin(delta) / cos(center.latitude * PI / 180.0);
+  const double dLon = fabs(sinLon) < 1.0 ? asin(fabs(sinLon)) * 180.0 / PI : 180.0;
+
+  return ClipRegion(center.latitude - dLat, center.longitude - dLon,
+    center.latitude + dLat, center.longitude + dLon);
+}
+
+bool ClipRegion::contains(const point& pnt) const
+{
+  return pnt.latitude >= south_ && pnt.latitude <= north_ &&
+    pnt.longitude >= west_ && pnt.longitude <= east_;
+}
+
+bool ClipRegion::intersects(double south, double west, double north, double east) const
+{
+  return south <= north_ && north >= south_ && west <= east_ && east >= west_;
+}
+
+vector<vector<point>> ClipRegion::clipLine(const vector<point>& line) const
+{
+  vector<vector<point>> pieces;
+  vector<point> piece;
+
+  auto flush = [&pieces, &piece]()
+  {
+    if (piece.size() >= 2) pieces.push_back(move(piece));
+    piece.clear();
+  };
+
+  for (size_t i = 1; i < line.size(); ++i)
+  {
+    const point& a = line[i - 1];
+    const point& b = line[i];
+
+    // Liang-Barsky, the part of the segment from t0 to t1 is inside.
+    const double dx = b.longitude - a.longitude;
+    const double dy = b.latitude - a.latitude;
+    const double p[4] = { -dx, dx, -dy, dy };
+    const double q[4] = { a.longitude - west_, east_ - a.longitude,
+      a.latitude - south_, north_ - a.latitude };
+    double t0 = 0.0;
+    double t1 = 1.0;
+    bool visible = true;
+    for (int k = 0; k < 4 && visible; ++k)
+    {
+      if (p[k] == 0.0)
+      {
+        visible = q[k] >= 0.0;
+      }
+      else
+      {
+        const double r = q[k] / p[k];
+        if (p[k] < 0.0)
+        {
+          if (r > t1) visible = false;
+          else if (r > t0) t0 = r;
+        }
+        else
+        {
+          if (r < t0) visible = false;
+          else if (r < t1) t1 = r;
+        }
+      }
+    }
+
+    if (!visible)
+    {
+      flush();
+      continue;
+    }
+
+    // Entering part way along the segment starts a new piece.
+    if (t0 > 0.0) flush();
+    if (piece.empty()) piece.push_back(t0 > 0.0 ? between(a, b, t0) : a);
+    const point exit = t1 < 1.0 ? between(a, b, t1) : b;
+    if (!PointEqual()(piece.back(), exit)) piece.push_back(exit);
+    if (t1 < 1.0) flush();
+  }
+  flush();
+
+  return pieces;
+}
+
+vector<point> ClipRegion::clipRing(const vector<point>& ring) const
+{
+  // Work on the open ring, the closing point is added back at the end.
+  vector<point> input(ring);
+  if (input.size() > 1 && PointEqual()(input.front(), input.back())) input.pop_back();
+  vector<point> output;
+  output.reserve(input.size() + 4);
+
+  for (int edge = WEST; edge <= NORTH && !input.empty(); ++edge)
+  {
+    auto inside = [this, edge](const point& pnt)
+    {
+      switch (edge)
+      {
+      case WEST:  return pnt.longitude >= west_;
+      case EAST:  return pnt.longitude <= east_;
+      case SOUTH: return pnt.latitude >= south_;
+      default:    return pnt.latitude <= north_;
+      }
+    };
+
+    // Where the segment crosses the edge, set exactly on the edge.
+    auto crossing = [this, edge](const point& a, const point& b)
+    {
+      point pnt;
+      if (edge == WEST || edge == EAST)
+      {
+        const double x = edge == WEST ? west_ : east_;
+        pnt = between(a, b, (x - a.longitude) / (b.longitude - a.longitude));
+        pnt.longitude = x;
+      }
+      else
+      {
+        const double y = edge == SOUTH ? south_ : north_;
+        pnt = between(a, b, (y - a.latitude) / (b.latitude - a.latitude));
+        pnt.latitude = y;
+      }
+      return pnt;
+    };
+
+    output.clear();
+    const point* prev = &input.back();
+    bool prevInside = inside(*prev);
+    for (const point& pnt : input)
+    {
+      const bool pntInside = inside(pnt);
+      if (pntInside != prevInside) output.push_back(crossing(*prev, pnt));
+      if (pntInside) output.push_back(pnt);
+      prev = &pnt;
+      prevInside = pntInside;
+    }
+    input.swap(output);
+  }
+
+  // Drop repeats where the ring ran along an edge, then close it.
+  output.clear();
+  for (const point& pnt : input)
+  {
+    if (output.empty() || !PointEqual()(output.back(), pnt)) output.push_back(pnt);
+  }
+  while (output.size() > 1 && PointEqual()(output.front(), output.back())) output.pop_back();
+  if (output.size() < 3) return vector<point>();
+  output.push_back(output.front());
+
+  return output;
+}
@@ -0,0 +1,65 @@
+/*
+A latitude-longitude box that features are clipped to as they are loaded.
+
+Most placefiles only matter within a few hundred miles of one radar, so there
+is no point reading, transforming, and writing whole national layers. The box
+can be given directly or built around a center point and a radius in miles,
+such as the largest ring of a range ring. Lines are cut where they cross the
+edge of the box with the Liang-Barsky algorithm, and polygon rings are clipped
+against each edge in turn with the Sutherland-Hodgman algorithm.
+
+Revisions:
+2026/10/16 - Initial version.
+
+*/
+#pragma once
+
+#include <vector>
+
+#include "point.hpp"
+
+namespace PFB
+{
+  class ClipRegion
+  {
+  public:
+    /// No region, nothing is clipped.
+    ClipRegion() = default;
+
+    /// A box from the south west to the north east corner, in degrees.
+    ClipRegion(double south, double west, double north, double east);
+
+    /// The box around a circle of radius miles. The circle is not clipped to
+    /// exactly, but the corners of the box add little.
+    static ClipRegion around(const point& center, double radiusMiles);
+
+    /// False if there is no region.
+    bool isSet() const { return set_; }
+
+    double south() const { return south_; }
+    double west() const { return west_; }
+    double north() const { return north_; }
+    double east() const { return east_; }
+
+    /// True if the point is in the region or on its edge.
+    bool contains(const point& pnt) const;
+
+    /// True if any part of the box is in the region.
+    bool intersects(double south, double west, double north, double east) const;
+
+    /// The pieces of a line in the region, each with at least 2 points.
+    std::vector<std::vector<point>> clipLine(const std::vector<point>& line) const;
+
+    /// A closed ring cut to the region, also closed. Parts of the ring
+    /// outside are replaced by the edge of the region. Empty if fewer than 3
+    /// distinct points are left.
+    std::vector<point> clipRing(const std::vector<point>& ring) const;
+
+  private:
+    double south_ = 0.0;
+    double west_ = 0.0;
+    double north_ = 0.0;
+    double east_ = 0.0;
+    bool set_ = false;
+  };
+}
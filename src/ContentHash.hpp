@@ -0,0 +1,44 @@
+/*
+A 64 bit FNV-1a hash for detecting when the contents of a PlaceFile have not
+changed since it was last saved.
+
+The hash can be built up a piece at a time by passing the result of one call as
+the starting value of the next.
+
+Revisions:
+2026/10/16 - Initial version.
+
+*/
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace PFB
+{
+  /// Starting value for a new hash.
+  const uint64_t HASH_SEED = 14695981039346656037ULL;
+
+  /// Continue hash h with size bytes of data.
+  inline uint64_t hashBytes(const char* data, size_t size, uint64_t h = HASH_SEED)
+  {
+    const uint64_t PRIME = 1099511628211ULL;
+    for (size_t i = 0; i != size; ++i)
+    {
+      h ^= static_cast<unsigned char>(data[i]);
+      h *= PRIME;
+    }
+    return h;
+  }
+
+  /// Continue hash h with another hash, used to combine hashes of pieces.
+  inline uint64_t hashCombine(uint64_t h, uint64_t value)
+  {
+    for (int i = 0; i != 8; ++i)
+    {
+      h ^= (value >> (8 * i)) & 0xFF;
+      h *= 1099511628211ULL;
+    }
+    return h;
+  }
+}
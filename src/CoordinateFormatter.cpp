@@ -0,0 +1,259 @@
+#include "CoordinateFormatter.hpp"
+
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+using namespace std;
+using PFB::CoordinateFormatter;
+
+namespace
+{
+  // Pairs of digits "00" through "99" for writing two digits at a time.
+  const char DIGIT_PAIRS[] =
+    "00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+    "40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+    "8081828384858687888990919293949596979899";
+
+  // Scaled values must stay below this so they are exact integers as doubles
+  // and fit in 16 digits.
+  const double MAX_SCALED = 4503599627370496.0; // 2^52
+
+  // Precision used by PRECISION_FULL.
+  const int FULL_PRECISION = 10;
+
+  // Write exactly numDigits digits of val, zero padded on the left, ending at
+  // end. Returns a pointer to the first digit.
+  inline char* writeDigitsBackward(uint64_t val, int numDigits, char* end)
+  {
+    while (numDigits >= 2)
+    {
+      const size_t idx = static_cast<size_t>(val % 100) * 2;
+      val /= 100;
+      *--end = DIGIT_PAIRS[idx + 1];
+      *--end = DIGIT_PAIRS[idx];
+      numDigits -= 2;
+    }
+    if (numDigits == 1) *--end = static_cast<char>('0' + val % 10);
+    return end;
+  }
+
+  inline int countDigits(uint64_t val)
+  {
+    int n = 1;
+    while (val >= 100) { val /= 100; n += 2; }
+    if (val >= 10) ++n;
+    return n;
+  }
+}
+
+CoordinateFormatter::CoordinateFormatter(int precision, bool shortest)
+{
+  setPrecision(precision, shortest);
+}
+
+void CoordinateFormatter::setPrecision(int precision, bool shortest)
+{
+  if (precision < 0) precision = 0;
+  if (precision > MAX_PRECISION) precision = MAX_PRECISION;
+  precision_ = precision;
+  shortest_ = shortest;
+
+  intScale_ = 1;
+  for (int i = 0; i < precision_; ++i) intScale_ *= 10;
+  scale_ = static_cast<double>(intScale_);
+}
+
+void CoordinateFormatter::setPolicy(int policy, int displayThreshold)
+{
+  const bool shortest = policy != PRECISION_FULL && policy != PRECISION_DEFAULT;
+  setPrecision(decimalsForPolicy(policy, displayThreshold), shortest);
+}
+
+int CoordinateFormatter::decimalsForPolicy(int policy, int displayThreshold)
+{
+  if (policy == PRECISION_FULL || policy == PRECISION_DEFAULT) return FULL_PRECISION;
+  if (policy == PRECISION_AUTO) return precisionForThreshold(displayThreshold);
+  return policy;
+}
+
+int CoordinateFormatter::precisionForThreshold(int displayThreshold)
+{
+  if (displayThreshold <= 50) return 6;
+  if (displayThreshold <= 250) return 5;
+  return 4;
+}
+
+char* CoordinateFormatter::formatValue(double val, char* out) const
+{
+  const double absVal = fabs(val);
+  const double scaled = absVal * scale_;
+
+  // Also catches NaN and infinity.
+  if (!(scaled < MAX_SCALED)) return formatSlow_(val, out);
+
+  // scaled is within a relative 2^-53 of the exact product, so unless the
+  // fractional part is very near one half the rounding decision is the same
+  // one printf makes from the exact value.
+  const double whole = floor(scaled);
+  const double frac = scaled - whole;
+  const double window = scaled * 1.0e-15 + 1.0e-300;
+  if (fabs(frac - 0.5) <= window) return formatSlow_(val, out);
+
+  uint64_t n = static_cast<uint64_t>(whole);
+  if (frac > 0.5) ++n;
+
+  // printf keeps the sign of negative values that round to zero, the
+  // shortest form does not.
+  if (signbit(val) && (n != 0 || !shortest_)) *out++ = '-';
+
+  const uint64_t intPart = n / intScale_;
+  uint64_t fracPart = n % intScale_;
+
+  const int intDigits = countDigits(intPart);
+  out += intDigits;
+  writeDigitsBackward(intPart, intDigits, out);
+
+  int fracDigits = precision_;
+  if (shortest_)
+  {
+    if (fracPart == 0) fracDigits = 0;
+    while (fracDigits > 0 && fracPart % 10 == 0)
+    {
+      fracPart /= 10;
+      --fracDigits;
+    }
+  }
+
+  if (fracDigits > 0)
+  {
+    *out++ = '.';
+    out += fracDigits;
+    writeDigitsBackward(fracPart, fracDigits, out);
+  }
+
+  return out;
+}
+
+char* CoordinateFormatter::formatLatLon(const point& pnt, char* out)
+{
+  char *start = out;
+  out = formatValue(pnt.latitude, out);
+  *out++ = ',';
+  out = formatValue(pnt.longitude, out);
+
+  if (shortest_)
+  {
+    const size_t full = fullLength_(pnt.latitude) + 1 + fullLength_(pnt.longitude);
+    const size_t written = static_cast<size_t>(out - start);
+    if (full > written) bytesSaved_ += full - written;
+  }
+
+  return out;
+}
+
+char* CoordinateFormatter::formatPoint(const point& pnt, char* out)
+{
+  *out++ = ' ';
+  *out++ = ' ';
+  out = formatLatLon(pnt, out);
+  *out++ = '\n';
+  return out;
+}
+
+void CoordinateFormatter::appendPoints(const point* pnts, size_t numPoints,
+  string& out, const point* prev, bool keepLast)
+{
+  char line[MAX_POINT_CHARS];
+  char prevLine[MAX_POINT_CHARS];
+  size_t prevLen = 0;
+
+  // Only needed for comparing, so format it without counting it.
+  if (shortest_ && prev)
+  {
+    char *end = formatValue(prev->latitude, prevLine);
+    *end++ = ',';
+    end = formatValue(prev->longitude, end);
+    prevLen = static_cast<size_t>(end - prevLine);
+  }
+
+  for (size_t i = 0; i != numPoints; ++i)
+  {
+    if (!shortest_)
+    {
+      const char* end = formatPoint(pnts[i], line);
+      out.append(line, end - line);
+      continue;
+    }
+
+    char *end = formatValue(pnts[i].latitude, line);
+    *end++ = ',';
+    end = formatValue(pnts[i].longitude, end);
+    const size_t len = static_cast<size_t>(end - line);
+
+    const size_t full =
+      fullLength_(pnts[i].latitude) + 1 + fullLength_(pnts[i].longitude);
+
+    const bool last = keepLast && i + 1 == numPoints;
+    if (!last && len == prevLen && memcmp(line, prevLine, len) == 0)
+    {
+      // Same as the last vertex at this precision, leave it out.
+      ++pointsDropped_;
+      bytesSaved_ += full + 3;
+      continue;
+    }
+
+    out.append("  ", 2);
+    out.append(line, len);
+    out.push_back('\n');
+    if (full > len) bytesSaved_ += full - len;
+
+    memcpy(prevLine, line, len);
+    prevLen = len;
+  }
+}
+
+void CoordinateFormatter::appendPoints(const vector<point>& pnts, string& out)
+{
+  if (!pnts.empty()) appendPoints(&pnts[0], pnts.size(), out, nullptr, true);
+}
+
+void CoordinateFormatter::resetStats()
+{
+  pointsDropped_ = 0;
+  bytesSaved_ = 0;
+}
+
+char* CoordinateFormatter::formatSlow_(double val, char* out) const
+{
+  const int n = snprintf(out, MAX_VALUE_CHARS, "%.*f", precision_, val);
+  if (n < 0) return out;
+  char *end = out + (static_cast<size_t>(n) < MAX_VALUE_CHARS ? n : MAX_VALUE_CHARS - 1);
+
+  if (shortest_ && precision_ > 0 && memchr(out, '.', end - out))
+  {
+    while (end[-1] == '0') --end;
+    if (end[-1] == '.') --end;
+  }
+  if (shortest_ && end - out == 2 && out[0] == '-' && out[1] == '0')
+  {
+    out[0] = '0';
+    end = out + 1;
+  }
+
+  return end;
+}
+
+size_t CoordinateFormatter::fullLength_(double val)
+{
+  const double scaled = fabs(val) * 1.0e10;
+  if (!(scaled < MAX_SCALED))
+  {
+    char buf[MAX_VALUE_CHARS];
+    const int n = snprintf(buf, sizeof(buf), "%.*f", FULL_PRECISION, val);
+    return n > 0 ? static_cast<size_t>(n) : 0;
+  }
+
+  const uint64_t n = static_cast<uint64_t>(scaled + 0.5);
+  return (signbit(val) ? 1 : 0) + countDigits(n / 10000000000ULL) + 1 + FULL_PRECISION;
+}
@@ -62,7 +62,43 @@ void PFB::Feature::setColor(const PlaceFileColor& color)
   _color = PlaceFileColor(color);
 }
 
+PFB::StyleState PFB::Feature::putStyle(std::ostream& ost, 
+  const StyleState& prev) const
+{
+  StyleState next;
+  next.colorString = getColorString();
+  next.displayThreshold = displayThreshold_;
+
+  if (next.colorString != prev.colorString) ost << "\n" << next.colorString << "\n";
+  if (next.displayThreshold != prev.displayThreshold)
+  {
+    ost << "\nThreshold: " << next.displayThreshold << "\n";
+  }
+
+  return next;
+}
+
+void PFB::Feature::writeCoordinates(std::ostream& ost, 
+  CoordinateFormatter& fmt, const std::vector<point>& coords)
+{
+  // Format in blocks so the buffer stays small for very long lines.
+  const size_t BLOCK_SIZE = 1024;
+
+  std::string buf;
+  buf.reserve(BLOCK_SIZE * 32);
+  for (size_t i = 0; i < coords.size(); i += BLOCK_SIZE)
+  {
+    const size_t n = coords.size() - i < BLOCK_SIZE ? coords.size() - i : BLOCK_SIZE;
+    buf.clear();
+    fmt.appendPoints(&coords[i], n, buf, i > 0 ? &coords[i - 1] : nullptr, 
+      i + n == coords.size());
+    ost.write(buf.data(), buf.size());
+  }
+}
+
 std::ostream& PFB::operator<<(std::ostream& ost, const Feature& pf)
 {
-  return pf.put(ost);
+  CoordinateFormatter fmt(static_cast<int>(ost.precision()));
+  pf.put(ost, StyleState(), fmt);
+  return ost;
 }
@@ -12,15 +12,32 @@ Revisions:
 */
 #pragma once
 
+#include <climits>
 #include <string>
 #include <iostream>
 
+#include <vector>
+
+#include "CoordinateFormatter.hpp"
 #include "PlaceFileColor.hpp"
+#include "point.hpp"
 
 namespace PFB
 {
   enum class FeatureType { POLYGON=0, LINE, POINT };
 
+  /// The color and display threshold in effect at some point while writing a
+  /// PlaceFile. Features only write Color: and Threshold: lines when theirs
+  /// differ from the state left by the feature before them. The default state
+  /// matches nothing, so both lines are written.
+  struct StyleState
+  {
+    std::string colorString;
+    int displayThreshold = NO_THRESHOLD;
+
+    static const int NO_THRESHOLD = INT_MIN;
+  };
+
   class Feature
   {
   public:
@@ -48,32 +65,36 @@ namespace PFB
     /// Move assignment
     virtual Feature& operator=(Feature&& src);
 
-    /// Used by operator<< in the Feature class to support output with streams.
-    virtual std::ostream& put(std::ostream& ost)const = 0;
+    /// Write this feature to a stream, leaving out the color and threshold if
+    /// they are the same as the previous state. Returns the new state. Does
+    /// not modify the feature, so the same feature can be written to several
+    /// streams at once from different threads. Coordinates are written with
+    /// fmt, which also keeps count of vertices dropped and bytes saved.
+    virtual StyleState put(std::ostream& ost, const StyleState& prev, 
+      CoordinateFormatter& fmt) const = 0;
 
     /// Get the feature type without using RTTI
     virtual FeatureType getFeatureType() const = 0;
 
+    /// Get the number of vertices written out for this feature.
+    virtual size_t getNumPoints() const = 0;
+
+    /// Get the box around all the vertices of this feature.
+    virtual Bounds getBounds() const = 0;
+
     /// Accessor and Setter methods for the label.
     std::string getLabelString() const;
     void setLabelString(const std::string& label);
 
     /// Accessor and Setter methods for the color
     std::string getColorString() const;
+    inline PlaceFileColor getColor() const { return _color; }
     void setColor(const PlaceFileColor& color);
 
     /// Accessor and Setter methods for the display threshold
     inline int getDisplayThreshold() const { return displayThreshold_; }
     inline void setDisplayThreshold(int newVal){ displayThreshold_ = newVal; }
 
-    /// Set whether or not to use color when printing
-    inline void setUseColor(bool useColor) { includeColor_ = useColor; }
-
-    /// Set whether or not to use the display threshold
-    inline void setUseDisplayThreshold(bool useThresh) 
-    { 
-      includeThreshold_ = useThresh; 
-    }
     /// Accessor and Setter methods for the line width
     inline int getLineWidth() const { return lineWidth_; }
     inline void setLineWidth(const int newVal) { lineWidth_ = newVal; }
@@ -82,9 +103,14 @@ namespace PFB
     friend std::ostream& operator<<(std::ostream& ost, const Feature& pf);
 
   protected:
-    // Used when printing out, can turn off color output
-    bool includeColor_ = true; 
-    bool includeThreshold_ = true;
+    /// Write the Color: and Threshold: lines that differ from the previous
+    /// state and return the new state, used by the put methods of sub-classes.
+    StyleState putStyle(std::ostream& ost, const StyleState& prev) const;
+
+    /// Write a vertex line for each point, used by the put methods of
+    /// sub-classes.
+    static void writeCoordinates(std::ostream& ost, 
+      CoordinateFormatter& fmt, const std::vector<point>& coords);
 
   private:
     std::string _label;
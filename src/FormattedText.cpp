@@ -0,0 +1,250 @@
+#include "FormattedText.hpp"
+
+#include <deque>
+#include <future>
+#include <sstream>
+#include <thread>
+
+#include "ContentHash.hpp"
+#include "CoordinateFormatter.hpp"
+
+using namespace std;
+using namespace PFB;
+
+namespace
+{
+  // Where a feature's text is in a chunk, and the hash of its style.
+  struct FeatureExtent
+  {
+    size_t bodyStart;  // After any Color: and Threshold: lines
+    size_t end;
+    uint64_t styleHash;
+  };
+}
+
+StyleKey PFB::styleKey(const Feature* ft)
+{
+  const PlaceFileColor c = ft->getColor();
+  return make_tuple(c.red, c.green, c.blue, ft->getDisplayThreshold(),
+    ft->getLineWidth());
+}
+
+bool PFB::styleLess(const Feature* lhs, const Feature* rhs)
+{
+  return styleKey(lhs) < styleKey(rhs);
+}
+
+void PFB::addStyleRun(vector<StyleRun>& runs, const string& colorString, int threshold)
+{
+  if (runs.empty() || runs.back().colorString != colorString ||
+    runs.back().threshold != threshold)
+  {
+    runs.push_back(StyleRun{ colorString, threshold });
+  }
+}
+
+void PFB::addStyleRuns(vector<StyleRun>& runs, const vector<const Feature*>& features)
+{
+  for (const Feature* ft : features)
+  {
+    addStyleRun(runs, ft->getColorString(), ft->getDisplayThreshold());
+  }
+}
+
+uint64_t PFB::styleBytes(const vector<StyleRun>& runs, int threshold)
+{
+  uint64_t bytes = 0;
+  const string *colorString = nullptr;
+  for (const StyleRun& run : runs)
+  {
+    if (!colorString || run.colorString != *colorString)
+    {
+      bytes += run.colorString.size() + 2;
+      colorString = &run.colorString;
+    }
+    if (run.threshold != threshold)
+    {
+      threshold = run.threshold;
+      bytes += to_string(threshold).size() + 13;
+    }
+  }
+  return bytes;
+}
+
+void PFB::addSegment(vector<TextSegment>& rest, TextSegment seg)
+{
+  if (seg.file ? seg.size == 0 : seg.text.empty()) return;
+  if (!rest.empty())
+  {
+    TextSegment& last = rest.back();
+    if (!seg.file && !last.file)
+    {
+      last.text += seg.text;
+      return;
+    }
+    if (seg.file && seg.file == last.file && last.offset + last.size == seg.offset)
+    {
+      last.size += seg.size;
+      return;
+    }
+  }
+  rest.push_back(move(seg));
+}
+
+FormattedChunk PFB::formatChunk(const Feature *const *first, const Feature *const *last,
+  streamsize precision, ios_base::fmtflags flags, int policy)
+{
+  FormattedChunk chunk;
+  if (first == last) return chunk;
+
+  ostringstream ost;
+  ost.precision(precision);
+  ost.flags(flags);
+
+  chunk.firstColor = (*first)->getColorString();
+  chunk.firstThresh = (*first)->getDisplayThreshold();
+  chunk.firstStyle = styleKey(*first);
+  chunk.colorLen = chunk.firstColor.size() + 2;
+  chunk.threshLen = to_string(chunk.firstThresh).size() + 13;
+
+  // Start from an unknown state so the first feature writes both lines.
+  CoordinateFormatter fmt;
+  StyleState state;
+  vector<FeatureExtent> extents;
+  extents.reserve(last - first);
+  for (const Feature *const *it = first; it != last; ++it)
+  {
+    const Feature *ft = *it;
+    fmt.setPolicy(policy, ft->getDisplayThreshold());
+
+    // The style lines put writes depend on the feature before, so they
+    // are left out of the hash and the style is hashed directly.
+    FeatureExtent ext;
+    const string colorString = ft->getColorString();
+    ext.bodyStart = static_cast<size_t>(ost.tellp());
+    if (colorString != state.colorString) ext.bodyStart += colorString.size() + 2;
+    if (ft->getDisplayThreshold() != state.displayThreshold)
+    {
+      ext.bodyStart += to_string(ft->getDisplayThreshold()).size() + 13;
+    }
+    ext.styleHash = hashCombine(
+      hashBytes(colorString.data(), colorString.size()),
+      static_cast<uint64_t>(ft->getDisplayThreshold()));
+
+    state = ft->put(ost, state, fmt);
+
+    ext.end = static_cast<size_t>(ost.tellp());
+    extents.push_back(ext);
+  }
+
+  chunk.text = ost.str();
+  chunk.lastColor = state.colorString;
+  chunk.lastThresh = state.displayThreshold;
+
+  chunk.stats.bytes = chunk.text.size();
+  chunk.stats.pointsDropped = fmt.getPointsDropped();
+  chunk.stats.bytesSaved = fmt.getBytesSaved();
+  for (const FeatureExtent& ext : extents)
+  {
+    const uint64_t featureHash = hashBytes(chunk.text.data() + ext.bodyStart,
+      ext.end - ext.bodyStart, ext.styleHash);
+    chunk.stats.hash = chunk.stats.hash * HASH_PRIME + featureHash;
+    chunk.hashScale *= HASH_PRIME;
+  }
+
+  return chunk;
+}
+
+uint64_t PFB::chunkSize(const FormattedChunk& chunk)
+{
+  uint64_t size = chunk.text.size();
+  for (const TextSegment& seg : chunk.rest)
+  {
+    size += seg.file ? seg.size : seg.text.size();
+  }
+  return size;
+}
+
+void PFB::addStats(PlaceFile::LayerStats& dst, const FormattedChunk& chunk)
+{
+  dst.bytesSaved += chunk.stats.bytesSaved;
+  dst.pointsDropped += chunk.stats.pointsDropped;
+  dst.hash = dst.hash * chunk.hashScale + chunk.stats.hash;
+}
+
+void PFB::appendChunk(FormattedChunk& block, const FormattedChunk& chunk)
+{
+  if (chunk.text.empty()) return;
+  if (block.text.empty())
+  {
+    block = chunk;
+    return;
+  }
+
+  // Once the block goes on in rest, new text goes after it there.
+  TextSegment tail{ nullptr, 0, 0, string() };
+  string& dst = block.rest.empty() ? block.text : tail.text;
+  spliceText(chunk, block.lastColor, block.lastThresh,
+    [&dst](const char* s, size_t n) { dst.append(s, n); });
+  addSegment(block.rest, move(tail));
+  for (const TextSegment& seg : chunk.rest) addSegment(block.rest, seg);
+  block.lastColor = chunk.lastColor;
+  block.lastThresh = chunk.lastThresh;
+
+  addStats(block.stats, chunk);
+  block.stats.bytes = chunkSize(block);
+  block.hashScale *= chunk.hashScale;
+}
+
+void PFB::spillChunk(FormattedChunk& chunk, const shared_ptr<SpillFile>& file)
+{
+  vector<TextSegment> rest;
+  auto spill = [&rest, &file](const char* s, size_t n)
+  {
+    if (n != 0) addSegment(rest, TextSegment{ file, file->append(s, n), n, string() });
+  };
+
+  const size_t head = chunk.colorLen + chunk.threshLen;
+  spill(chunk.text.data() + head, chunk.text.size() - head);
+  chunk.text.resize(head);
+  chunk.text.shrink_to_fit();
+  for (TextSegment& seg : chunk.rest)
+  {
+    if (seg.file) addSegment(rest, move(seg));
+    else spill(seg.text.data(), seg.text.size());
+  }
+  chunk.rest = move(rest);
+}
+
+void PFB::formatBlock(FormattedChunk& block, const vector<const Feature*>& features, 
+  int policy)
+{
+  unsigned int numThreads = thread::hardware_concurrency();
+  if (numThreads == 0) numThreads = 1;
+  const size_t maxInFlight = 2 * numThreads;
+
+  ostringstream defaults;
+  defaults.precision(WRITE_PRECISION);
+  defaults << fixed;
+
+  deque<future<FormattedChunk>> inFlight;
+  size_t first = 0;
+  while (first != features.size() || !inFlight.empty())
+  {
+    for (; first != features.size() && inFlight.size() < maxInFlight;)
+    {
+      size_t last = first;
+      size_t points = 0;
+      while (last != features.size() && points < CHUNK_POINTS)
+      {
+        points += features[last++]->getNumPoints() + 1;
+      }
+      inFlight.push_back(async(launch::async, formatChunk, features.data() + first, 
+        features.data() + last, defaults.precision(), defaults.flags(), policy));
+      first = last;
+    }
+
+    appendChunk(block, inFlight.front().get());
+    inFlight.pop_front();
+  }
+}
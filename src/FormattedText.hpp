@@ -0,0 +1,173 @@
+/*
+The formatted text of place file layers, used only by PlaceFile.
+
+Features are formatted in chunks of consecutive features on worker threads and
+the chunks joined in the order they are written. Each chunk starts with its
+own color and threshold lines since the style left by the chunk before is not
+known while formatting, and those lines are left out when joining if they are
+redundant. A joined block can go on past its start in memory or in a
+SpillFile. A FormattedLayer is a block for each feature type plus what is
+needed to join it to other layers or group it by style, so it can be written
+again without the features it was made from.
+
+Revisions:
+2026/10/16 - Split out of PlaceFile.cpp.
+
+*/
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <ios>
+#include <memory>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include "Feature.hpp"
+#include "PlaceFile.hpp"
+#include "SpillFile.hpp"
+
+namespace PFB
+{
+  // Approximate number of vertices formatted by each worker at a time.
+  const size_t CHUNK_POINTS = 1 << 16;
+
+  // Decimal places written for coordinates, before the precision policy.
+  const std::streamsize WRITE_PRECISION = 10;
+
+  // Layer hashes are a polynomial in the feature hashes so the hashes of
+  // pieces of a layer can be joined without depending on where they split.
+  const uint64_t HASH_PRIME = 1099511628211ULL;
+
+  // Features are grouped by these when grouping by style.
+  using StyleKey = std::tuple<unsigned char, unsigned char, unsigned char, int, int>;
+
+  StyleKey styleKey(const Feature* ft);
+
+  bool styleLess(const Feature* lhs, const Feature* rhs);
+
+  // Consecutive features with the same Color: and Threshold: lines.
+  struct StyleRun
+  {
+    std::string colorString;
+    int threshold;
+  };
+
+  // Add a run to the end of runs unless it has the same style as the last.
+  void addStyleRun(std::vector<StyleRun>& runs, const std::string& colorString,
+    int threshold);
+
+  void addStyleRuns(std::vector<StyleRun>& runs, const std::vector<const Feature*>& features);
+
+  // Bytes taken up by Color: and Threshold: lines when writing in this order.
+  uint64_t styleBytes(const std::vector<StyleRun>& runs, int threshold);
+
+  // Text that follows the start of a chunk, either in memory or moved out
+  // to a spill file with setSpillPath.
+  struct TextSegment
+  {
+    std::shared_ptr<SpillFile> file;  // Null if the text is in memory
+    uint64_t offset;
+    uint64_t size;
+    std::string text;
+  };
+
+  // Add seg to the end of rest, joining it to the last segment when they
+  // are both in memory or next to each other in the same file.
+  void addSegment(std::vector<TextSegment>& rest, TextSegment seg);
+
+  // Output for a run of consecutive features from one layer. The first
+  // feature always writes its color and threshold lines, which are at the
+  // very start of the text. Once joined the text may go on in rest.
+  struct FormattedChunk
+  {
+    std::string text;
+    std::vector<TextSegment> rest;  // After text
+    std::string firstColor;
+    int firstThresh = 0;
+    StyleKey firstStyle;
+    size_t colorLen = 0;   // Length of "\nColor: r g b\n" at start of text
+    size_t threshLen = 0;  // Length of "\nThreshold: t\n" following that
+    std::string lastColor;
+    int lastThresh = 0;
+    PlaceFile::LayerStats stats; // bytes is the size of the text and rest
+    uint64_t hashScale = 1;      // HASH_PRIME^(number of features)
+  };
+
+  // Format the features from first up to last.
+  FormattedChunk formatChunk(const Feature *const *first, const Feature *const *last,
+    std::streamsize precision, std::ios_base::fmtflags flags, int policy);
+
+  // Bytes of text in a chunk, wherever they are.
+  uint64_t chunkSize(const FormattedChunk& chunk);
+
+  // Write the text of a chunk after the given state, leaving out the leading
+  // color and threshold if they match it, but not the rest. Write is called
+  // with each piece of text. Returns the number of bytes left out.
+  template<class Write>
+  size_t spliceText(const FormattedChunk& chunk, const std::string& colorString,
+    int displayThresh, Write write)
+  {
+    if (chunk.text.empty()) return 0;
+
+    const char *text = chunk.text.data();
+    size_t skipped = 0;
+    if (chunk.firstColor != colorString) write(text, chunk.colorLen);
+    else skipped += chunk.colorLen;
+    if (chunk.firstThresh != displayThresh)
+    {
+      write(text + chunk.colorLen, chunk.threshLen);
+    }
+    else skipped += chunk.threshLen;
+    const size_t skip = chunk.colorLen + chunk.threshLen;
+    write(text + skip, chunk.text.size() - skip);
+
+    return skipped;
+  }
+
+  // Write a whole chunk after the given state, like spliceText, reading back
+  // any of it that was spilled.
+  template<class Write>
+  size_t spliceChunk(const FormattedChunk& chunk, const std::string& colorString,
+    int displayThresh, Write write)
+  {
+    const size_t skipped = spliceText(chunk, colorString, displayThresh, write);
+    for (const TextSegment& seg : chunk.rest)
+    {
+      if (seg.file) seg.file->read(seg.offset, seg.size, write);
+      else write(seg.text.data(), seg.text.size());
+    }
+    return skipped;
+  }
+
+  // Add the statistics of a chunk that follows the ones already in dst.
+  void addStats(PlaceFile::LayerStats& dst, const FormattedChunk& chunk);
+
+  // Join chunk to the end of block.
+  void appendChunk(FormattedChunk& block, const FormattedChunk& chunk);
+
+  // Move the text of a chunk to the end of file, all but the leading color
+  // and threshold lines that spliceText may leave out.
+  void spillChunk(FormattedChunk& chunk, const std::shared_ptr<SpillFile>& file);
+
+  // Append the text of features, in the order they are written, to block.
+  // Chunks are split and formatted on worker threads the same way
+  // PlaceFile::write_ does, so the text is the same.
+  void formatBlock(FormattedChunk& block, const std::vector<const Feature*>& features,
+    int policy);
+}
+
+// The text of one layer for each feature type, each joined like a chunk.
+class PFB::PlaceFile::FormattedLayer
+{
+public:
+  FormattedChunk blocks[3];            // Indexed by FeatureType
+  vector<StyleRun> runsAsAdded[3];     // Styles in the order features were added
+  vector<StyleRun> runsWritten[3];     // Styles in the order they were written
+  int precision;                       // Precision policy used
+  bool grouped;                        // Grouped by style
+  uint64_t verticesIn = 0;             // Statistics of the features it was made from
+  uint64_t verticesOut = 0;
+  uint64_t verticesCleaned = 0;
+};
@@ -0,0 +1,73 @@
+#include "HilbertOrder.hpp"
+
+#include <algorithm>
+#include <utility>
+
+using namespace std;
+
+namespace
+{
+  const uint32_t GRID_BITS = 16;
+  const uint32_t GRID_MAX = (1u << GRID_BITS) - 1;
+}
+
+uint32_t PFB::hilbertIndex(uint32_t x, uint32_t y)
+{
+  uint32_t d = 0;
+  for (uint32_t s = 1u << (GRID_BITS - 1); s > 0; s >>= 1)
+  {
+    const uint32_t rx = (x & s) ? 1 : 0;
+    const uint32_t ry = (y & s) ? 1 : 0;
+    d += s * s * ((3 * rx) ^ ry);
+
+    // Rotate the quadrant so the curve inside it lines up.
+    if (ry == 0)
+    {
+      if (rx == 1)
+      {
+        x = GRID_MAX - x;
+        y = GRID_MAX - y;
+      }
+      swap(x, y);
+    }
+  }
+  return d;
+}
+
+vector<size_t> PFB::hilbertOrder(const vector<Bounds>& bounds)
+{
+  Bounds all;
+  for (const Bounds& box : bounds)
+  {
+    if (!box.isEmpty()) all.extend(box);
+  }
+
+  const double width = all.east - all.west;
+  const double height = all.north - all.south;
+  const double scaleX = width > 0.0 ? GRID_MAX / width : 0.0;
+  const double scaleY = height > 0.0 ? GRID_MAX / height : 0.0;
+
+  // Empty boxes get a key past the end of the curve.
+  vector<pair<uint64_t, size_t>> keyed;
+  keyed.reserve(bounds.size());
+  for (size_t i = 0; i != bounds.size(); ++i)
+  {
+    const Bounds& box = bounds[i];
+    uint64_t key = uint64_t(1) << 32;
+    if (!box.isEmpty())
+    {
+      const double x = ((box.west + box.east) / 2.0 - all.west) * scaleX;
+      const double y = ((box.south + box.north) / 2.0 - all.south) * scaleY;
+      key = hilbertIndex(static_cast<uint32_t>(x + 0.5), static_cast<uint32_t>(y + 0.5));
+    }
+    keyed.push_back(make_pair(key, i));
+  }
+
+  // The index is part of the pair, so ties keep their order.
+  sort(keyed.begin(), keyed.end());
+
+  vector<size_t> order;
+  order.reserve(keyed.size());
+  for (const auto& entry : keyed) order.push_back(entry.second);
+  return order;
+}
@@ -0,0 +1,32 @@
+/*
+Orders features along a Hilbert curve so neighbors end up next to each other.
+
+GDAL returns features in the order they are stored, which is often unrelated
+to where they are. The center of each feature's box is scaled to a 2^16 by
+2^16 grid over the box around all of them, and features are sorted by the
+distance along the Hilbert curve through that grid. Features close along the
+curve are close on the map, so the text written for neighbors is similar,
+which helps gzip, and the spatial index packs tighter nodes.
+
+Revisions:
+2026/10/16 - Initial version.
+
+*/
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "point.hpp"
+
+namespace PFB
+{
+  /// Distance along the Hilbert curve through a 2^16 by 2^16 grid of cell
+  /// x, y.
+  uint32_t hilbertIndex(uint32_t x, uint32_t y);
+
+  /// Indexes into bounds in the order of the Hilbert index of the center of
+  /// each box. Ties keep their original order, empty boxes go last.
+  std::vector<size_t> hilbertOrder(const std::vector<Bounds>& bounds);
+}
@@ -0,0 +1,87 @@
+#include "LayerFormatter.hpp"
+
+#include <algorithm>
+
+using namespace std;
+using PFB::LayerFormatter;
+
+LayerFormatter::LayerFormatter()
+{
+}
+
+LayerFormatter::~LayerFormatter()
+{
+}
+
+void LayerFormatter::start(size_t layer, vector<FP>&& features, 
+  shared_ptr<FormattedLayer> text)
+{
+  // Sorted by type and written order.
+  vector<vector<const Feature*>> written(3);
+  for (const FP& ft : features)
+  {
+    written[static_cast<int>(ft->getFeatureType())].push_back(ft.get());
+  }
+  for (int tp = 0; tp < 3; ++tp)
+  {
+    addStyleRuns(text->runsAsAdded[tp], written[tp]);
+    if (text->grouped) stable_sort(written[tp].begin(), written[tp].end(), styleLess);
+    addStyleRuns(text->runsWritten[tp], written[tp]);
+  }
+
+  unique_ptr<Job> job(new Job);
+  job->layer = layer;
+  job->features = move(features);
+  const int policy = text->precision;
+  job->text = async(launch::async, [text, policy, written = move(written)]()
+  {
+    for (int tp = 0; tp < 3; ++tp) formatBlock(text->blocks[tp], written[tp], policy);
+    return text;
+  });
+  jobs_.push_back(move(job));
+}
+
+shared_ptr<LayerFormatter::FormattedLayer> LayerFormatter::finish(FormattedLayerPtr before,
+  bool owned)
+{
+  const unique_ptr<Job> job = move(jobs_.front());
+  jobs_.pop_front();
+  shared_ptr<FormattedLayer> text = job->text.get();
+
+  // Text kept from an earlier save comes first, then any parts already
+  // formatted.
+  if (before)
+  {
+    shared_ptr<FormattedLayer> joined = owned ?
+      const_pointer_cast<FormattedLayer>(before) : make_shared<FormattedLayer>(*before);
+    for (int tp = 0; tp < 3; ++tp)
+    {
+      appendChunk(joined->blocks[tp], text->blocks[tp]);
+      for (const StyleRun& run : text->runsAsAdded[tp])
+      {
+        addStyleRun(joined->runsAsAdded[tp], run.colorString, run.threshold);
+      }
+      for (const StyleRun& run : text->runsWritten[tp])
+      {
+        addStyleRun(joined->runsWritten[tp], run.colorString, run.threshold);
+      }
+    }
+    joined->verticesIn += text->verticesIn;
+    joined->verticesOut += text->verticesOut;
+    joined->verticesCleaned += text->verticesCleaned;
+    text = joined;
+  }
+
+  if (!spillPath_.empty())
+  {
+    const char *names[3] = { ".polygons.", ".lines.", ".points." };
+    for (int tp = 0; tp < 3; ++tp)
+    {
+      if (text->blocks[tp].text.empty()) continue;
+      if (!spill_[tp]) spill_[tp] = make_shared<SpillFile>(spillPath_ + names[tp]);
+      spillChunk(text->blocks[tp], spill_[tp]);
+    }
+  }
+
+  return text;
+}
@@ -0,0 +1,92 @@
+/*
+Formats the layers of a PlaceFile on worker threads as each one ends, used only
+by PlaceFile, see PlaceFile::setFormatEarly.
+
+A layer's features are handed over when it ends, or in parts as it grows, and
+formatted into a FormattedLayer while the next one is built. The text of each
+layer is joined after the text the layer already has, kept from an earlier
+save or from parts formatted before, in the order they were started. With a
+spill path the joined text is moved out to a SpillFile for each feature type,
+so only the start of each layer stays in memory.
+
+Revisions:
+2026/10/16 - Split out of PlaceFile.cpp.
+
+*/
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <future>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "FormattedText.hpp"
+#include "PlaceFile.hpp"
+#include "SpillFile.hpp"
+
+namespace PFB
+{
+  class LayerFormatter
+  {
+  public:
+    using FP = PlaceFile::FP;
+    using FormattedLayer = PlaceFile::FormattedLayer;
+    using FormattedLayerPtr = PlaceFile::FormattedLayerPtr;
+
+    /// Layers formatted at once. Past that the oldest must be finished before
+    /// building the next, see full.
+    static const size_t MAX_LAYERS = 2;
+
+    /// Vertices in a layer that make it worth formatting part of it before
+    /// it ends, when there is a spill path.
+    static const uint64_t PART_POINTS = 4 * CHUNK_POINTS;
+
+    LayerFormatter();
+    ~LayerFormatter();
+
+    LayerFormatter(const LayerFormatter&) = delete;
+    LayerFormatter& operator=(const LayerFormatter&) = delete;
+
+    /// Move the text out to files named prefix plus ".polygons.", ".lines."
+    /// or ".points.", a number and ".tmp" as each layer is finished. Empty,
+    /// the default, keeps it in memory.
+    void setSpillPath(const std::string& prefix) { spillPath_ = prefix; }
+    const std::string& getSpillPath() const { return spillPath_; }
+
+    /// Start formatting the features of layer, in the order they were added
+    /// and grouped by style if text is. text has the precision policy and
+    /// the vertex statistics of the features, and gets the formatted text.
+    void start(size_t layer, std::vector<FP>&& features, std::shared_ptr<FormattedLayer> text);
+
+    /// Nothing is being formatted.
+    bool empty() const { return jobs_.empty(); }
+
+    /// More than MAX_LAYERS are being formatted.
+    bool full() const { return jobs_.size() > MAX_LAYERS; }
+
+    /// The layer the oldest text being formatted is for.
+    size_t oldestLayer() const { return jobs_.front()->layer; }
+
+    /// Wait for the oldest text and return it joined after before. before is
+    /// copied first unless owned, since kept text is shared.
+    std::shared_ptr<FormattedLayer> finish(FormattedLayerPtr before, bool owned);
+
+  private:
+    // A layer being formatted. It owns the features until the text is done.
+    struct Job
+    {
+      size_t layer;
+      std::vector<FP> features;
+      std::future<std::shared_ptr<FormattedLayer>> text;
+    };
+
+    std::deque<std::unique_ptr<Job>> jobs_;
+
+    // Files the formatted text is moved to, indexed by FeatureType.
+    std::string spillPath_;
+    std::shared_ptr<SpillFile> spill_[3];
+  };
+}
@@ -0,0 +1,383 @@
+#include "LayerReader.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+
+#include "Reprojection.hpp"
+
+using namespace std;
+using PFB::LayerReader;
+using PFB::ClipRegion;
+using OGRWrapper::OGRFeatureWrapper;
+
+namespace
+{
+  // Vertices transformed together on each thread, enough that the cost of
+  // calling into PROJ is spread out without holding much of a layer in memory.
+  const size_t TRANSFORM_BATCH_VERTICES = 1 << 16;
+
+  // The envelope of the clip region in the coordinates of a layer. The edges
+  // of the box are densified since they curve in a projected system. False if
+  // the region cannot be transformed, then the layer is read in full.
+  bool regionEnvelope(const ClipRegion& clip, OGRSpatialReference* srcCS,
+    OGRSpatialReference& trgtCS, OGREnvelope& env)
+  {
+    const int STEPS = 16;
+    vector<double> x, y;
+    for (int i = 0; i <= STEPS; ++i)
+    {
+      const double lon = clip.west() + (clip.east() - clip.west()) * i / STEPS;
+      const double lat = clip.south() + (clip.north() - clip.south()) * i / STEPS;
+      x.push_back(lon); y.push_back(clip.south());
+      x.push_back(lon); y.push_back(clip.north());
+      x.push_back(clip.west()); y.push_back(lat);
+      x.push_back(clip.east()); y.push_back(lat);
+    }
+
+    if (srcCS != nullptr)
+    {
+      OGRCoordinateTransformation *inverse = OGRCreateCoordinateTransformation(&trgtCS, srcCS);
+      if (inverse == nullptr) return false;
+      const int ok = inverse->Transform(static_cast<int>(x.size()), x.data(), y.data());
+      OGRCoordinateTransformation::DestroyCT(inverse);
+      if (!ok) return false;
+    }
+
+    env.MinX = *min_element(x.begin(), x.end());
+    env.MaxX = *max_element(x.begin(), x.end());
+    env.MinY = *min_element(y.begin(), y.end());
+    env.MaxY = *max_element(y.begin(), y.end());
+    return true;
+  }
+
+  // Have GDAL only return the features of the layer that might be inside the
+  // clip region. True if the whole layer is outside it.
+  bool setClipFilter(OGRLayer* layer, const ClipRegion& clip, OGRSpatialReference& trgtCS)
+  {
+    OGREnvelope layerEnv, regionEnv;
+    if (!clip.isSet() || !regionEnvelope(clip, layer->GetSpatialRef(), trgtCS, regionEnv))
+    {
+      return false;
+    }
+
+    // Some drivers apply the spatial filter to the extent, so get it first.
+    const bool outside = layer->GetExtent(&layerEnv, FALSE) == OGRERR_NONE &&
+      !layerEnv.Intersects(regionEnv);
+    layer->SetSpatialFilterRect(regionEnv.MinX, regionEnv.MinY,
+      regionEnv.MaxX, regionEnv.MaxY);
+    return outside;
+  }
+
+  // Handles are shared, so leave layers unfiltered for the next use however
+  // reading them ends.
+  struct ClearFilter
+  {
+    OGRLayer* layer;
+    bool clip;
+    ~ClearFilter() { if (clip) layer->SetSpatialFilter(nullptr); }
+  };
+}
+
+LayerReader::LayerReader(const ClipRegion& clip, double transformError) :
+  clip_(clip), transformError_(transformError)
+{
+}
+
+LayerReader::~LayerReader()
+{
+  stopping_ = true;
+  for (auto& state : states_)
+  {
+    lock_guard<mutex> lock(state->mutex);
+    state->changed.notify_all();
+  }
+  for (thread& worker : workers_) worker.join();
+
+  for (Handle& handle : handles_)
+  {
+    if (handle.owned) GDALClose(handle.dataset);
+  }
+}
+
+void LayerReader::lend(const string& path, GDALDataset* dataset)
+{
+  handles_.push_back(Handle{ path, dataset, false, false });
+}
+
+size_t LayerReader::addJob(Job job)
+{
+  jobs_.push_back(move(job));
+  return jobs_.size() - 1;
+}
+
+void LayerReader::start(unsigned int numThreads)
+{
+  if (numThreads == 0) numThreads = 1;
+
+  // Split big layers into a part for each worker, others are one part.
+  OGRSpatialReference wgs84;
+  wgs84.SetWellKnownGeogCS("WGS84");
+  for (size_t job = 0; job != jobs_.size(); ++job)
+  {
+    jobParts_.push_back(parts_.size());
+    addParts_(job, numThreads, wgs84);
+  }
+  jobParts_.push_back(parts_.size());
+  nextParts_.assign(jobParts_.begin(), jobParts_.end() - 1);
+  for (size_t i = 0; i != parts_.size(); ++i) states_.push_back(make_unique<PartState>());
+
+  const size_t numWorkers = max<size_t>(1, min<size_t>(numThreads, parts_.size()));
+  if (numWorkers == 1)
+  {
+    transformThreads_ = thread::hardware_concurrency();
+    if (transformThreads_ == 0) transformThreads_ = 1;
+  }
+
+  for (size_t i = 0; i != numWorkers; ++i) workers_.emplace_back(&LayerReader::work_, this);
+}
+
+bool LayerReader::next(size_t job, Batch& batch)
+{
+  for (size_t& part = nextParts_.at(job); part != jobParts_[job + 1]; ++part)
+  {
+    PartState& state = *states_[part];
+    unique_lock<mutex> lock(state.mutex);
+    state.changed.wait(lock, [&state]() { return !state.ready.empty() || state.done; });
+
+    if (!state.ready.empty())
+    {
+      batch = move(state.ready.front());
+      state.ready.pop_front();
+      state.changed.notify_all();
+      return true;
+    }
+
+    if (state.error) rethrow_exception(state.error);
+  }
+
+  return false;
+}
+
+GDALDataset* LayerReader::acquire_(const string& path)
+{
+  {
+    lock_guard<mutex> lock(handlesMutex_);
+    for (Handle& handle : handles_)
+    {
+      if (handle.path == path && !handle.inUse)
+      {
+        handle.inUse = true;
+        return handle.dataset;
+      }
+    }
+  }
+
+  GDALDataset* dataset =
+    static_cast<GDALDataset*>(GDALOpenEx(path.c_str(), GDAL_OF_VECTOR, NULL, NULL, NULL));
+  if (dataset == nullptr)
+  {
+    throw runtime_error(string("Error Opening Source: ") + path + "\n" + CPLGetLastErrorMsg());
+  }
+
+  lock_guard<mutex> lock(handlesMutex_);
+  handles_.push_back(Handle{ path, dataset, true, true });
+  return dataset;
+}
+
+void LayerReader::release_(GDALDataset* dataset)
+{
+  lock_guard<mutex> lock(handlesMutex_);
+  for (Handle& handle : handles_)
+  {
+    if (handle.dataset == dataset) handle.inUse = false;
+  }
+}
+
+void LayerReader::addParts_(size_t job, GIntBig numParts, OGRSpatialReference& trgtCS)
+{
+  const Part whole{ job, 0, -1, -1 };
+  const Job& info = jobs_[job];
+
+  // The lent handles are not in use yet.
+  auto lent = find_if(handles_.begin(), handles_.end(),
+    [&info](const Handle& handle) { return handle.path == info.path; });
+  OGRLayer *layer = numParts > 1 && lent != handles_.end() ?
+    lent->dataset->GetLayerByName(info.layerName.c_str()) : nullptr;
+  if (layer == nullptr)
+  {
+    parts_.push_back(whole);
+    return;
+  }
+
+  // Seeking has to stay fast with the same filter the workers will use.
+  const ClearFilter filter{ layer, clip_.isSet() };
+  const GIntBig count = setClipFilter(layer, clip_, trgtCS) ||
+    !layer->TestCapability(OLCFastSetNextByIndex) ||
+    !layer->TestCapability(OLCFastFeatureCount) ? 0 : layer->GetFeatureCount(FALSE);
+  if (count / MIN_PART_FEATURES < numParts) numParts = count / MIN_PART_FEATURES;
+
+  // Find the feature each part starts with. Parts that start with the same
+  // feature as the one before, or past the last, are left out.
+  vector<Part> split;
+  vector<GIntBig> startFids;
+  for (GIntBig part = 0; part < numParts; ++part)
+  {
+    const GIntBig first = count * part / numParts;
+    OGRFeatureWrapper feature;
+    if (layer->SetNextByIndex(first) != OGRERR_NONE ||
+      !(feature = layer->GetNextFeature()))
+    {
+      break;
+    }
+
+    const GIntBig fid = feature->GetFID();
+    if (fid == OGRNullFID)
+    {
+      split.clear();
+      break;
+    }
+    if (!startFids.empty() && startFids.back() == fid) continue;
+
+    split.push_back(Part{ job, first, -1, -1 });
+    startFids.push_back(fid);
+  }
+  layer->ResetReading();
+
+  if (split.size() < 2 || split.front().first != 0)
+  {
+    parts_.push_back(whole);
+    return;
+  }
+
+  // Reading on from first can never take more features than there are
+  // indexes before the next part, that only guards against a driver that
+  // does not read back in the same order.
+  for (size_t i = 0; i + 1 < split.size(); ++i)
+  {
+    split[i].count = split[i + 1].first - split[i].first;
+    split[i].stopFid = startFids[i + 1];
+  }
+  parts_.insert(parts_.end(), split.begin(), split.end());
+}
+
+void LayerReader::work_()
+{
+  // Each worker has its own transformations.
+  TransformCache transforms;
+
+  for (size_t part = nextPart_++; part < parts_.size() && !stopping_; part = nextPart_++)
+  {
+    PartState& state = *states_[part];
+    exception_ptr error;
+    try
+    {
+      read_(part, transforms);
+    }
+    catch (...)
+    {
+      error = current_exception();
+    }
+
+    lock_guard<mutex> lock(state.mutex);
+    state.error = error;
+    state.done = true;
+    state.changed.notify_all();
+  }
+}
+
+void LayerReader::read_(size_t part, TransformCache& transforms)
+{
+  const Part& range = parts_[part];
+  const Job& info = jobs_[range.job];
+
+  GDALDataset* dataset = acquire_(info.path);
+  struct Lease
+  {
+    LayerReader* reader;
+    GDALDataset* dataset;
+    ~Lease() { reader->release_(dataset); }
+  } lease{ this, dataset };
+
+  OGRLayer *layer = dataset->GetLayerByName(info.layerName.c_str());
+  if (layer == nullptr)
+  {
+    throw runtime_error(string("Unable to find layer ") + info.layerName +
+      " in source " + info.source);
+  }
+
+  // Check for a transform for this layer, none if it is already WGS84
+  OGRSpatialReference *srcCS = layer->GetSpatialRef();
+  OGRSpatialReference& trgtCS = transforms.target();
+  OGRCoordinateTransformation *trans = transforms.get(srcCS);
+  if (trans == nullptr && srcCS != nullptr && srcCS->IsProjected()) // Failure!!
+  {
+    throw runtime_error(
+      string("Unable to create coordinate transformation for source ") +
+      info.source + " and layer " + info.layerName);
+  }
+
+  // Skip layers entirely outside the clip region.
+  const ClearFilter filter{ layer, clip_.isSet() };
+  if (setClipFilter(layer, clip_, trgtCS)) return;
+
+  // Features are read in batches, and the vertices of a batch are
+  // transformed together. Those that fail to transform are left out.
+  const size_t batchLimit = TRANSFORM_BATCH_VERTICES * transformThreads_;
+  Batch batch;
+  size_t batchVertices = 0;
+  auto finishBatch = [&]()
+  {
+    const vector<bool> transformed = transformAllParallel(batch.geometries, transforms,
+      srcCS, transformThreads_, transformError_);
+
+    Batch kept;
+    for (size_t i = 0; i != batch.features.size(); ++i)
+    {
+      if (!transformed[i]) continue;
+
+      kept.labels.push_back(info.labelField.empty() ? string() :
+        string(batch.features[i]->GetFieldAsString(info.labelField.c_str())));
+      kept.geometries.push_back(batch.geometries[i]);
+      kept.features.push_back(move(batch.features[i]));
+    }
+    batch = Batch();
+    batchVertices = 0;
+    return kept.features.empty() || push_(part, move(kept));
+  };
+
+  layer->ResetReading();
+  if (range.first > 0 && layer->SetNextByIndex(range.first) != OGRERR_NONE)
+  {
+    throw runtime_error(string("Unable to read layer ") + info.layerName + 
+      " in source " + info.source + " from feature " + to_string(range.first));
+  }
+
+  OGRFeatureWrapper feature;
+  for (GIntBig read = 0; (range.count < 0 || read != range.count) && !stopping_ && 
+    (feature = layer->GetNextFeature()); ++read)
+  {
+    if (range.stopFid >= 0 && feature->GetFID() == range.stopFid) break;
+
+    OGRGeometry *geometry = feature->GetGeometryRef();
+    if (geometry == nullptr) continue;
+
+    batchVertices += countVertices(*geometry);
+    batch.geometries.push_back(geometry);
+    batch.features.push_back(move(feature));
+    if (batchVertices >= batchLimit && !finishBatch()) return;
+  }
+  finishBatch();
+}
+
+bool LayerReader::push_(size_t part, Batch&& batch)
+{
+  PartState& state = *states_[part];
+  unique_lock<mutex> lock(state.mutex);
+  state.changed.wait(lock,
+    [this, &state]() { return state.ready.size() < MAX_READY || stopping_; });
+  if (stopping_) return false;
+
+  state.ready.push_back(move(batch));
+  state.changed.notify_all();
+  return true;
+}
@@ -0,0 +1,170 @@
+/*
+Reads the features of source layers on worker threads.
+
+A project with a dozen shapefiles and a geodatabase would otherwise read them
+one after another on the thread building the place file. Instead each layer
+is a job, and workers take the jobs in order. GDAL datasets are not thread
+safe, so a worker borrows a handle to the source from a pool for the length
+of a job, and the pool opens another handle when all of those for a source
+are in use. The worker reads the features in batches, transforms them with
+its own transformations, and hands the batches to a small buffer for the job.
+
+One big layer, such as national roads, would still keep a single worker
+busy long after the rest are done. Where the driver can seek to the nth
+feature quickly and count the features without reading them, as shapefiles
+and file geodatabases can without a spatial filter, a big layer is split into
+parts of consecutive features, one per worker. Each part is read from its own
+handle, starting with SetNextByIndex, and stops at the feature the next part
+starts with. The index is not always a count of features, a shapefile counts
+its deleted records too, so reading on a number of features could overlap the
+next part.
+
+The caller takes the batches back job by job in the order the jobs were
+added, and the parts of a job in order, so the place file is the same
+whichever worker finishes first and however the layers were split. A worker
+that gets ahead waits once its buffer is full, which bounds the memory held
+by features that are read but not yet converted.
+
+Revisions:
+2026/10/16 - Initial version.
+
+*/
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "ogrsf_frmts.h"
+
+#include "ClipRegion.hpp"
+#include "OGRFeatureWrapper.hpp"
+
+namespace PFB
+{
+  class TransformCache;
+
+  class LayerReader
+  {
+  public:
+    /// A layer to read.
+    struct Job
+    {
+      std::string path;       // Of the source, to open more handles to it
+      std::string source;     // Name of the source, for error messages
+      std::string layerName;
+      std::string labelField; // Empty for no labels
+    };
+
+    /// Features read from a layer and transformed to WGS84 latitude and
+    /// longitude, with their labels. Those that could not be transformed are
+    /// left out.
+    struct Batch
+    {
+      std::vector<OGRWrapper::OGRFeatureWrapper> features;
+      std::vector<OGRGeometry*> geometries;
+      std::vector<std::string> labels;
+    };
+
+    /// Features outside clip are left out where the driver can tell, and
+    /// transformations are approximate within transformError meters.
+    LayerReader(const ClipRegion& clip, double transformError);
+
+    /// Stops the workers, abandoning any jobs not yet taken.
+    ~LayerReader();
+
+    LayerReader(const LayerReader&) = delete;
+    LayerReader& operator=(const LayerReader&) = delete;
+
+    /// Let the workers use an open handle to the source at path. It stays
+    /// open and owned by the caller, who must not use it until the reader is
+    /// destroyed.
+    void lend(const std::string& path, GDALDataset* dataset);
+
+    /// Add a job, returning its number for next. Jobs are only added before
+    /// start.
+    size_t addJob(Job job);
+
+    /// Start reading with numThreads workers, splitting big layers into as
+    /// many parts. With one worker the layers are read one at a time, and
+    /// each batch is transformed on all the threads the hardware has instead.
+    void start(unsigned int numThreads);
+
+    /// Move the next batch of a job into batch, false once there are no more.
+    /// Jobs must be finished in the order they were added. Any error reading
+    /// the job is thrown from here.
+    bool next(size_t job, Batch& batch);
+
+  private:
+    // Batches waiting in each part's buffer before its worker waits.
+    static const size_t MAX_READY = 4;
+
+    // Fewest features in a part of a split layer.
+    static const GIntBig MIN_PART_FEATURES = 20000;
+
+    // Consecutive features of a job's layer from index first, up to the
+    // feature with stopFid. Either count or stopFid is -1 to read to the end.
+    struct Part
+    {
+      size_t job;
+      GIntBig first;
+      GIntBig count;   // At most this many features
+      GIntBig stopFid;
+    };
+
+    // Progress of one part, shared by its worker and the caller.
+    struct PartState
+    {
+      std::mutex mutex;
+      std::condition_variable changed;
+      std::deque<Batch> ready;
+      bool done = false;
+      std::exception_ptr error;
+    };
+
+    // A handle to a source, either lent or opened by the pool.
+    struct Handle
+    {
+      std::string path;
+      GDALDataset* dataset;
+      bool owned;
+      bool inUse;
+    };
+
+    ClipRegion clip_;
+    double transformError_;
+    unsigned int transformThreads_ = 1;
+
+    std::vector<Job> jobs_;
+    std::vector<size_t> jobParts_;  // First part of each job, and one past the last
+    std::vector<size_t> nextParts_; // Next part of each job for the caller
+    std::vector<Part> parts_;
+    std::vector<std::unique_ptr<PartState>> states_;
+    std::atomic<size_t> nextPart_{ 0 };
+    std::atomic<bool> stopping_{ false };
+    std::vector<std::thread> workers_;
+
+    std::mutex handlesMutex_;
+    std::vector<Handle> handles_;
+
+    GDALDataset* acquire_(const std::string& path);
+    void release_(GDALDataset* dataset);
+
+    // Add the parts of a job, splitting it into as many as numParts if the
+    // layer can be read in parts. Only used before the workers start.
+    void addParts_(size_t job, GIntBig numParts, OGRSpatialReference& trgtCS);
+
+    void work_();
+    void read_(size_t part, TransformCache& transforms);
+
+    // Wait for room in the part's buffer, false if stopping instead.
+    bool push_(size_t part, Batch&& batch);
+  };
+}
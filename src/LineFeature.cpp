@@ -1,4 +1,5 @@
 #include "LineFeature.hpp"
+#include "VertexCleanup.hpp"
 #include <iomanip>
 
 using PFB::LineFeature;
@@ -23,33 +24,44 @@ PFB::LineFeature::LineFeature(const string & label, const PlaceFileColor & color
 : Feature(label, color, dispThresh, lineWidth), _coords( coords ){}
 
 PFB::LineFeature::LineFeature(const string& label, const PlaceFileColor& color,
-  const OGRLineString& lineString, int dispThresh, int lineWidth, bool forceClosed)
+  const OGRLineString& lineString, int dispThresh, int lineWidth, bool forceClosed,
+  const GeometryOptions& geo, uint64_t* verticesCleaned)
 :Feature(label, color, dispThresh, lineWidth)
 {
   int numPoints = lineString.getNumPoints();
-  int increment = 1;
-  while (numPoints / increment > 10000) {
-    increment++;
-  }
 
-  _coords.reserve(numPoints / increment + 1);
+  _coords.reserve(numPoints + 1);
+
+  const bool close = forceClosed && 
+    (lineString.getY(numPoints - 1) != lineString.getY(0) ||
+     lineString.getX(numPoints - 1) != lineString.getX(0));
 
-  for (int i = 0; i < numPoints; i += increment)
+  if (geo.cleanVertices)
   {
-    _coords.push_back(point(lineString.getY(i), lineString.getX(i)));
+    VertexCleaner cleaner(_coords, geo.snapDecimals);
+    for (int i = 0; i < numPoints; ++i) cleaner.add(lineString.getY(i), lineString.getX(i));
+    if (close) cleaner.add(lineString.getY(0), lineString.getX(0));
+    const size_t removed = cleaner.finish();
+    if (verticesCleaned) *verticesCleaned += removed;
   }
-
-  // Close the loop if needed.
-  if(forceClosed && 
-    (lineString.getY(numPoints - 1) != lineString.getY(0) ||
-     lineString.getX(numPoints - 1) != lineString.getX(0)))
+  else
   {
-    _coords.push_back(point(lineString.getY(0), lineString.getX(0)));
+    for (int i = 0; i < numPoints; ++i)
+    {
+      _coords.push_back(point(lineString.getY(i), lineString.getX(i)));
+    }
+
+    // Close the loop if needed.
+    if (close) _coords.push_back(point(lineString.getY(0), lineString.getX(0)));
   }
+
+  // Also keeps it within the number of points GRLevelX can handle.
+  simplifyLine(_coords, geo.simplify, geo.toleranceMeters, geo.maxLinePoints);
 }
 
 vector<LP> PFB::LineFeature::PolygonToLines(const string & label, 
-  const PlaceFileColor & color, const OGRPolygon & polygon, int dispThresh, int lineWidth)
+  const PlaceFileColor & color, const OGRPolygon & polygon, int dispThresh, int lineWidth,
+  const GeometryOptions& geo, uint64_t* verticesCleaned)
 {
   using VLF = vector<LP>;
   // Get the number of lines in this polygon
@@ -72,7 +84,7 @@ vector<LP> PFB::LineFeature::PolygonToLines(const string & label,
       ls = polygon.getInteriorRing(l - 1);
     }
     result.push_back(move(LP( 
-      new LineFeature(label, color, *ls, dispThresh, lineWidth, true))));
+      new LineFeature(label, color, *ls, dispThresh, lineWidth, true, geo, verticesCleaned))));
   }
 
   return result;
@@ -83,6 +95,13 @@ PFB::LineFeature::LineFeature(LineFeature && src)
 
 PFB::LineFeature::~LineFeature(){}
 
+PFB::Bounds PFB::LineFeature::getBounds() const
+{
+  Bounds bounds;
+  for (const point& pnt : _coords) bounds.extend(pnt);
+  return bounds;
+}
+
 LineFeature & PFB::LineFeature::operator=(LineFeature && src)
 {
   Feature::operator=(std::move(src));
@@ -90,11 +109,10 @@ LineFeature & PFB::LineFeature::operator=(LineFeature && src)
   return *this;
 }
 
-std::ostream & LineFeature::put(std::ostream & ost) const
+PFB::StyleState LineFeature::put(std::ostream & ost, const StyleState& prev,
+  CoordinateFormatter& fmt) const
 {
-  // Eventually add width to Feature and use here instead of 2
-  if(includeColor_) ost << "\n" << getColorString() << "\n";
-  if(includeThreshold_) ost << "\nThreshold: " << getDisplayThreshold() << "\n";
+  StyleState state = putStyle(ost, prev);
 
   string label = getLabelString();
   /*Need to strip leading whitespace from the string*/
@@ -105,14 +123,9 @@ std::ostream & LineFeature::put(std::ostream & ost) const
   else ost << "\n";
 
   // Output for each point.
-  size_t nPoints = _coords.size();
-  for (size_t i = 0; i != nPoints; ++i)
-  {
-    const point& currPnt = _coords[i];
-    ost << "  " << currPnt.latitude << "," << currPnt.longitude << "\n";
-  }
+  writeCoordinates(ost, fmt, _coords);
 
   ost << "End:\n\n";
 
-  return ost;
+  return state;
 }
@@ -13,8 +13,10 @@ Revisions:
 #include "Feature.hpp"
 #include "point.hpp"
 #include "PolygonFeature.hpp"
+#include "Simplify.hpp"
 
 #include <vector>
+#include <cstdint>
 #include <cstdio>
 #include <memory>
 
@@ -46,14 +48,18 @@ namespace PFB
       const vector<point>& coords, int dispThresh, int lineWidth);
 
     /// Create a line from a feature loaded in via GDAL library
-    /// forceClosed makes the last point = first point
+    /// forceClosed makes the last point = first point. The line is cleaned up
+    /// and simplified as set in geo, the number of vertices the cleanup removes
+    /// is added to verticesCleaned if it is not null.
     LineFeature(const string& label, const PlaceFileColor& color, const OGRLineString& lineString, 
-      int dispThresh, int lineWidth, bool forceClosed = false);
+      int dispThresh, int lineWidth, bool forceClosed = false,
+      const GeometryOptions& geo = GeometryOptions(), uint64_t* verticesCleaned = nullptr);
 
     /// Create a vector of lines from a polygon feature loaded in via GDAL
     using LP = std::unique_ptr<LineFeature>;
     static vector<LP> PolygonToLines(const string& label, 
-      const PlaceFileColor& color, const OGRPolygon& polygon, int dispThresh, int lineWidth);
+      const PlaceFileColor& color, const OGRPolygon& polygon, int dispThresh, int lineWidth,
+      const GeometryOptions& geo = GeometryOptions(), uint64_t* verticesCleaned = nullptr);
 
     /// Move Constructor
     LineFeature(LineFeature && src);
@@ -64,6 +70,12 @@ namespace PFB
       return FeatureType::LINE;
     }
 
+    /// Return the number of points in the line
+    size_t getNumPoints() const override { return _coords.size(); }
+
+    /// Return the box around the line
+    Bounds getBounds() const override;
+
     /// Destructor required by Abstract Base Class.
     ~LineFeature();
 
@@ -72,7 +84,8 @@ namespace PFB
 
     /// Create a string suitable to write to a place file describing this line 
     /// as a Line and put it out to this stream.
-    std::ostream& put(std::ostream& ost) const override;
+    StyleState put(std::ostream& ost, const StyleState& prev,
+      CoordinateFormatter& fmt) const override;
 
   private:
     vector<point> _coords;
@@ -0,0 +1,99 @@
+#include "LineMerge.hpp"
+
+#include <algorithm>
+#include <unordered_map>
+#include <utility>
+
+using namespace std;
+using PFB::point;
+
+namespace
+{
+  // Lines with an end at a point, the line index times 2, plus 1 for the back.
+  using EndIndex = unordered_multimap<point, size_t, PFB::PointHash, PFB::PointEqual>;
+
+  // Find a line not used yet with an end at pnt. Returns the end, or -1.
+  ptrdiff_t findEnd(const EndIndex& ends, const vector<char>& used, const point& pnt)
+  {
+    auto range = ends.equal_range(pnt);
+    for (auto it = range.first; it != range.second; ++it)
+    {
+      if (!used[it->second / 2]) return static_cast<ptrdiff_t>(it->second);
+    }
+    return -1;
+  }
+
+  // Keep adding lines to the back of chain until none meet it.
+  void extend(vector<point>& chain, vector<vector<point>>& lines, 
+    const EndIndex& ends, vector<char>& used)
+  {
+    ptrdiff_t end;
+    while ((end = findEnd(ends, used, chain.back())) >= 0)
+    {
+      vector<point>& line = lines[end / 2];
+      used[end / 2] = 1;
+      if (end % 2 == 0) chain.insert(chain.end(), line.begin() + 1, line.end());
+      else chain.insert(chain.end(), line.rbegin() + 1, line.rend());
+      line = vector<point>();
+    }
+  }
+}
+
+vector<vector<point>> PFB::mergeLines(vector<vector<point>>&& lines)
+{
+  EndIndex ends;
+  ends.reserve(2 * lines.size());
+  vector<char> used(lines.size(), 0);
+  for (size_t i = 0; i != lines.size(); ++i)
+  {
+    if (lines[i].size() < 2)
+    {
+      used[i] = 1;
+      continue;
+    }
+    ends.emplace(lines[i].front(), 2 * i);
+    ends.emplace(lines[i].back(), 2 * i + 1);
+  }
+
+  vector<vector<point>> merged;
+  for (size_t i = 0; i != lines.size(); ++i)
+  {
+    if (used[i]) continue;
+    used[i] = 1;
+
+    // Grow from the back, then from the front by turning it around, so a
+    // line that is not joined keeps its direction.
+    vector<point> chain = move(lines[i]);
+    extend(chain, lines, ends, used);
+    if (findEnd(ends, used, chain.front()) >= 0)
+    {
+      reverse(chain.begin(), chain.end());
+      extend(chain, lines, ends, used);
+      reverse(chain.begin(), chain.end());
+    }
+
+    merged.push_back(move(chain));
+  }
+  return merged;
+}
+
+vector<vector<point>> PFB::splitLine(vector<point>&& line, size_t maxPoints)
+{
+  vector<vector<point>> pieces;
+  if (maxPoints < 2 || line.size() <= maxPoints)
+  {
+    pieces.push_back(move(line));
+    return pieces;
+  }
+
+  // Spread the segments over as few pieces as will hold them.
+  const size_t segments = line.size() - 1;
+  const size_t count = (segments + maxPoints - 2) / (maxPoints - 1);
+  for (size_t i = 0; i != count; ++i)
+  {
+    const size_t first = segments * i / count;
+    const size_t last = segments * (i + 1) / count;
+    pieces.emplace_back(line.begin() + first, line.begin() + last + 1);
+  }
+  return pieces;
+}
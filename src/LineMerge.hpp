@@ -0,0 +1,31 @@
+/*
+Joins lines that meet end to end into longer lines.
+
+Road and river data often break one feature into many short segments, each of
+which would be written as its own Line: block. Lines are joined wherever an end
+of one is the same point as an end of another, found with a hash index of the
+end points, reversing lines as needed.
+
+Revisions:
+2026/10/16 - Initial version.
+
+*/
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+#include "point.hpp"
+
+namespace PFB
+{
+  /// Join lines whose end points coincide, returns the joined lines. Lines
+  /// with fewer than 2 points are left out. Where more than two lines meet
+  /// at a point, which pair is joined depends on the order of the lines.
+  std::vector<std::vector<point>> mergeLines(std::vector<std::vector<point>>&& lines);
+
+  /// Split a line into pieces of at most maxPoints, each starting at the
+  /// last point of the one before, as evenly as possible. A line that fits,
+  /// or a maxPoints below 2, is returned whole.
+  std::vector<std::vector<point>> splitLine(std::vector<point>&& line, size_t maxPoints);
+}
@@ -1,52 +1,375 @@
 #include "PlaceFile.hpp"
 
+#include <algorithm>
+#include <deque>
 #include <exception>
+#include <future>
 #include <sstream>
+#include <thread>
 
+#include "cpl_vsi.h"
+
+#include "ContentHash.hpp"
+#include "FormattedText.hpp"
+#include "HilbertOrder.hpp"
+#include "LayerFormatter.hpp"
 #include "PointFeature.hpp"
 #include "PolygonFeature.hpp"
 #include "LineFeature.hpp"
-#include "OFileWrapper.hpp"
+#include "PlaceFileWriter.hpp"
 
 using namespace std;
-using namespace Win32Helper;
 using namespace PFB;
 using LP = PFB::LineFeature::LP;
 
-PFB::PlaceFile::PlaceFile()
+PFB::PlaceFile::PlaceFile() :
+  _formatter(new LayerFormatter)
 {
+  _layers.push_back(Layer("", CoordinateFormatter::PRECISION_DEFAULT, 0));
 }
 
 PFB::PlaceFile::~PlaceFile()
 {
 }
 
-void PFB::PlaceFile::saveFile(const string & path)
+namespace
+{
+  bool fileExists(const string& path, uint64_t* size = nullptr)
+  {
+    VSIStatBufL stat;
+    if (VSIStatL(path.c_str(), &stat) != 0) return false;
+    if (size) *size = static_cast<uint64_t>(stat.st_size);
+    return true;
+  }
+
+  // Hash of a place file from its header and the hashes of its layers. Those
+  // cover the text and style of each feature in the order written, which
+  // with the header and the grouping fixes every byte of the file, so the
+  // hash is known without writing it.
+  uint64_t fileHash(const string& header, bool grouped,
+    const vector<PlaceFile::LayerStats>& layers, PlaceFile::Output output)
+  {
+    uint64_t hash = hashCombine(hashBytes(header.data(), header.size()), grouped);
+    for (const PlaceFile::LayerStats& layer : layers)
+    {
+      hash = hashCombine(hashCombine(hash, layer.hash), layer.bytes);
+    }
+    return hashCombine(hash, static_cast<uint64_t>(output));
+  }
+
+  vector<point> pointsOf(const OGRLineString& ls)
+  {
+    vector<point> pts;
+    pts.reserve(ls.getNumPoints());
+    for (int i = 0; i < ls.getNumPoints(); ++i) pts.push_back(point(ls.getY(i), ls.getX(i)));
+    return pts;
+  }
+
+  template<class LineType>
+  LineType* lineOf(const vector<point>& pts)
+  {
+    LineType* line = new LineType;
+    line->setNumPoints(static_cast<int>(pts.size()), FALSE);
+    for (size_t i = 0; i < pts.size(); ++i)
+    {
+      line->setPoint(static_cast<int>(i), pts[i].longitude, pts[i].latitude);
+    }
+    return line;
+  }
+
+  enum class Clipped { INSIDE, OUTSIDE, CUT };
+
+  // Cut a geometry in latitude and longitude to the region. If only part of
+  // it is inside, cut is set to that part. Polygons drawn as lines have their
+  // rings cut like lines, closing them along the edge of the region would
+  // draw the edge.
+  Clipped clipGeometry(const ClipRegion& clip, const OGRGeometry& ft, bool ringsAsLines,
+    unique_ptr<OGRGeometry>& cut)
+  {
+    OGREnvelope env;
+    ft.getEnvelope(&env);
+    if (!clip.intersects(env.MinY, env.MinX, env.MaxY, env.MaxX)) return Clipped::OUTSIDE;
+    if (clip.contains(point(env.MinY, env.MinX)) && clip.contains(point(env.MaxY, env.MaxX)))
+    {
+      return Clipped::INSIDE;
+    }
+
+    const OGRwkbGeometryType geoType = wkbFlatten(ft.getGeometryType());
+    switch (geoType)
+    {
+    case wkbLineString:
+    case wkbLinearRing:
+    {
+      vector<vector<point>> pieces = 
+        clip.clipLine(pointsOf(static_cast<const OGRLineString&>(ft)));
+      if (pieces.empty()) return Clipped::OUTSIDE;
+      OGRMultiLineString* lines = new OGRMultiLineString;
+      for (const vector<point>& piece : pieces) 
+      {
+        lines->addGeometryDirectly(lineOf<OGRLineString>(piece));
+      }
+      cut.reset(lines);
+      return Clipped::CUT;
+    }
+
+    case wkbPolygon:
+    {
+      const OGRPolygon& poly = static_cast<const OGRPolygon&>(ft);
+      if (ringsAsLines)
+      {
+        unique_ptr<OGRMultiLineString> lines(new OGRMultiLineString);
+        for (int i = -1; i != poly.getNumInteriorRings(); ++i)
+        {
+          const OGRLinearRing& ring = 
+            i < 0 ? *poly.getExteriorRing() : *poly.getInteriorRing(i);
+          vector<vector<point>> pieces = clip.clipLine(pointsOf(ring));
+
+          // A ring that starts inside is cut at its first point as well, join
+          // the pieces on either side of it.
+          if (pieces.size() > 1 && PointEqual()(pieces.back().back(), pieces.front().front()))
+          {
+            pieces.back().insert(pieces.back().end(), pieces.front().begin() + 1, 
+              pieces.front().end());
+            pieces.front() = move(pieces.back());
+            pieces.pop_back();
+          }
+
+          for (const vector<point>& piece : pieces)
+          {
+            lines->addGeometryDirectly(lineOf<OGRLineString>(piece));
+          }
+        }
+        if (lines->getNumGeometries() == 0) return Clipped::OUTSIDE;
+        cut = move(lines);
+        return Clipped::CUT;
+      }
+
+      vector<point> exterior = clip.clipRing(pointsOf(*poly.getExteriorRing()));
+      if (exterior.empty()) return Clipped::OUTSIDE;
+      OGRPolygon* clipped = new OGRPolygon;
+      clipped->addRingDirectly(lineOf<OGRLinearRing>(exterior));
+      for (int i = 0; i != poly.getNumInteriorRings(); ++i)
+      {
+        vector<point> interior = clip.clipRing(pointsOf(*poly.getInteriorRing(i)));
+        if (!interior.empty()) clipped->addRingDirectly(lineOf<OGRLinearRing>(interior));
+      }
+      cut.reset(clipped);
+      return Clipped::CUT;
+    }
+
+    case wkbMultiPoint:
+    case wkbMultiLineString:
+    case wkbMultiPolygon:
+    {
+      // Cut lines come back as several lines, so the parts are added one by
+      // one to keep the collection a single type. Polygons drawn as lines
+      // mix whole polygons with the lines cut from others.
+      const OGRGeometryCollection& coll = static_cast<const OGRGeometryCollection&>(ft);
+      unique_ptr<OGRGeometry> clipped(OGRGeometryFactory::createGeometry(
+        ringsAsLines && geoType == wkbMultiPolygon ? wkbGeometryCollection : geoType));
+      OGRGeometryCollection& parts = static_cast<OGRGeometryCollection&>(*clipped);
+      for (int i = 0; i != coll.getNumGeometries(); ++i)
+      {
+        const OGRGeometry& part = *coll.getGeometryRef(i);
+        unique_ptr<OGRGeometry> partCut;
+        const Clipped partClipped = clipGeometry(clip, part, ringsAsLines, partCut);
+        if (partClipped == Clipped::INSIDE) parts.addGeometry(&part);
+        else if (partClipped == Clipped::CUT && 
+          wkbFlatten(partCut->getGeometryType()) == wkbMultiLineString)
+        {
+          const OGRGeometryCollection& lines = 
+            static_cast<const OGRGeometryCollection&>(*partCut);
+          for (int j = 0; j != lines.getNumGeometries(); ++j)
+          {
+            parts.addGeometry(lines.getGeometryRef(j));
+          }
+        }
+        else if (partClipped == Clipped::CUT) parts.addGeometryDirectly(partCut.release());
+      }
+      if (parts.getNumGeometries() == 0) return Clipped::OUTSIDE;
+      cut = move(clipped);
+      return Clipped::CUT;
+    }
+
+    default:
+      // Points are either inside or outside the envelope check, anything
+      // else is left for addGeometry_ to report.
+      return Clipped::INSIDE;
+    }
+  }
+}
+
+uint64_t PFB::PlaceFile::saveFile(const string & path, Output output, 
+  uint64_t previousHash)
+{
+  const string plain = output == Output::GZIP ? string() : plainPath(path);
+  const string gzip = output == Output::PLAIN ? string() : gzipPath(path);
+  endLayer();
+  while (!_formatter->empty()) finishFormatting_();
+
+  _saveStats = SaveStats();
+  _formattedLayers.clear();
+  vector<FormattedLayerPtr>* keep = _keepFormattedLayers ? &_formattedLayers : nullptr;
+  const string header = header_();
+  if (_groupByStyle) _saveStats.styleBytesSaved = styleBytesSaved();
+
+  // Only skip the save if the old files are still there. Which files were
+  // written is part of the hash, so a stale .gz from an earlier save is not
+  // mistaken for the current one.
+  auto unchanged = [&]()
+  {
+    uint64_t plainSize = 0;
+    return previousHash != 0 && previousHash == _saveStats.hash &&
+      (plain.empty() || 
+        (fileExists(plain, &plainSize) && plainSize == _saveStats.bytesWritten)) &&
+      (gzip.empty() || fileExists(gzip, &_saveStats.gzipBytesWritten));
+  };
+
+  // With every feature formatted the hash is known without writing.
+  if (previousHash != 0 && _features.empty())
+  {
+    write_(nullptr, &_saveStats.layers, keep);
+    _saveStats.bytesWritten = header.size();
+    for (const LayerStats& layer : _saveStats.layers) _saveStats.bytesWritten += layer.bytes;
+    _saveStats.hash = fileHash(header, _groupByStyle, _saveStats.layers, output);
+    _saveStats.unchanged = unchanged();
+    if (_saveStats.unchanged) return _saveStats.bytesWritten;
+    _saveStats.gzipBytesWritten = 0;
+  }
+
+  // Stream straight to the file rather than building a copy in memory first.
+  PlaceFileWriter out(plain, gzip);
+  ostream ost(&out);
+  write_(&ost, &_saveStats.layers, keep);
+  out.close();
+
+  _saveStats.bytesWritten = out.bytesWritten();
+  _saveStats.hash = fileHash(header, _groupByStyle, _saveStats.layers, output);
+  _saveStats.unchanged = unchanged();
+  _saveStats.gzipBytesWritten = out.gzipBytesWritten();
+
+  if (_saveStats.unchanged) out.discard();
+  else out.publish();
+
+  return _saveStats.bytesWritten;
+}
+
+string PFB::PlaceFile::plainPath(const string& path)
+{
+  const string ext = ".gz";
+  if (path.size() > ext.size() && 
+    path.compare(path.size() - ext.size(), ext.size(), ext) == 0)
+  {
+    return path.substr(0, path.size() - ext.size());
+  }
+  return path;
+}
+
+string PFB::PlaceFile::gzipPath(const string& path)
 {
-  OFileWrapper out(path, ios::out | ios::trunc);
-  stringstream s;
-  s << *this;
-  out.file << s.rdbuf();
+  return plainPath(path) + ".gz";
 }
 
 void PFB::PlaceFile::addFeature(FP&& ft)
 {
+  _layers.back().verticesIn += ft->getNumPoints();
+  _layers.back().verticesOut += ft->getNumPoints();
   _features[_nextKey++] = move(ft);
+  formatPart_();
 }
 
 void PFB::PlaceFile::addOGRGeometry(const string& label, const PlaceFileColor& color, 
   OGRGeometry& ft, OGRCoordinateTransformation *trans, bool PolyAsString, int displayThresh, 
-  int lineWidth)
+  int lineWidth, const GeometryOptions& geo)
 {
-  FP newFeature;
-  vector<Feature*> multiGeo;
-
   // This is bizarre, but somehow a null reference is getting in here. If this
   // happens, just skip trying to add it and move on silently for now.
   if (!&ft) return;
 
+  if (!_clip.isSet())
+  {
+    addGeometry_(label, color, ft, trans, PolyAsString, displayThresh, lineWidth, geo);
+    formatPart_();
+    return;
+  }
+
+  // The region is in latitude and longitude, so transform before clipping.
+  if (trans != nullptr) ft.transform(trans);
+
+  // Polygons drawn as shared edges are cut as the edges are written, see
+  // addSharedEdges_, so each edge is still written once.
+  const OGRwkbGeometryType geoType = wkbFlatten(ft.getGeometryType());
+  if (PolyAsString && geo.shareEdges && (geoType == wkbPolygon || geoType == wkbMultiPolygon))
+  {
+    OGREnvelope env;
+    ft.getEnvelope(&env);
+    if (_clip.intersects(env.MinY, env.MinX, env.MaxY, env.MaxX))
+    {
+      addGeometry_(label, color, ft, nullptr, PolyAsString, displayThresh, lineWidth, geo);
+    }
+    formatPart_();
+    return;
+  }
+
+  unique_ptr<OGRGeometry> cut;
+  switch (clipGeometry(_clip, ft, PolyAsString, cut))
+  {
+  case Clipped::INSIDE:
+    addGeometry_(label, color, ft, nullptr, PolyAsString, displayThresh, lineWidth, geo);
+    break;
+  case Clipped::CUT:
+    addGeometry_(label, color, *cut, nullptr, PolyAsString, displayThresh, lineWidth, geo);
+    break;
+  case Clipped::OUTSIDE:
+    break;
+  }
+  formatPart_();
+}
+
+uint64_t PFB::PlaceFile::polygonNumPoints_(const OGRPolygon& polygon)
+{
+  uint64_t numPoints = polygon.getExteriorRing()->getNumPoints();
+  for (int i = 0; i != polygon.getNumInteriorRings(); ++i)
+  {
+    numPoints += polygon.getInteriorRing(i)->getNumPoints();
+  }
+  return numPoints;
+}
+
+void PFB::PlaceFile::addGeometry_(const string& label, const PlaceFileColor& color, 
+  OGRGeometry& ft, OGRCoordinateTransformation *trans, bool PolyAsString, int displayThresh, 
+  int lineWidth, const GeometryOptions& geo)
+{
+  FP newFeature;
+  vector<Feature*> multiGeo;
+
   auto geoType = wkbFlatten(ft.getGeometryType());
 
+  if (!geo.detailThresholds.empty() && geoType != wkbPoint && geoType != wkbMultiPoint)
+  {
+    addDetailLevels_(label, color, ft, trans, PolyAsString, displayThresh, lineWidth, geo);
+    return;
+  }
+
+  if (geo.cleanVertices && geo.snapDecimals < 0)
+  {
+    GeometryOptions snapped = geo;
+    snapped.snapDecimals = layerDecimals_(displayThresh);
+    addGeometry_(label, color, ft, trans, PolyAsString, displayThresh, lineWidth, snapped);
+    return;
+  }
+
+  const bool simplifies = geo.simplify != SimplifyMethod::NONE && geo.toleranceMeters > 0.0;
+  const bool isLine = geoType == wkbLineString || geoType == wkbLinearRing;
+  if ((geo.preserveTopology && simplifies && (isLine || geoType == wkbPolygon)) ||
+    (geo.shareEdges && PolyAsString && geoType == wkbPolygon) ||
+    (geo.mergeLines && isLine))
+  {
+    if (trans != nullptr) ft.transform(trans);
+    addPending_(label, color, ft, PolyAsString, displayThresh, lineWidth, geo);
+    return;
+  }
+
   // Switch statement based on type
   int numGeos = 0;
   OGRPoint *poPoint;
@@ -60,6 +383,7 @@ void PFB::PlaceFile::addOGRGeometry(const string& label, const PlaceFileColor& c
     poPoint = (OGRPoint *)&ft;
     if (trans != nullptr) poPoint->transform(trans);
     newFeature = FP(new PointFeature(label, color, *poPoint, displayThresh));
+    _layers.back().verticesIn += 1;
     break;
 
   // LinearRing is a subclass of LineString and works with the same interface.
@@ -72,13 +396,16 @@ void PFB::PlaceFile::addOGRGeometry(const string& label, const PlaceFileColor& c
     // that GRAnalyst errors on.
     if (poLine->getNumPoints() > 1)
     {
-      newFeature = FP(new LineFeature(label, color, *poLine, displayThresh, lineWidth));
+      _layers.back().verticesIn += poLine->getNumPoints();
+      newFeature = FP(new LineFeature(label, color, *poLine, displayThresh, lineWidth,
+        false, geo, &_layers.back().verticesCleaned));
     }
     break;
 
   case wkbPolygon: 
     poPoly = (OGRPolygon *)&ft;
     if (trans != nullptr) poPoly->transform(trans);
+    _layers.back().verticesIn += polygonNumPoints_(*poPoly);
     if (PolyAsString)
     {
       /*************************************************************************
@@ -86,9 +413,11 @@ void PFB::PlaceFile::addOGRGeometry(const string& label, const PlaceFileColor& c
       * setting a value for feature and going to the end of the function.      *
       *************************************************************************/
       vector<LP> lines = 
-          LineFeature::PolygonToLines(label, color, *poPoly, displayThresh, lineWidth);
+          LineFeature::PolygonToLines(label, color, *poPoly, displayThresh, lineWidth, geo,
+            &_layers.back().verticesCleaned);
       while(!lines.empty())
       {
+        _layers.back().verticesOut += lines.back()->getNumPoints();
         _features[_nextKey++] = move(lines.back());
         lines.pop_back();
       }
@@ -96,19 +425,21 @@ void PFB::PlaceFile::addOGRGeometry(const string& label, const PlaceFileColor& c
     }
     else
     {
-      newFeature = FP(new PolygonFeature(label, color, *poPoly, displayThresh, lineWidth));
+      newFeature = FP(new PolygonFeature(label, color, *poPoly, displayThresh, lineWidth,
+        geo, &_layers.back().verticesCleaned));
     }
     break;
 
   case wkbMultiLineString: 
   case wkbMultiPolygon: 
   case wkbMultiPoint: 
+  case wkbGeometryCollection: 
     coll = (OGRGeometryCollection *)&ft;
     numGeos = coll->getNumGeometries();
     for (int i = 0; i != numGeos; ++i)
     {
       tmp = coll->getGeometryRef(i);
-      addOGRGeometry(label, color, *tmp, trans, PolyAsString, displayThresh, lineWidth);
+      addGeometry_(label, color, *tmp, trans, PolyAsString, displayThresh, lineWidth, geo);
     }
     break;
 
@@ -123,10 +454,58 @@ void PFB::PlaceFile::addOGRGeometry(const string& label, const PlaceFileColor& c
   // Add it to my local collection
   if (newFeature)
   {
+    _layers.back().verticesOut += newFeature->getNumPoints();
     _features[_nextKey++] = move(newFeature);
   }
 }
 
+void PFB::PlaceFile::endLayer()
+{
+  if (!_pending.empty()) addPendingFeatures_();
+  if (_hilbertOrder) orderLayer_();
+  if (_formatEarly) formatLayer_();
+}
+
+void PFB::PlaceFile::orderLayer_()
+{
+  // The layer keeps the same keys, the features are moved between them.
+  vector<size_t> keys;
+  vector<Bounds> bounds;
+  for (auto it = _features.lower_bound(_layers.back().firstKey); it != _features.end(); ++it)
+  {
+    keys.push_back(it->first);
+    bounds.push_back(it->second->getBounds());
+  }
+
+  const vector<size_t> order = hilbertOrder(bounds);
+  vector<FP> features;
+  features.reserve(order.size());
+  for (size_t i : order) features.push_back(move(_features[keys[i]]));
+  for (size_t i = 0; i != keys.size(); ++i) _features[keys[i]] = move(features[i]);
+}
+
+int PFB::PlaceFile::layerDecimals_(int displayThresh) const
+{
+  const int policy = _layers.back().precision == CoordinateFormatter::PRECISION_DEFAULT ?
+    _precision : _layers.back().precision;
+  return CoordinateFormatter::decimalsForPolicy(policy, displayThresh);
+}
+
+size_t PFB::PlaceFile::beginLayer(const string& name, int precision)
+{
+  endLayer();
+
+  // Nothing was added to the unnamed first layer, so replace it.
+  if (_layers.size() == 1 && _layers[0].firstKey == _nextKey && 
+    _layers[0].name.empty() && !_layers[0].formatted)
+  {
+    _layers.pop_back();
+  }
+
+  _layers.push_back(Layer(name, precision, _nextKey));
+  return _layers.size() - 1;
+}
+
 void PFB::PlaceFile::deleteFeature(const size_t key)
 {
   if (_features.find(key) != _features.end())
@@ -187,57 +566,379 @@ string PFB::PlaceFile::getTitle() const
   return _title;
 }
 
-ostream& PFB::operator<<(ostream& ost, const PlaceFile& pf)
+
+size_t PFB::PlaceFile::addFormattedLayer(const string& name,
+  FormattedLayerPtr formatted)
 {
-  // Set precision
-  auto oldFormatFlags = ost.flags();
-  ost.precision(10);
-  ost << fixed;
+  const size_t index = beginLayer(name, formatted->precision);
+  _layers[index].formatted = formatted;
+  return index;
+}
 
-  // Header, data that goes at the top.
-  ost << "Title: " << pf._title << "\n";
-  if(pf.getRefreshMinutes() > 0) ost << "Refresh: " << pf.getRefreshMinutes() << "\n";
-  if (pf.getRefreshSeconds() > 0) ost << "RefreshSeconds: " << pf.getRefreshSeconds() << "\n";
-  ost << "Threshold: " << pf.getThreshold() << "\n";
+PlaceFile::FormattedLayerPtr PFB::PlaceFile::getFormattedLayer(size_t layer) const
+{
+  return layer < _formattedLayers.size() ? _formattedLayers[layer] : nullptr;
+}
 
-  // Font required for PointFeatures without a label.
-  ost << "Font: 1,16,1,courier\n\n";
+void PFB::PlaceFile::setSpillPath(const string& prefix)
+{
+  _formatter->setSpillPath(prefix);
+}
 
-  // Loop through 3 times, once for each geometry type. Put out polygons first,
-  // then lines, then points.
-  string colorString;
-  int displayThresh = pf.getThreshold();
+const string& PFB::PlaceFile::getSpillPath() const
+{
+  return _formatter->getSpillPath();
+}
+
+void PFB::PlaceFile::formatLayer_()
+{
+  Layer& layer = _layers.back();
+  auto first = _features.lower_bound(layer.firstKey);
+  if (first == _features.end()) return;
+
+  // The statistics go with the text, which is joined to what the layer
+  // already has when it is done.
+  auto text = make_shared<FormattedLayer>();
+  text->precision = layer.precision == CoordinateFormatter::PRECISION_DEFAULT ?
+    _precision : layer.precision;
+  text->grouped = _groupByStyle;
+  if (!layer.formatted) layer.formattedEarly = true;
+  text->verticesIn = layer.verticesIn;
+  text->verticesOut = layer.verticesOut;
+  text->verticesCleaned = layer.verticesCleaned;
+  layer.verticesIn = layer.verticesOut = layer.verticesCleaned = 0;
+
+  // Take the features out of the PlaceFile.
+  vector<FP> features;
+  for (auto it = first; it != _features.end(); ++it) features.push_back(move(it->second));
+  _features.erase(first, _features.end());
+
+  _formatter->start(_layers.size() - 1, move(features), move(text));
+  while (_formatter->full()) finishFormatting_();
+}
+
+void PFB::PlaceFile::formatPart_()
+{
+  // Only where formatting a layer in parts gives the same text, and nothing
+  // is waiting for the end of the layer to take its keys.
+  Layer& layer = _layers.back();
+  if (!_formatEarly || _formatter->getSpillPath().empty() || _groupByStyle || 
+    _hilbertOrder || !_pending.empty() || layer.verticesOut < LayerFormatter::PART_POINTS)
+  {
+    return;
+  }
+  formatLayer_();
+}
+
+void PFB::PlaceFile::finishFormatting_()
+{
+  Layer& layer = _layers[_formatter->oldestLayer()];
+  layer.formatted = _formatter->finish(layer.formatted, layer.formattedOwned);
+  layer.formattedOwned = true;
+}
+
+vector<PlaceFile::OutputUnit> PFB::PlaceFile::outputUnits_(bool groupByStyle) const
+{
+  const size_t numLayers = _layers.size();
+
+  // Sort the features into a unit for each type and layer. Keys are in
+  // order, so the layer only ever moves forward.
+  vector<OutputUnit> byType;
   for (int tp = 0; tp < 3; tp++)
   {
-    FeatureType tp_ = static_cast<FeatureType>(tp);
+    for (size_t i = 0; i != numLayers; ++i)
+    {
+      byType.push_back(OutputUnit{ i, static_cast<FeatureType>(tp), {} });
+    }
+  }
 
-    for (auto ib = pf._features.begin(), ie = pf._features.end(); ib != ie; ++ib)
+  size_t layer = 0;
+  for (auto ib = _features.begin(), ie = _features.end(); ib != ie; ++ib)
+  {
+    while (layer + 1 < numLayers && _layers[layer + 1].firstKey <= ib->first)
     {
-      if (ib->second->getFeatureType() != tp_) continue;
+      ++layer;
+    }
+    const size_t tp = static_cast<size_t>(ib->second->getFeatureType());
+    byType[tp * numLayers + layer].features.push_back(ib->second.get());
+  }
+
+  // Leave out units with nothing to write.
+  vector<OutputUnit> units;
+  for (OutputUnit& unit : byType)
+  {
+    const FormattedLayerPtr& formatted = _layers[unit.layer].formatted;
+    const bool hasText = formatted &&
+      !formatted->blocks[static_cast<int>(unit.type)].text.empty();
+    if (hasText || !unit.features.empty()) units.push_back(move(unit));
+  }
 
-      if (colorString == ib->second.get()->getColorString())
+  if (!groupByStyle) return units;
+
+  // Stable so features with the same style keep the order they were added.
+  for (OutputUnit& unit : units)
+  {
+    stable_sort(unit.features.begin(), unit.features.end(), styleLess);
+  }
+
+  auto unitStyle = [this](const OutputUnit& unit)
+  {
+    const FormattedLayerPtr& formatted = _layers[unit.layer].formatted;
+    const FormattedChunk *block =
+      formatted ? &formatted->blocks[static_cast<int>(unit.type)] : nullptr;
+    return block && !block->text.empty() ?
+      block->firstStyle : styleKey(unit.features.front());
+  };
+  auto typeEnd = units.begin();
+  while (typeEnd != units.end())
+  {
+    auto typeStart = typeEnd;
+    typeEnd = find_if(typeStart, units.end(),
+      [typeStart](const OutputUnit& unit) { return unit.type != typeStart->type; });
+    stable_sort(typeStart, typeEnd,
+      [&unitStyle](const OutputUnit& lhs, const OutputUnit& rhs)
       {
-        ib->second.get()->setUseColor(false);
-      }
-      else
+        return unitStyle(lhs) < unitStyle(rhs);
+      });
+  }
+
+  return units;
+}
+
+uint64_t PFB::PlaceFile::styleBytesSaved() const
+{
+  // Styles in the order written for each ordering of the units.
+  auto unitRuns = [this](const vector<OutputUnit>& units, bool grouped)
+  {
+    vector<StyleRun> runs;
+    for (const OutputUnit& unit : units)
+    {
+      const FormattedLayerPtr& formatted = _layers[unit.layer].formatted;
+      if (formatted)
       {
-        colorString = ib->second.get()->getColorString();
-        ib->second.get()->setUseColor(true);
+        const int tp = static_cast<int>(unit.type);
+        for (const StyleRun& run :
+          grouped ? formatted->runsWritten[tp] : formatted->runsAsAdded[tp])
+        {
+          addStyleRun(runs, run.colorString, run.threshold);
+        }
       }
-      if (ib->second.get()->getDisplayThreshold() == displayThresh)
+      addStyleRuns(runs, unit.features);
+    }
+    return runs;
+  };
+
+  const uint64_t asAdded = styleBytes(unitRuns(outputUnits_(false), false), _threshold);
+  const uint64_t grouped = styleBytes(unitRuns(outputUnits_(true), true), _threshold);
+  return asAdded > grouped ? asAdded - grouped : 0;
+}
+
+ostream& PFB::operator<<(ostream& ost, const PlaceFile& pf)
+{
+  pf.write_(&ost, nullptr, nullptr);
+  return ost;
+}
+
+string PFB::PlaceFile::header_() const
+{
+  // Header, data that goes at the top.
+  ostringstream ost;
+  ost << "Title: " << _title << "\n";
+  if(getRefreshMinutes() > 0) ost << "Refresh: " << getRefreshMinutes() << "\n";
+  if (getRefreshSeconds() > 0) ost << "RefreshSeconds: " << getRefreshSeconds() << "\n";
+  ost << "Threshold: " << getThreshold() << "\n";
+
+  // Font required for PointFeatures without a label.
+  ost << "Font: 1,16,1,courier\n\n";
+  return ost.str();
+}
+
+void PFB::PlaceFile::write_(ostream* ost, vector<LayerStats>* layerStats,
+  vector<FormattedLayerPtr>* formatted) const
+{
+  if (ost) *ost << header_();
+
+  // Put out polygons first, then lines, then points.
+  const vector<OutputUnit> units = outputUnits_(_groupByStyle);
+  const size_t numLayers = _layers.size();
+
+  // Resolve the precision policy of each layer.
+  vector<int> policies;
+  for (const Layer& layer : _layers)
+  {
+    policies.push_back(layer.precision == CoordinateFormatter::PRECISION_DEFAULT ?
+      _precision : layer.precision);
+
+    if (layer.formatted && layer.formatted->grouped != _groupByStyle)
+    {
+      throw runtime_error(("Formatted layer " + layer.name +
+        " was not grouped by style the same way.").c_str());
+    }
+  }
+
+  vector<LayerStats> stats(numLayers);
+  for (size_t i = 0; i != numLayers; ++i)
+  {
+    stats[i].name = _layers[i].name;
+    stats[i].hash = HASH_SEED; // So an empty layer is not zero
+    stats[i].formatted = _layers[i].formatted && !_layers[i].formattedEarly;
+    stats[i].verticesIn = _layers[i].verticesIn;
+    stats[i].verticesOut = _layers[i].verticesOut;
+    stats[i].verticesCleaned = _layers[i].verticesCleaned;
+    if (_layers[i].formatted)
+    {
+      stats[i].verticesIn += _layers[i].formatted->verticesIn;
+      stats[i].verticesOut += _layers[i].formatted->verticesOut;
+      stats[i].verticesCleaned += _layers[i].formatted->verticesCleaned;
+    }
+  }
+
+  // Split each unit into pieces, the kept text of its layer if there is any
+  // and chunks of roughly CHUNK_POINTS vertices each.
+  struct Piece
+  {
+    size_t unit;
+    const FormattedChunk *kept;
+    size_t first, last;  // Range of features in the unit if kept is null
+  };
+  vector<Piece> pieces;
+  vector<bool> hasFeatures(numLayers, false);
+  size_t numChunks = 0;
+  for (size_t u = 0; u != units.size(); ++u)
+  {
+    const OutputUnit& unit = units[u];
+    const FormattedLayerPtr& kept = _layers[unit.layer].formatted;
+    if (kept && !kept->blocks[static_cast<int>(unit.type)].text.empty())
+    {
+      pieces.push_back(Piece{ u, &kept->blocks[static_cast<int>(unit.type)], 0, 0 });
+    }
+
+    size_t pointsInChunk = CHUNK_POINTS;
+    for (size_t i = 0; i != unit.features.size(); ++i)
+    {
+      if (pointsInChunk >= CHUNK_POINTS)
       {
-        ib->second.get()->setUseDisplayThreshold(false);
+        if (i > 0) pieces.back().last = i;
+        pieces.push_back(Piece{ u, nullptr, i, 0 });
+        ++numChunks;
+        pointsInChunk = 0;
       }
-      else
+      pointsInChunk += unit.features[i]->getNumPoints() + 1;
+    }
+    if (!unit.features.empty())
+    {
+      pieces.back().last = unit.features.size();
+      hasFeatures[unit.layer] = true;
+    }
+  }
+
+  // Layers that are new text, the others reuse what they were given.
+  vector<shared_ptr<FormattedLayer>> building(numLayers);
+  if (formatted)
+  {
+    for (size_t i = 0; i != numLayers; ++i)
+    {
+      if (_layers[i].formatted && !hasFeatures[i]) continue;
+
+      building[i] = make_shared<FormattedLayer>();
+      building[i]->precision = policies[i];
+      building[i]->grouped = _groupByStyle;
+      building[i]->verticesIn = stats[i].verticesIn;
+      building[i]->verticesOut = stats[i].verticesOut;
+      building[i]->verticesCleaned = stats[i].verticesCleaned;
+    }
+  }
+
+  // Format the chunks on worker threads and write them out in order as they
+  // finish. Limit how many are in flight so memory use stays bounded.
+  unsigned int numThreads = thread::hardware_concurrency();
+  if (numThreads == 0) numThreads = 1;
+  const size_t maxInFlight = 2 * numThreads;
+
+  // Chunks are formatted on their own streams with these settings.
+  ostringstream defaults;
+  defaults.precision(WRITE_PRECISION);
+  defaults << fixed;
+  const streamsize precision = defaults.precision();
+  const ios_base::fmtflags flags = defaults.flags();
+  auto launchChunk = [&](const Piece& piece)
+  {
+    const OutputUnit& unit = units[piece.unit];
+    const Feature *const *first = unit.features.data() + piece.first;
+    const Feature *const *last = unit.features.data() + piece.last;
+    // Nothing to gain from a thread when there is only one chunk.
+    const launch policy = numChunks > 1 ? launch::async : launch::deferred;
+    return async(policy, formatChunk, first, last, precision, flags,
+      policies[unit.layer]);
+  };
+
+  deque<future<FormattedChunk>> inFlight;
+  size_t nextLaunch = 0;
+  string colorString;
+  int displayThresh = getThreshold();
+  for (const Piece& piece : pieces)
+  {
+    // Keep the workers busy with the chunks coming up.
+    for (; nextLaunch < pieces.size() && inFlight.size() < maxInFlight; ++nextLaunch)
+    {
+      if (!pieces[nextLaunch].kept) inFlight.push_back(launchChunk(pieces[nextLaunch]));
+    }
+
+    FormattedChunk fresh;
+    const FormattedChunk *chunk = piece.kept;
+    if (!chunk)
+    {
+      fresh = inFlight.front().get();
+      inFlight.pop_front();
+      chunk = &fresh;
+    }
+
+    // Without a stream only the leading lines are looked at.
+    const size_t skipped = ost ?
+      spliceChunk(*chunk, colorString, displayThresh,
+        [ost](const char* s, size_t n) { ost->write(s, n); }) :
+      spliceText(*chunk, colorString, displayThresh, [](const char*, size_t) {});
+    colorString = chunk->lastColor;
+    displayThresh = chunk->lastThresh;
+
+    const OutputUnit& unit = units[piece.unit];
+    stats[unit.layer].bytes += chunkSize(*chunk) - skipped;
+    addStats(stats[unit.layer], *chunk);
+
+    if (building[unit.layer])
+    {
+      appendChunk(building[unit.layer]->blocks[static_cast<int>(unit.type)], *chunk);
+    }
+  }
+
+  if (formatted)
+  {
+    // Styles of each unit in the order written and the order added, for
+    // styleBytesSaved.
+    const vector<OutputUnit> asAdded = _groupByStyle ? outputUnits_(false) : units;
+    for (int pass = 0; pass < 2; ++pass)
+    {
+      const bool written = pass == 0;
+      for (const OutputUnit& unit : written ? units : asAdded)
       {
-        displayThresh = ib->second.get()->getDisplayThreshold();
-        ib->second.get()->setUseDisplayThreshold(true);
+        FormattedLayer *layer = building[unit.layer].get();
+        if (!layer) continue;
+
+        const int tp = static_cast<int>(unit.type);
+        const FormattedLayerPtr& kept = _layers[unit.layer].formatted;
+        vector<StyleRun>& runs = written ? layer->runsWritten[tp] : layer->runsAsAdded[tp];
+        if (kept) runs = written ? kept->runsWritten[tp] : kept->runsAsAdded[tp];
+        addStyleRuns(runs, unit.features);
       }
-      ost << *(ib->second.get());
+    }
+
+    formatted->resize(numLayers);
+    for (size_t i = 0; i != numLayers; ++i)
+    {
+      if (building[i]) (*formatted)[i] = building[i];
+      else (*formatted)[i] = _layers[i].formatted;
     }
   }
-  // Return precision and formatting to what it was.
-  ost.flags(oldFormatFlags);
 
-  return ost;
+  if (layerStats) *layerStats = move(stats);
 }
@@ -11,10 +11,14 @@ Author: Ryan Leach
 
 Revisions:
 2015/10/15 - Initial version. RNL
+2026/10/16 - Layers, output options and statistics. The pending feature
+             pipeline is in PlaceFilePending.cpp, the formatted text in
+             FormattedText.hpp, and early formatting in LayerFormatter.hpp.
 
 */
 #pragma once
 // std lib
+#include <cstdint>
 #include <fstream>
 #include <iostream>
 #include <memory>
@@ -23,8 +27,11 @@ Revisions:
 // 3rd party libs
 #include "ogrsf_frmts.h"
 // PlaceFileBuilder headers
+#include "ClipRegion.hpp"
+#include "CoordinateFormatter.hpp"
 #include "Feature.hpp"
 #include "OGRFeatureWrapper.hpp"
+#include "Simplify.hpp"
 
 using std::map;
 using std::ostream;
@@ -33,19 +40,75 @@ using std::vector;
 
 namespace PFB
 {
+  class ArcTopology;
+  class LayerFormatter;
+
   class PlaceFile
   {
   public:
     using FP = std::unique_ptr<Feature>;
 
+    /// Output statistics for one layer.
+    struct LayerStats
+    {
+      string name;
+      uint64_t bytes = 0;         // Bytes of features in this layer
+      uint64_t bytesSaved = 0;    // Compared to full precision coordinates
+      uint64_t pointsDropped = 0; // Vertices that rounded to the previous one
+      uint64_t hash = 0;          // Of this layer's output, see ContentHash.hpp
+      uint64_t verticesIn = 0;    // Loaded from OGR geometry, before simplifying
+      uint64_t verticesOut = 0;   // Left after simplifying
+      uint64_t verticesCleaned = 0; // Removed by the cleanup, see VertexCleaner
+      bool formatted = false;     // Used text from addFormattedLayer
+    };
+
+    /// The formatted text of one layer, kept from one save to be reused by a
+    /// later one so layers that have not changed are not read and formatted
+    /// again. See setKeepFormattedLayers.
+    class FormattedLayer;
+    using FormattedLayerPtr = std::shared_ptr<const FormattedLayer>;
+
+    /// Statistics about the last call to saveFile.
+    struct SaveStats
+    {
+      uint64_t bytesWritten = 0;    // Before compression
+      uint64_t gzipBytesWritten = 0;
+      uint64_t styleBytesSaved = 0; // Color:/Threshold: lines left out by grouping
+      uint64_t hash = 0;            // Of the contents and the Output used
+      bool unchanged = false;       // Matched previousHash, files left as they were
+      vector<LayerStats> layers;    // In the order the layers were started
+    };
+
     /// Default Constructor.
     PlaceFile();
 
     /// Destructor
     ~PlaceFile();
 
-    /// Save a file to disk.
-    void saveFile(const string& path);
+    /// Which files saveFile writes, the plain text, a gzip compressed copy
+    /// with ".gz" added to the name, or both.
+    enum class Output { PLAIN, GZIP, PLAIN_AND_GZIP };
+
+    /// Save a file to disk. Returns the number of bytes written before 
+    /// compression. If path already ends in ".gz" it is removed to get the 
+    /// name of the plain file. Compression runs on a background thread as 
+    /// the file is written.
+    ///
+    /// The output goes to temporary files that are renamed over the old files
+    /// once complete, so a reader never sees a partial file. If previousHash
+    /// is the hash from the last save and the contents are the same, the old
+    /// files are left untouched so clients do not download them again. When
+    /// every layer is already formatted, as with setFormatEarly, that is
+    /// known before writing, and nothing is written.
+    uint64_t saveFile(const string& path, Output output = Output::PLAIN,
+      uint64_t previousHash = 0);
+
+    /// Names of the files saveFile writes for path.
+    static string plainPath(const string& path);
+    static string gzipPath(const string& path);
+
+    /// Get statistics about the last save.
+    const SaveStats& getSaveStats() const { return _saveStats; }
 
     /// Add a feature to this PlaceFile
     void addFeature(FP&& ft);
@@ -58,9 +121,107 @@ namespace PFB
     /// Also supports adding many features if the supplied OGRGeometry is a
     /// multi-geometry. Each sub geometry in the multi-geometry will have the
     /// same label as the feature.
+    ///
+    /// Lines and polygons are cleaned up and simplified as set in geo, and the
+    /// number of vertices before and after is added to the layer's
+    /// statistics. The cleanup rounds to the decimal places the layer is
+    /// written with unless geo sets its own.
+    ///
+    /// If geo has detail thresholds below displayThresh, lines and polygons
+    /// are written once for each band between them. The copy for a band uses
+    /// the band's upper threshold and is simplified with the tolerance for
+    /// its lower one, see toleranceForThreshold. The copy below the smallest
+    /// threshold has the full detail set in geo. GRLevelX has no lower
+    /// bound on a threshold, so when zoomed in the coarser copies are still
+    /// drawn with the finer ones. A copy is simplified to about a pixel at
+    /// its lower threshold, so it is off by a pixel for each time the view
+    /// is zoomed in past that, 5 pixels for the 25 nm copy at a 5 nm view.
+    /// Lines show shifted ghost copies and filled polygons reach past their
+    /// edge. This trades those artifacts for fewer vertices when zoomed out.
+    ///
+    /// If there is a clip region, the geometry is transformed first and only
+    /// the part inside the region is added, see setClipRegion. Polygons drawn
+    /// as lines are cut into the pieces of their rings inside the region, so
+    /// no line is drawn along its edge.
     void addOGRGeometry(const string& label, const PlaceFileColor& color, 
       OGRGeometry& ft, OGRCoordinateTransformation* trans = nullptr, 
-      bool PolyAsString = false, int displayThresh = 999, int lineWidth = 2);
+      bool PolyAsString = false, int displayThresh = 999, int lineWidth = 2,
+      const GeometryOptions& geo = GeometryOptions());
+
+    /// Features added after this call belong to a new layer with its own
+    /// coordinate precision policy, see CoordinateFormatter. The default
+    /// policy uses the precision of the PlaceFile. Features added before the
+    /// first call belong to an unnamed layer. Returns the index of the layer.
+    size_t beginLayer(const string& name, 
+      int precision = CoordinateFormatter::PRECISION_DEFAULT);
+
+    /// Finish the current layer. Lines and polygons added with
+    /// GeometryOptions::preserveTopology are held until now, then the
+    /// boundaries they share are found with ArcTopology and each is
+    /// simplified once, so no gaps or overlaps open up between neighbors.
+    /// Polygons drawn as lines with GeometryOptions::shareEdges are held as
+    /// well, then each arc is written once, joined with the arcs next to it
+    /// that the same polygon owns. Lines with GeometryOptions::mergeLines are
+    /// held and joined end to end with others of the same label and style
+    /// before anything else is done with them. Called by beginLayer and saveFile,
+    /// anything still held is not written by operator<<. The layer is then
+    /// sorted if setHilbertOrder is on, and starts formatting if
+    /// setFormatEarly is on.
+    void endLayer();
+
+    /// Format each layer on worker threads as soon as it ends, while the next
+    /// one is built, instead of all together in saveFile. The features of a
+    /// layer are released once it starts formatting. At most two layers are
+    /// formatted at a time, endLayer waits for the oldest beyond that. The
+    /// file written is the same either way. Off by default.
+    void setFormatEarly(bool early) { _formatEarly = early; }
+    bool getFormatEarly() const { return _formatEarly; }
+
+    /// With setFormatEarly, move the text of each layer out to temporary
+    /// files named prefix plus ".polygons.", ".lines." or ".points.", a
+    /// number and ".tmp" as it is formatted, see SpillFile. Only the start of
+    /// each layer stays in memory, and the text is read back by saveFile. A
+    /// layer that is not grouped by style or ordered also starts formatting
+    /// every few hundred thousand vertices, so its features are never all
+    /// held at once. The files are removed once no layer from
+    /// getFormattedLayer uses them. Empty, the default, keeps the text in
+    /// memory.
+    void setSpillPath(const string& prefix);
+    const string& getSpillPath() const;
+
+    /// Sort the features of each layer along a Hilbert curve through the
+    /// centers of their boxes as the layer ends, see hilbertOrder. Neighbors
+    /// are written next to each other, which compresses better. Off by
+    /// default, which keeps the order features were added in.
+    void setHilbertOrder(bool order) { _hilbertOrder = order; }
+    bool getHilbertOrder() const { return _hilbertOrder; }
+
+    /// Start a layer that writes text kept from an earlier save in place of
+    /// its features. Both saves must group by style the same way, and the
+    /// precision is the one it was formatted with. Features can still be
+    /// added to the layer, they are written after the kept text. Returns the
+    /// index of the layer.
+    size_t addFormattedLayer(const string& name, FormattedLayerPtr formatted);
+
+    /// Keep the formatted text of each layer when saving, so it can be passed
+    /// to addFormattedLayer next time. Off by default since it holds a copy
+    /// of the whole file in memory.
+    void setKeepFormattedLayers(bool keep) { _keepFormattedLayers = keep; }
+
+    /// Text of a layer from the last save, by the index from beginLayer, or
+    /// null if it was not kept.
+    FormattedLayerPtr getFormattedLayer(size_t layer) const;
+
+    /// Only the parts of geometry inside this region are added by
+    /// addOGRGeometry. Features from addFeature are left as they are. The
+    /// default region is not set and clips nothing.
+    void setClipRegion(const ClipRegion& clip) { _clip = clip; }
+    const ClipRegion& getClipRegion() const { return _clip; }
+
+    /// Coordinate precision policy for layers that do not set their own. The
+    /// default, CoordinateFormatter::PRECISION_FULL, writes 10 decimal places.
+    void setPrecision(int precision) { _precision = precision; }
+    int getPrecision() const { return _precision; }
 
     /// Remove a feature from this PlaceFile
     void deleteFeature(const size_t key);
@@ -88,6 +249,19 @@ namespace PFB
     void setTitle(const string& title);
     string getTitle() const;
 
+    /// Group features with the same color, display threshold, and line width
+    /// together when writing so fewer Color: and Threshold: lines are needed.
+    /// Polygons are still written before lines, and lines before points. The
+    /// features of each layer stay together, they are sorted within the layer
+    /// and then layers are sorted by the style of their first feature. Off
+    /// by default, which keeps the order features were added in.
+    void setGroupByStyle(bool group) { _groupByStyle = group; }
+    bool getGroupByStyle() const { return _groupByStyle; }
+
+    /// Number of bytes of Color: and Threshold: lines that grouping by style
+    /// leaves out compared to writing features in the order they were added.
+    uint64_t styleBytesSaved() const;
+
     /// Get the number of features
     size_t getNumberOfFeatures()
     {
@@ -98,12 +272,126 @@ namespace PFB
     friend ostream& operator<<(ostream& ost, const PlaceFile& pf);
 
   private:
+    // Features with keys from firstKey up to the next layer's firstKey.
+    struct Layer
+    {
+      Layer(const string& name, int precision, size_t firstKey) :
+        name(name), precision(precision), firstKey(firstKey)
+      {
+      }
+
+      string name;
+      int precision;
+      size_t firstKey;
+      FormattedLayerPtr formatted; // Written before the features if not null
+      uint64_t verticesIn = 0;     // Of the features, see LayerStats
+      uint64_t verticesOut = 0;
+      uint64_t verticesCleaned = 0;
+      bool formattedEarly = false;         // formatted is from setFormatEarly
+      bool formattedOwned = false;         // formatted was made here, not given
+    };
+
+    // A line or polygon held until the end of its layer to be simplified
+    // together with the others.
+    struct PendingFeature
+    {
+      size_t key;            // First of the keys reserved for it
+      string label;
+      PlaceFileColor color;
+      int displayThresh;
+      int lineWidth;
+      bool polygon;          // Else each path is a separate line
+      bool shareEdges;       // Lines written by arc, no keys reserved
+      bool merge;            // Lines joined end to end, no keys reserved
+      vector<vector<point>> paths;
+      GeometryOptions geo;
+    };
+
+    // The features of one type from one layer, these are written together.
+    struct OutputUnit
+    {
+      size_t layer;
+      FeatureType type;
+      vector<const Feature*> features;
+    };
+
     map<size_t, FP> _features;
+    vector<Layer> _layers;
+    vector<PendingFeature> _pending;
     size_t _nextKey = 0;
     unsigned int _threshold = 999;
     unsigned int _refreshMinutes = 2;
     unsigned int _refreshSeconds = 0;
     string _title = "Generated by PlaceFileBuilder";
+    bool _groupByStyle = false;
+    int _precision = CoordinateFormatter::PRECISION_FULL;
+    bool _keepFormattedLayers = false;
+    bool _hilbertOrder = false;
+    ClipRegion _clip;
+    vector<FormattedLayerPtr> _formattedLayers;
+    SaveStats _saveStats;
+
+    // Layers being formatted on worker threads, see setFormatEarly.
+    bool _formatEarly = false;
+    std::unique_ptr<LayerFormatter> _formatter;
+
+    // Add geometry already clipped, the body of addOGRGeometry.
+    void addGeometry_(const string& label, const PlaceFileColor& color,
+      OGRGeometry& ft, OGRCoordinateTransformation* trans, bool PolyAsString,
+      int displayThresh, int lineWidth, const GeometryOptions& geo);
+
+    // Vertices in a polygon's rings.
+    static uint64_t polygonNumPoints_(const OGRPolygon& polygon);
+
+    // Hold a line or polygon until the end of the layer.
+    void addPending_(const string& label, const PlaceFileColor& color,
+      OGRGeometry& ft, bool PolyAsString, int displayThresh, int lineWidth,
+      const GeometryOptions& geo);
+
+    // Decimal places the current layer writes a feature with.
+    int layerDecimals_(int displayThresh) const;
+
+    // Simplify and add the held lines and polygons.
+    void addPendingFeatures_();
+
+    // Sort the features of the current layer along a Hilbert curve.
+    void orderLayer_();
+
+    // Hand the features of the current layer to _formatter, see setFormatEarly.
+    void formatLayer_();
+
+    // Start formatting the features of the current layer so far if there
+    // are enough of them, see setSpillPath.
+    void formatPart_();
+
+    // Wait for the oldest layer being formatted and join its text to what
+    // the layer has.
+    void finishFormatting_();
+
+    // Join the held lines that meet end to end.
+    void mergePending_();
+
+    // Write the arcs of polygons drawn as lines, each one once.
+    void addSharedEdges_(const ArcTopology& topology, PendingFeature *const *first,
+      PendingFeature *const *last);
+
+    // Add a copy of a line or polygon for each band of detail thresholds.
+    void addDetailLevels_(const string& label, const PlaceFileColor& color,
+      OGRGeometry& ft, OGRCoordinateTransformation* trans, bool PolyAsString,
+      int displayThresh, int lineWidth, const GeometryOptions& geo);
+
+    // Units in the order they are written, polygons, then lines, then points.
+    vector<OutputUnit> outputUnits_(bool groupByStyle) const;
+
+    // The lines at the top of the file.
+    string header_() const;
+
+    // Write the PlaceFile, filling in per layer statistics and keeping the
+    // formatted layers if asked. With ost null nothing is written, only the
+    // statistics are worked out, which is quick once every layer is
+    // formatted.
+    void write_(ostream* ost, vector<LayerStats>* layerStats, 
+      vector<FormattedLayerPtr>* formatted) const;
   };
 
   // Declare this in the PFB namespace.
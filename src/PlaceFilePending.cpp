@@ -0,0 +1,359 @@
+#include "PlaceFile.hpp"
+
+#include <algorithm>
+#include <functional>
+#include <iterator>
+#include <tuple>
+
+#include "ArcTopology.hpp"
+#include "LineFeature.hpp"
+#include "LineMerge.hpp"
+#include "PolygonFeature.hpp"
+#include "VertexCleanup.hpp"
+
+using namespace std;
+using namespace PFB;
+
+namespace
+{
+  // Only duplicates are removed here if geo cleans up vertices, the rest
+  // waits until the shared boundaries are known.
+  vector<point> pointsOf(const OGRLineString& ls, bool close, const GeometryOptions& geo,
+    uint64_t& verticesCleaned)
+  {
+    vector<point> pts;
+    const int numPoints = ls.getNumPoints();
+    pts.reserve(numPoints + 1);
+    const bool closing = close && numPoints > 0 && !PolygonFeature::_isOGRLinearRingClosed(ls);
+    if (geo.cleanVertices)
+    {
+      VertexCleaner cleaner(pts, geo.snapDecimals, true);
+      for (int i = 0; i < numPoints; ++i) cleaner.add(ls.getY(i), ls.getX(i));
+      if (closing) cleaner.add(ls.getY(0), ls.getX(0));
+      verticesCleaned += cleaner.finish();
+      return pts;
+    }
+
+    for (int i = 0; i < numPoints; ++i) pts.push_back(point(ls.getY(i), ls.getX(i)));
+    if (closing) pts.push_back(pts.front());
+    return pts;
+  }
+
+  bool isClosed(const vector<point>& pts)
+  {
+    return pts.size() >= 4 && pts.front().latitude == pts.back().latitude &&
+      pts.front().longitude == pts.back().longitude;
+  }
+}
+
+void PFB::PlaceFile::addPending_(const string& label, const PlaceFileColor& color,
+  OGRGeometry& ft, bool PolyAsString, int displayThresh, int lineWidth, 
+  const GeometryOptions& geo)
+{
+  PendingFeature pending{ _nextKey, label, color, displayThresh, lineWidth, false, false, 
+    false, {}, geo };
+  uint64_t& cleaned = _layers.back().verticesCleaned;
+
+  if (wkbFlatten(ft.getGeometryType()) == wkbPolygon)
+  {
+    const OGRPolygon& poly = static_cast<const OGRPolygon&>(ft);
+    pending.polygon = !PolyAsString;
+    pending.shareEdges = PolyAsString && geo.shareEdges;
+    pending.paths.push_back(pointsOf(*poly.getExteriorRing(), true, geo, cleaned));
+    for (int i = 0; i != poly.getNumInteriorRings(); ++i)
+    {
+      pending.paths.push_back(pointsOf(*poly.getInteriorRing(i), true, geo, cleaned));
+    }
+    _layers.back().verticesIn += polygonNumPoints_(poly);
+  }
+  else
+  {
+    const OGRLineString& line = static_cast<const OGRLineString&>(ft);
+    // Same as addGeometry_, an empty Line: makes GRAnalyst error.
+    if (line.getNumPoints() <= 1) return;
+    pending.paths.push_back(pointsOf(line, false, geo, cleaned));
+    pending.merge = geo.mergeLines;
+    _layers.back().verticesIn += line.getNumPoints();
+  }
+
+  if (!pending.shareEdges && !pending.merge)
+  {
+    _nextKey += pending.polygon ? 1 : pending.paths.size();
+  }
+  _pending.push_back(move(pending));
+}
+
+void PFB::PlaceFile::addPendingFeatures_()
+{
+  mergePending_();
+
+  // Merged lines can be far longer than GRLevelX allows. They are split at
+  // the limit rather than reduced to it, which would lose detail the pieces
+  // had before they were joined. They get new keys, so they can be split.
+  auto splitMerged = [](PendingFeature& ft)
+  {
+    if (!ft.merge) return;
+    vector<vector<point>> pieces;
+    for (vector<point>& pts : ft.paths)
+    {
+      for (vector<point>& piece : splitLine(move(pts), ft.geo.maxLinePoints))
+      {
+        pieces.push_back(move(piece));
+      }
+    }
+    ft.paths = move(pieces);
+  };
+
+  // Features simplified with different settings, like the bands of detail
+  // thresholds, are simplified separately. Edges are only shared with
+  // features shown at the same threshold.
+  auto settings = [](const PendingFeature& ft)
+  {
+    const bool topology = ft.shareEdges || ft.geo.preserveTopology;
+    return make_tuple(topology, static_cast<int>(ft.geo.simplify), ft.geo.toleranceMeters,
+      ft.shareEdges, ft.shareEdges ? ft.displayThresh : 0);
+  };
+  vector<PendingFeature*> order;
+  for (PendingFeature& ft : _pending) order.push_back(&ft);
+  stable_sort(order.begin(), order.end(), 
+    [&settings](const PendingFeature* lhs, const PendingFeature* rhs)
+    {
+      return settings(*lhs) < settings(*rhs);
+    });
+
+  for (size_t start = 0, end = 0; start != order.size(); start = end)
+  {
+    while (end != order.size() && settings(*order[end]) == settings(*order[start])) ++end;
+    const GeometryOptions& geo = order[start]->geo;
+
+    if (!get<0>(settings(*order[start])))
+    {
+      // Lines that were only held to be merged.
+      for (size_t i = start; i != end; ++i)
+      {
+        PendingFeature& ft = *order[i];
+        for (vector<point>& pts : ft.paths)
+        {
+          if (geo.cleanVertices) _layers.back().verticesCleaned += cleanVertices(pts, -1);
+          simplifyLine(pts, geo.simplify, geo.toleranceMeters, ft.merge ? 0 : geo.maxLinePoints);
+        }
+        splitMerged(ft);
+      }
+      continue;
+    }
+
+    vector<vector<point>> paths;
+    for (size_t i = start; i != end; ++i)
+    {
+      paths.insert(paths.end(), order[i]->paths.begin(), order[i]->paths.end());
+    }
+
+    // Each shared boundary is cleaned up and simplified once, with its ends
+    // fixed.
+    ArcTopology topology(paths);
+    for (vector<point>& arc : topology.arcs())
+    {
+      if (geo.cleanVertices) _layers.back().verticesCleaned += cleanVertices(arc, -1, true);
+      simplifyLine(arc, geo.simplify, geo.toleranceMeters, 0);
+    }
+
+    if (order[start]->shareEdges)
+    {
+      addSharedEdges_(topology, &order[start], &order[0] + end);
+      continue;
+    }
+
+    size_t path = 0;
+    for (size_t i = start; i != end; ++i)
+    {
+      PendingFeature& ft = *order[i];
+      const size_t maxPoints = ft.polygon ? ft.geo.maxRingPoints :
+        ft.merge ? 0 : ft.geo.maxLinePoints;
+      for (vector<point>& pts : ft.paths)
+      {
+        vector<point> rebuilt = topology.buildPath(path++);
+        if (isClosed(pts) && !isClosed(rebuilt))
+        {
+          // Too small to keep its shape from the shared boundaries alone.
+          simplifyLine(pts, geo.simplify, geo.toleranceMeters, maxPoints);
+          continue;
+        }
+        simplifyLine(rebuilt, SimplifyMethod::NONE, 0.0, maxPoints);
+        pts = move(rebuilt);
+      }
+      splitMerged(ft);
+    }
+  }
+
+  for (PendingFeature& ft : _pending)
+  {
+    if (ft.shareEdges) continue;
+    if (ft.polygon)
+    {
+      _features[ft.key] = FP(new PolygonFeature(ft.label, ft.color, ft.paths,
+        ft.displayThresh, ft.lineWidth));
+      _layers.back().verticesOut += _features[ft.key]->getNumPoints();
+      continue;
+    }
+    for (size_t i = 0; i != ft.paths.size(); ++i)
+    {
+      if (ft.paths[i].size() < 2) continue;
+      const size_t key = ft.merge ? _nextKey++ : ft.key + i;
+      _features[key] = FP(new LineFeature(ft.label, ft.color, ft.paths[i],
+        ft.displayThresh, ft.lineWidth));
+      _layers.back().verticesOut += ft.paths[i].size();
+    }
+  }
+  _pending.clear();
+}
+
+void PFB::PlaceFile::mergePending_()
+{
+  // Lines are joined with others that look the same and are handled the same
+  // way afterward. Groups are kept in the order they were first seen.
+  using MergeKey = tuple<string, unsigned char, unsigned char, unsigned char, int, int,
+    int, double, bool>;
+  map<MergeKey, size_t> groupIndex;
+  vector<vector<size_t>> groups;
+
+  vector<PendingFeature> pending;
+  for (size_t i = 0; i != _pending.size(); ++i)
+  {
+    PendingFeature& ft = _pending[i];
+    if (!ft.merge)
+    {
+      pending.push_back(move(ft));
+      continue;
+    }
+
+    const MergeKey key = make_tuple(ft.label, ft.color.red, ft.color.green, ft.color.blue,
+      ft.displayThresh, ft.lineWidth, static_cast<int>(ft.geo.simplify), 
+      ft.geo.toleranceMeters, ft.geo.preserveTopology);
+    auto found = groupIndex.find(key);
+    if (found == groupIndex.end())
+    {
+      found = groupIndex.emplace(key, groups.size()).first;
+      groups.push_back(vector<size_t>());
+    }
+    groups[found->second].push_back(i);
+  }
+
+  for (const vector<size_t>& group : groups)
+  {
+    vector<vector<point>> lines;
+    for (size_t i : group)
+    {
+      lines.insert(lines.end(), make_move_iterator(_pending[i].paths.begin()),
+        make_move_iterator(_pending[i].paths.end()));
+    }
+
+    PendingFeature merged = move(_pending[group.front()]);
+    merged.paths = mergeLines(move(lines));
+    pending.push_back(move(merged));
+  }
+
+  _pending = move(pending);
+}
+
+void PFB::PlaceFile::addSharedEdges_(const ArcTopology& topology,
+  PendingFeature *const *first, PendingFeature *const *last)
+{
+  const vector<vector<point>>& arcs = topology.arcs();
+  vector<char> written(arcs.size(), 0);
+
+  size_t path = 0;
+  for (PendingFeature *const *it = first; it != last; ++it)
+  {
+    const PendingFeature& ft = **it;
+    const string label = ft.geo.labelSharedEdges ? ft.label : string();
+
+    // The polygons were kept whole in a clip region so their arcs match, the
+    // lines are cut to it here.
+    vector<point> line;
+    auto addLine = [&]()
+    {
+      vector<vector<point>> pieces;
+      if (_clip.isSet()) pieces = _clip.clipLine(line);
+      else if (line.size() >= 2) pieces.push_back(move(line));
+      for (vector<point>& piece : pieces)
+      {
+        simplifyLine(piece, SimplifyMethod::NONE, 0.0, ft.geo.maxLinePoints);
+        _layers.back().verticesOut += piece.size();
+        _features[_nextKey++] = FP(new LineFeature(label, ft.color, piece,
+          ft.displayThresh, ft.lineWidth));
+      }
+      line.clear();
+    };
+
+    for (size_t p = 0; p != ft.paths.size(); ++p, ++path)
+    {
+      // Start after an arc another polygon wrote so the arcs on either side
+      // of the ring's first point can be joined.
+      const vector<ArcTopology::ArcRef>& refs = topology.pathArcs(path);
+      size_t begin = 0;
+      for (size_t i = 0; i != refs.size(); ++i)
+      {
+        if (written[refs[i] >= 0 ? refs[i] : ~refs[i]])
+        {
+          begin = i + 1;
+          break;
+        }
+      }
+
+      for (size_t n = 0; n != refs.size(); ++n)
+      {
+        const ArcTopology::ArcRef ref = refs[(begin + n) % refs.size()];
+        const size_t arc = static_cast<size_t>(ref >= 0 ? ref : ~ref);
+        if (written[arc])
+        {
+          addLine();
+          continue;
+        }
+        written[arc] = 1;
+
+        const size_t skip = line.empty() ? 0 : 1;
+        if (ref >= 0) line.insert(line.end(), arcs[arc].begin() + skip, arcs[arc].end());
+        else line.insert(line.end(), arcs[arc].rbegin() + skip, arcs[arc].rend());
+      }
+      addLine();
+    }
+  }
+}
+
+void PFB::PlaceFile::addDetailLevels_(const string& label, const PlaceFileColor& color,
+  OGRGeometry& ft, OGRCoordinateTransformation *trans, bool PolyAsString, int displayThresh,
+  int lineWidth, const GeometryOptions& geo)
+{
+  // Finest last, only those that split the range the feature is shown in.
+  vector<int> bands;
+  for (int thresh : geo.detailThresholds)
+  {
+    if (thresh > 0 && thresh < displayThresh) bands.push_back(thresh);
+  }
+  sort(bands.begin(), bands.end(), greater<int>());
+  bands.erase(unique(bands.begin(), bands.end()), bands.end());
+
+  // Transform once rather than for each copy.
+  if (trans != nullptr) ft.transform(trans);
+
+  GeometryOptions level = geo;
+  level.detailThresholds.clear();
+  if (level.simplify == SimplifyMethod::NONE) level.simplify = SimplifyMethod::DOUGLAS_PEUCKER;
+
+  // Each copy counts the same input vertices, only count them once.
+  Layer& layer = _layers.back();
+  const uint64_t verticesIn = layer.verticesIn;
+
+  int upper = displayThresh;
+  for (int lower : bands)
+  {
+    level.toleranceMeters = max(geo.toleranceMeters, toleranceForThreshold(lower));
+    addGeometry_(label, color, ft, nullptr, PolyAsString, upper, lineWidth, level);
+    layer.verticesIn = verticesIn;
+    upper = lower;
+  }
+
+  GeometryOptions full = geo;
+  full.detailThresholds.clear();
+  addGeometry_(label, color, ft, nullptr, PolyAsString, upper, lineWidth, full);
+}
@@ -0,0 +1,421 @@
+#include "PlaceFileWriter.hpp"
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <future>
+#include <mutex>
+#include <stdexcept>
+#include <utility>
+
+#ifdef _WIN32
+#include <io.h>
+#include <process.h>
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+
+#include "cpl_vsi.h"
+
+using namespace std;
+using PFB::PlaceFileWriter;
+
+namespace
+{
+  // Buffers in use by the writer and the compression thread together. The
+  // writer blocks when they are all waiting to be compressed.
+  const size_t MAX_GZIP_BUFFERS = 3;
+
+  // Make sure everything written to the file is on the disk, not just in the
+  // operating system's cache, before it is renamed into place.
+  bool syncToDisk(FILE *file)
+  {
+    if (fflush(file) != 0) return false;
+#ifdef _WIN32
+    return _commit(_fileno(file)) == 0;
+#else
+    return fsync(fileno(file)) == 0;
+#endif
+  }
+
+  // Replace dest with src in one step, so dest is always either the old file
+  // or the new one.
+  bool replaceFile(const string& src, const string& dest)
+  {
+#ifdef _WIN32
+    return MoveFileExA(src.c_str(), dest.c_str(), 
+      MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != 0;
+#else
+    return rename(src.c_str(), dest.c_str()) == 0;
+#endif
+  }
+
+  // Replace dest with src like replaceFile, keeping the old dest as backup
+  // if there is one. Sets kept if it did.
+  bool replaceFile(const string& src, const string& dest, const string& backup,
+    bool& kept)
+  {
+    kept = false;
+#ifdef _WIN32
+    if (GetFileAttributesA(dest.c_str()) != INVALID_FILE_ATTRIBUTES)
+    {
+      kept = ReplaceFileA(dest.c_str(), src.c_str(), backup.c_str(), 
+        REPLACEFILE_WRITE_THROUGH, nullptr, nullptr) != 0;
+      if (kept) return true;
+    }
+#else
+    kept = link(dest.c_str(), backup.c_str()) == 0;
+#endif
+    if (replaceFile(src, dest)) return true;
+
+    if (kept) remove(backup.c_str());
+    kept = false;
+    return false;
+  }
+
+  bool fileExists(const string& path)
+  {
+    VSIStatBufL stat;
+    return VSIStatL(path.c_str(), &stat) == 0;
+  }
+}
+
+class PlaceFileWriter::GzipSink
+{
+public:
+  GzipSink(const string& path, size_t bufferSize) :
+    path_(path),
+    bufferSize_(bufferSize),
+    file_(VSIFOpenL((string("/vsigzip/") + path).c_str(), "wb"))
+  {
+    if (!file_)
+    {
+      throw runtime_error((string("Unable to open file for writing: ") + path).c_str());
+    }
+    worker_ = async(launch::async, &GzipSink::run_, this);
+  }
+
+  ~GzipSink()
+  {
+    finish();
+  }
+
+  // Queue the first size bytes of buf for compression and return an empty
+  // buffer to keep filling.
+  vector<char> push(vector<char>&& buf, size_t size)
+  {
+    unique_lock<mutex> lock(mutex_);
+    full_.push_back(make_pair(move(buf), size));
+    cond_.notify_all();
+
+    if (free_.empty() && numBuffers_ < MAX_GZIP_BUFFERS)
+    {
+      ++numBuffers_;
+      return vector<char>(bufferSize_);
+    }
+    cond_.wait(lock, [this] { return !free_.empty(); });
+    vector<char> next = move(free_.back());
+    free_.pop_back();
+    return next;
+  }
+
+  // Compress anything left and close the file. Returns false if anything
+  // failed.
+  bool finish()
+  {
+    if (!file_) return !failed_;
+
+    {
+      lock_guard<mutex> lock(mutex_);
+      done_ = true;
+      cond_.notify_all();
+    }
+    worker_.get();
+
+    if (VSIFCloseL(file_) != 0) failed_ = true;
+    file_ = nullptr;
+
+    // Reopen the compressed file to flush it to disk.
+    if (!failed_)
+    {
+      FILE *written = fopen(path_.c_str(), "r+b");
+      if (!written || !syncToDisk(written)) failed_ = true;
+      if (written) fclose(written);
+    }
+
+    VSIStatBufL stat;
+    if (!failed_ && VSIStatL(path_.c_str(), &stat) == 0)
+    {
+      compressedBytes_ = static_cast<uint64_t>(stat.st_size);
+    }
+    return !failed_;
+  }
+
+  uint64_t compressedBytes() const { return compressedBytes_; }
+
+private:
+  string path_;
+  size_t bufferSize_;
+  VSILFILE *file_;
+  future<void> worker_;
+
+  mutex mutex_;
+  condition_variable cond_;
+  deque<pair<vector<char>, size_t>> full_;
+  vector<vector<char>> free_;
+  size_t numBuffers_ = 1; // The one the writer starts with
+  bool done_ = false;
+  bool failed_ = false;
+  uint64_t compressedBytes_ = 0;
+
+  void run_()
+  {
+    unique_lock<mutex> lock(mutex_);
+    while (true)
+    {
+      cond_.wait(lock, [this] { return done_ || !full_.empty(); });
+      if (full_.empty()) return;
+
+      pair<vector<char>, size_t> item = move(full_.front());
+      full_.pop_front();
+
+      // Compress without holding the lock so the writer can keep going.
+      lock.unlock();
+      bool ok = VSIFWriteL(item.first.data(), 1, item.second, file_) == item.second;
+      lock.lock();
+
+      if (!ok) failed_ = true;
+      free_.push_back(move(item.first));
+      cond_.notify_all();
+    }
+  }
+};
+
+PlaceFileWriter::PlaceFileWriter(const string& path, size_t bufferSize) :
+  PlaceFileWriter(path, string(), bufferSize)
+{
+}
+
+PlaceFileWriter::PlaceFileWriter(const string& path, const string& gzipPath,
+  size_t bufferSize) :
+  path_(path),
+  gzipPath_(gzipPath),
+  buffer_(bufferSize > 0 ? bufferSize : DEFAULT_BUFFER_SIZE)
+{
+  if (path.empty() && gzipPath.empty())
+  {
+    throw runtime_error("No file given to write to.");
+  }
+
+  if (!path.empty())
+  {
+    tempPath_ = makeTempPath_(path);
+    file_ = fopen(tempPath_.c_str(), "wb");
+    if (!file_)
+    {
+      throw runtime_error((string("Unable to open file for writing: ") + path).c_str());
+    }
+
+    // Our buffer is already large, no need for stdio to copy it again.
+    setvbuf(file_, nullptr, _IONBF, 0);
+  }
+
+  if (!gzipPath.empty())
+  {
+    try
+    {
+      gzipTempPath_ = makeTempPath_(gzipPath);
+      gzip_.reset(new GzipSink(gzipTempPath_, buffer_.size()));
+    }
+    catch (...)
+    {
+      if (file_) 
+      {
+        fclose(file_);
+        remove(tempPath_.c_str());
+      }
+      throw;
+    }
+  }
+
+  setp(&buffer_[0], &buffer_[0] + buffer_.size());
+}
+
+PlaceFileWriter::~PlaceFileWriter()
+{
+  if (file_ || gzip_)
+  {
+    flushBuffer_();
+    if (file_) fclose(file_);
+    file_ = nullptr;
+    gzip_.reset();
+  }
+  if (!finished_) discard();
+}
+
+void PlaceFileWriter::close()
+{
+  if (!file_ && !gzip_) return;
+
+  bool ok = flushBuffer_();
+  if (file_) 
+  {
+    ok = syncToDisk(file_) && ok;
+    ok = (fclose(file_) == 0) && ok;
+  }
+  file_ = nullptr;
+
+  if (gzip_)
+  {
+    ok = gzip_->finish() && ok;
+    gzipBytes_ = gzip_->compressedBytes();
+    gzip_.reset();
+  }
+
+  if (!ok || failed_)
+  {
+    throw runtime_error((string("Error writing file: ") + 
+      (path_.empty() ? gzipPath_ : path_)).c_str());
+  }
+}
+
+void PlaceFileWriter::publish()
+{
+  finished_ = true;
+
+  // Keep the old gzip file until the plain file is replaced too.
+  const string backup = gzipTempPath_ + ".old";
+  bool existed = false, kept = false;
+  if (!gzipPath_.empty())
+  {
+    existed = fileExists(gzipPath_);
+    const bool replaced = path_.empty() ? replaceFile(gzipTempPath_, gzipPath_) :
+      replaceFile(gzipTempPath_, gzipPath_, backup, kept);
+    if (!replaced)
+    {
+      discard();
+      throw runtime_error((string("Unable to replace file: ") + gzipPath_).c_str());
+    }
+  }
+
+  if (!path_.empty() && !replaceFile(tempPath_, path_))
+  {
+    remove(tempPath_.c_str());
+    string message = string("Unable to replace file: ") + path_;
+    if (!gzipPath_.empty())
+    {
+      const bool undone = kept ? replaceFile(backup, gzipPath_) :
+        !existed && remove(gzipPath_.c_str()) == 0;
+      if (!undone) message += "\n" + gzipPath_ + " was replaced and no longer matches it.";
+    }
+    throw runtime_error(message.c_str());
+  }
+
+  if (kept) remove(backup.c_str());
+}
+
+void PlaceFileWriter::discard()
+{
+  finished_ = true;
+  if (!tempPath_.empty()) remove(tempPath_.c_str());
+  if (!gzipTempPath_.empty()) remove(gzipTempPath_.c_str());
+}
+
+uint64_t PlaceFileWriter::bytesWritten() const
+{
+  return bytesFlushed_ + static_cast<uint64_t>(pptr() - pbase());
+}
+
+PlaceFileWriter::int_type PlaceFileWriter::overflow(int_type ch)
+{
+  if (!flushBuffer_()) return traits_type::eof();
+
+  if (!traits_type::eq_int_type(ch, traits_type::eof()))
+  {
+    *pptr() = traits_type::to_char_type(ch);
+    pbump(1);
+  }
+  return traits_type::not_eof(ch);
+}
+
+streamsize PlaceFileWriter::xsputn(const char* s, streamsize n)
+{
+  size_t size = static_cast<size_t>(n);
+  size_t room = static_cast<size_t>(epptr() - pptr());
+
+  if (size <= room)
+  {
+    traits_type::copy(pptr(), s, size);
+    pbump(static_cast<int>(size));
+    return n;
+  }
+
+  // Too big for what is left, so empty the buffer. Anything at least as big
+  // as the whole buffer goes straight to the file instead of being copied,
+  // unless it also has to be compressed.
+  if (!flushBuffer_()) return 0;
+
+  if (size >= buffer_.size() && !gzip_)
+  {
+    if (!writeToFile_(s, size)) return 0;
+    bytesFlushed_ += size;
+    return n;
+  }
+
+  while (size > 0)
+  {
+    room = static_cast<size_t>(epptr() - pptr());
+    if (room == 0)
+    {
+      if (!flushBuffer_()) return 0;
+      continue;
+    }
+
+    const size_t count = size < room ? size : room;
+    traits_type::copy(pptr(), s, count);
+    pbump(static_cast<int>(count));
+    s += count;
+    size -= count;
+  }
+  return n;
+}
+
+int PlaceFileWriter::sync()
+{
+  return flushBuffer_() ? 0 : -1;
+}
+
+bool PlaceFileWriter::flushBuffer_()
+{
+  const size_t size = static_cast<size_t>(pptr() - pbase());
+  if (size > 0)
+  {
+    if (file_ && !writeToFile_(pbase(), size)) return false;
+    if (gzip_) buffer_ = gzip_->push(move(buffer_), size);
+    bytesFlushed_ += size;
+  }
+  setp(&buffer_[0], &buffer_[0] + buffer_.size());
+  return true;
+}
+
+bool PlaceFileWriter::writeToFile_(const char* data, size_t size)
+{
+  if (failed_ || !file_) return false;
+
+  if (fwrite(data, 1, size, file_) != size) failed_ = true;
+
+  return !failed_;
+}
+
+string PlaceFileWriter::makeTempPath_(const string& path)
+{
+  // The process and a count of the writers it has made.
+  static atomic<unsigned int> count{ 0 };
+#ifdef _WIN32
+  const int process = _getpid();
+#else
+  const int process = static_cast<int>(getpid());
+#endif
+  return path + "." + to_string(process) + "." + to_string(count++) + ".tmp";
+}
@@ -0,0 +1,120 @@
+/*
+An output stream buffer that writes a PlaceFile straight to disk.
+
+PlaceFiles can be hundreds of MB, so rather than building the whole file in a
+stringstream and then copying it to an ofstream, features are formatted into a
+large reusable buffer that is handed to the file whenever it fills up. Use it
+as the buffer of an ostream:
+
+  PlaceFileWriter out(path);
+  ostream ost(&out);
+  ost << placeFile;
+  out.close();
+  out.publish();
+
+Everything is written to a temporary file next to the destination, which is
+flushed to disk by close() and then renamed over the destination by publish(),
+so anything reading the destination never sees a partly written file. Each
+writer picks its own temporary names, so two saves at once do not collide.
+Call discard() instead to leave the destination untouched.
+
+It can also write a gzip compressed copy, instead of or as well as the plain
+file. Each full buffer is handed to a background thread that compresses it
+while the next one is being filled, so compression overlaps formatting rather
+than being a second pass over the finished file. Compression uses the GDAL
+/vsigzip/ virtual file system so no other library is needed.
+
+Revisions:
+2026/10/16 - Initial version.
+2026/10/16 - Added gzip output.
+2026/10/16 - Write to a temporary file and rename it into place.
+2026/10/16 - Unique temporary names, undo the gzip rename if the plain fails.
+
+*/
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <streambuf>
+#include <string>
+#include <vector>
+
+namespace PFB
+{
+  class PlaceFileWriter : public std::streambuf
+  {
+  public:
+    /// Size of the buffer used if none is specified, 1 MB.
+    static const size_t DEFAULT_BUFFER_SIZE = 1 << 20;
+
+    /// Open the file for writing, truncating it. Throws runtime_error if the
+    /// file cannot be opened.
+    explicit PlaceFileWriter(const std::string& path,
+      size_t bufferSize = DEFAULT_BUFFER_SIZE);
+
+    /// Write the plain text to path and a gzip compressed copy to gzipPath.
+    /// Either may be empty, but not both. Throws runtime_error if a file
+    /// cannot be opened.
+    PlaceFileWriter(const std::string& path, const std::string& gzipPath,
+      size_t bufferSize = DEFAULT_BUFFER_SIZE);
+
+    /// Closes the file if close() was not called, but ignores any errors.
+    /// Temporary files that were not published are deleted.
+    ~PlaceFileWriter();
+
+    /// Disable copying
+    PlaceFileWriter(const PlaceFileWriter& src) = delete;
+    PlaceFileWriter& operator=(const PlaceFileWriter& rhs) = delete;
+
+    /// Write any buffered data, flush it to disk, and close the temporary
+    /// files. Throws runtime_error if any write failed.
+    void close();
+
+    /// Rename the temporary files over the destinations after close(), the
+    /// gzip file first. If the plain file then cannot be replaced, the old
+    /// gzip file is put back so the two still match. Throws runtime_error if
+    /// a rename fails, saying so if the gzip file could not be put back.
+    void publish();
+
+    /// Delete the temporary files after close(), leaving the destinations as
+    /// they were.
+    void discard();
+
+    /// Total number of bytes handed to this buffer so far, before compression.
+    uint64_t bytesWritten() const;
+
+    /// Size of the gzip file, only known after close().
+    uint64_t gzipBytesWritten() const { return gzipBytes_; }
+
+  protected:
+    int_type overflow(int_type ch) override;
+    std::streamsize xsputn(const char* s, std::streamsize n) override;
+    int sync() override;
+
+  private:
+    // Compresses full buffers on a background thread.
+    class GzipSink;
+
+    std::string path_;
+    std::string gzipPath_;
+    std::string tempPath_;      // Written in place of path_
+    std::string gzipTempPath_;  // Written in place of gzipPath_
+    FILE *file_ = nullptr;
+    std::vector<char> buffer_;
+    std::unique_ptr<GzipSink> gzip_;
+    uint64_t bytesFlushed_ = 0;
+    uint64_t gzipBytes_ = 0;
+    bool failed_ = false;
+    bool finished_ = false; // Published or discarded
+
+    // Write the data in the buffer to the file and reset the put area.
+    bool flushBuffer_();
+
+    // Write directly to the file, bypassing the buffer.
+    bool writeToFile_(const char* data, size_t size);
+
+    // A name for a temporary file next to path that no other writer uses.
+    static std::string makeTempPath_(const std::string& path);
+  };
+}
@@ -35,25 +35,33 @@ PointFeature & PFB::PointFeature::operator=(PointFeature && src)
   return *this;
 }
 
-ostream & PFB::PointFeature::put(ostream & ost) const
+PFB::StyleState PFB::PointFeature::put(ostream & ost, const StyleState& prev,
+  CoordinateFormatter& fmt) const
 {
   string label = getLabelString();
   /*Need to strip leading whitespace from the string*/
   const bool allWhiteSpace = label.find_first_not_of(" \t") == string::npos;
 
-  if(includeColor_) ost << "\n" << getColorString() << "\n";
-  if(includeThreshold_) ost << "\nThreshold: " << getDisplayThreshold() << "\n";
+  StyleState state = putStyle(ost, prev);
+
+  // Coordinates as "lat,lon"
+  char buf[2 * CoordinateFormatter::MAX_VALUE_CHARS + 1];
+  char *end = fmt.formatLatLon(point(_lat, _lon), buf);
 
   if (!allWhiteSpace)
   {
-    ost << "Place: " << _lat << "," << _lon << ", " << label << "\n";
+    ost << "Place: ";
+    ost.write(buf, end - buf);
+    ost << ", " << label << "\n";
   }
   else
   {
-    ost << "Text: " << _lat << "," << _lon << ", 1," << textSymbol << ",\n";
+    ost << "Text: ";
+    ost.write(buf, end - buf);
+    ost << ", 1," << textSymbol << ",\n";
   }
 
-  return ost;
+  return state;
 }
 
 void PFB::PointFeature::setTextSymbol(const char newSymbol)
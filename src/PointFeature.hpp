@@ -50,7 +50,8 @@ namespace PFB
 
     /// Create a string suitable to write to a place file describing this point 
     /// as an Object section and output it to a stream.
-    std::ostream& put(std::ostream& ost) const override;
+    StyleState put(std::ostream& ost, const StyleState& prev,
+      CoordinateFormatter& fmt) const override;
 
     /// Return the FeatureType
     FeatureType getFeatureType() const override
@@ -58,6 +59,17 @@ namespace PFB
       return FeatureType::POINT;
     }
 
+    /// A point is always a single vertex
+    size_t getNumPoints() const override { return 1; }
+
+    /// The box around a point is just the point
+    Bounds getBounds() const override
+    {
+      Bounds bounds;
+      bounds.extend(point(_lat, _lon));
+      return bounds;
+    }
+
     /// Set the text symbol
     static void setTextSymbol(const char newSymbol);
 
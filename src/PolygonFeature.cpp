@@ -1,9 +1,11 @@
 #include "PolygonFeature.hpp"
+#include "VertexCleanup.hpp"
 
 using PFB::PolygonFeature;
 
 PFB::PolygonFeature::PolygonFeature(const std::string & label, const PlaceFileColor & color, 
-  const OGRPolygon & polygon, int displayThresh, int lineWidth)
+  const OGRPolygon & polygon, int displayThresh, int lineWidth,
+  const GeometryOptions& geo, uint64_t* verticesCleaned)
   :Feature(label, color, displayThresh, lineWidth)
 {
   int numLines = polygon.getNumInteriorRings() + 1; // +1 for exterior ring.
@@ -23,6 +25,7 @@ PFB::PolygonFeature::PolygonFeature(const std::string & label, const PlaceFileCo
   _coords.reserve(numPoints);
 
   // Copy the points to our local data type
+  std::vector<point> ring;
   for (int l = 0; l != numLines; ++l)
   {
     const OGRLineString* ls = nullptr;
@@ -36,18 +39,39 @@ PFB::PolygonFeature::PolygonFeature(const std::string & label, const PlaceFileCo
     }
 
     int numPntsInRing = ls->getNumPoints();
-    int increment = 1;
-    while (numPntsInRing / increment > 5000) {
-      increment++;
+    if (geo.cleanVertices)
+    {
+      VertexCleaner cleaner(ring, geo.snapDecimals);
+      for (int i = 0; i < numPntsInRing; ++i) cleaner.add(ls->getY(i), ls->getX(i));
+      if (!_isOGRLinearRingClosed(*ls)) cleaner.add(ls->getY(0), ls->getX(0));
+      const size_t removed = cleaner.finish();
+      if (verticesCleaned) *verticesCleaned += removed;
     }
-
-    for (int i = 0; i < numPntsInRing; i += increment)
+    else
     {
-      _coords.push_back(point(ls->getY(i), ls->getX(i)));
+      ring.clear();
+      for (int i = 0; i < numPntsInRing; ++i)
+      {
+        ring.push_back(point(ls->getY(i), ls->getX(i)));
+      }
+
+      // Close the loop
+      if (!_isOGRLinearRingClosed(*ls)) ring.push_back(point(ls->getY(0), ls->getX(0)));
     }
-    
-    // Close the loop
-    _coords.push_back(point(ls->getY(0), ls->getX(0)));
+
+    // Also keeps it within the number of points GRLevelX can handle.
+    simplifyLine(ring, geo.simplify, geo.toleranceMeters, geo.maxRingPoints);
+    _coords.insert(_coords.end(), ring.begin(), ring.end());
+  }
+}
+
+PFB::PolygonFeature::PolygonFeature(const std::string & label, const PlaceFileColor & color,
+  const std::vector<std::vector<point>>& rings, int displayThresh, int lineWidth)
+  :Feature(label, color, displayThresh, lineWidth)
+{
+  for (const std::vector<point>& ring : rings)
+  {
+    _coords.insert(_coords.end(), ring.begin(), ring.end());
   }
 }
 
@@ -58,6 +82,13 @@ PFB::PolygonFeature::~PolygonFeature()
 {
 }
 
+PFB::Bounds PFB::PolygonFeature::getBounds() const
+{
+  Bounds bounds;
+  for (const point& pnt : _coords) bounds.extend(pnt);
+  return bounds;
+}
+
 PolygonFeature & PFB::PolygonFeature::operator=(PolygonFeature && src)
 {
   Feature::operator=(std::move(src));
@@ -65,25 +96,20 @@ PolygonFeature & PFB::PolygonFeature::operator=(PolygonFeature && src)
   return *this;
 }
 
-std::ostream & PFB::PolygonFeature::put(std::ostream & ost) const
+PFB::StyleState PFB::PolygonFeature::put(std::ostream & ost, 
+  const StyleState& prev, CoordinateFormatter& fmt) const
 {
-  if(includeColor_) ost << "\n" << getColorString() << "\n";
-  if(includeThreshold_) ost << "\nThreshold: " << getDisplayThreshold() << "\n";
+  StyleState state = putStyle(ost, prev);
   
   //ost << "Polygon: " << getLabelString() << "\n";
   ost << "Polygon: " << getLabelString() << "\n";
 
   // Output for each point.
-  size_t nPoints = _coords.size();
-  for (size_t i = 0; i != nPoints; ++i)
-  {
-    const point& currPnt = _coords[i];
-    ost << "  " << currPnt.latitude << "," << currPnt.longitude << "\n";
-  }
+  writeCoordinates(ost, fmt, _coords);
 
   ost << "End:\n\n";
 
-  return ost;
+  return state;
 }
 
 bool PFB::PolygonFeature::_isOGRLinearRingClosed(const OGRLineString & ring)
@@ -13,7 +13,9 @@ Revisions:
 #pragma once
 #include "Feature.hpp"
 #include "point.hpp"
+#include "Simplify.hpp"
 
+#include <cstdint>
 #include <vector>
 
 // Needed for initializing from any thing loaded via GDAL/OGR.
@@ -31,9 +33,16 @@ namespace PFB
     /// Copy constructor created by compiler is fine.
     //PolygonFeature(const PolygonFeature& src);
 
-    /// Create a line from a feature loaded in via GDAL library
+    /// Create a line from a feature loaded in via GDAL library, each ring is
+    /// cleaned up and simplified as set in geo. The number of vertices the
+    /// cleanup removes is added to verticesCleaned if it is not null.
     PolygonFeature(const std::string& label, const PlaceFileColor& color,
-      const OGRPolygon& polygon, int displayThresh, int lineWidth);
+      const OGRPolygon& polygon, int displayThresh, int lineWidth,
+      const GeometryOptions& geo = GeometryOptions(), uint64_t* verticesCleaned = nullptr);
+
+    /// Create a polygon from rings that are already closed and simplified.
+    PolygonFeature(const std::string& label, const PlaceFileColor& color,
+      const std::vector<std::vector<point>>& rings, int displayThresh, int lineWidth);
 
     /// Move constructor
     PolygonFeature(PolygonFeature&& src);
@@ -50,9 +59,16 @@ namespace PFB
       return FeatureType::POLYGON;
     }
 
+    /// Return the number of points in all the rings
+    size_t getNumPoints() const override { return _coords.size(); }
+
+    /// Return the box around all the rings
+    Bounds getBounds() const override;
+
     /// Create a string suitable to write to a place file describing this polygon 
     /// as a Polygon section and output it to a stream.
-    std::ostream& put(std::ostream& ost) const override;
+    StyleState put(std::ostream& ost, const StyleState& prev,
+      CoordinateFormatter& fmt) const override;
 
     static bool _isOGRLinearRingClosed(const OGRLineString& ring);
 
@@ -0,0 +1,394 @@
+#include "Reprojection.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <future>
+
+#include "point.hpp"
+
+using namespace std;
+using PFB::EARTH_RADIUS_METERS;
+using PFB::PI;
+using PFB::TransformCache;
+
+namespace
+{
+  const double METERS_PER_DEGREE = EARTH_RADIUS_METERS * PI / 180.0;
+
+  // Fewest vertices worth handing to another thread.
+  const size_t MIN_THREAD_VERTICES = 1 << 14;
+
+  // Cells are split at most this many times, 1/1024 of the batch across.
+  const int MAX_DEPTH = 10;
+
+  // Corners, then the center and the middle of the south, north, west and
+  // east edges of a cell.
+  const int NUM_CONTROL = 9;
+  const double CONTROL_U[NUM_CONTROL] = { 0, 1, 0, 1, 0.5, 0.5, 0.5, 0, 1 };
+  const double CONTROL_V[NUM_CONTROL] = { 0, 0, 1, 1, 0.5, 0, 1, 0.5, 0.5 };
+
+  // A cell of the grid of control points over the source coordinates, and
+  // the range of points inside it. The corners are transformed exactly, and
+  // the points are interpolated from them.
+  struct Cell
+  {
+    double x0, y0, x1, y1;
+    double lon[4], lat[4];  // South west, south east, north west, north east
+    size_t begin, end;      // Into the point order
+  };
+
+  inline void interpolate(const Cell& cell, double x, double y, double& lon, double& lat)
+  {
+    const double u = cell.x1 > cell.x0 ? (x - cell.x0) / (cell.x1 - cell.x0) : 0.0;
+    const double v = cell.y1 > cell.y0 ? (y - cell.y0) / (cell.y1 - cell.y0) : 0.0;
+    const double w[4] = { (1 - u) * (1 - v), u * (1 - v), (1 - u) * v, u * v };
+    lon = w[0] * cell.lon[0] + w[1] * cell.lon[1] + w[2] * cell.lon[2] + w[3] * cell.lon[3];
+    lat = w[0] * cell.lat[0] + w[1] * cell.lat[1] + w[2] * cell.lat[2] + w[3] * cell.lat[3];
+  }
+
+  inline double errorMeters(double lon0, double lat0, double lon1, double lat1)
+  {
+    const double dy = (lat1 - lat0) * METERS_PER_DEGREE;
+    const double dx = (lon1 - lon0) * METERS_PER_DEGREE * cos(lat0 * PI / 180.0);
+    return sqrt(dx * dx + dy * dy);
+  }
+
+  // Like TransformEx, but points are interpolated between exactly transformed
+  // control points where that is within maxError meters. The grid starts as
+  // one cell over all the points, and cells where the interpolated center
+  // and edge midpoints are off by more than maxError are split in four. Each
+  // level of the grid is transformed with one call. A cell is transformed
+  // exactly instead of split if it is at the deepest level, or if it has
+  // fewer points than its children would have control points, so this never
+  // does much more work than transforming every point.
+  void approxTransform(OGRCoordinateTransformation* trans, size_t n, double* x, double* y,
+    int* success, double maxError)
+  {
+    vector<size_t> order(n);
+    for (size_t i = 0; i != n; ++i) order[i] = i;
+
+    const auto xRange = minmax_element(x, x + n);
+    const auto yRange = minmax_element(y, y + n);
+    vector<Cell> level;
+    level.push_back(Cell{ *xRange.first, *yRange.first, *xRange.second, *yRange.second, 
+      {}, {}, 0, n });
+
+    vector<size_t> exact;
+    vector<double> cx, cy;
+    vector<int> ok;
+    for (int depth = 0; !level.empty(); ++depth)
+    {
+      cx.clear();
+      cy.clear();
+      for (const Cell& cell : level)
+      {
+        for (int k = 0; k != NUM_CONTROL; ++k)
+        {
+          cx.push_back(cell.x0 + CONTROL_U[k] * (cell.x1 - cell.x0));
+          cy.push_back(cell.y0 + CONTROL_V[k] * (cell.y1 - cell.y0));
+        }
+      }
+      ok.assign(cx.size(), TRUE);
+      trans->TransformEx(static_cast<int>(cx.size()), cx.data(), cy.data(), nullptr, ok.data());
+
+      vector<Cell> next;
+      for (size_t l = 0; l != level.size(); ++l)
+      {
+        Cell& cell = level[l];
+        const size_t base = l * NUM_CONTROL;
+        bool fine = all_of(ok.begin() + base, ok.begin() + base + NUM_CONTROL,
+          [](int good) { return good != FALSE; });
+        if (fine)
+        {
+          for (int k = 0; k != 4; ++k)
+          {
+            cell.lon[k] = cx[base + k];
+            cell.lat[k] = cy[base + k];
+          }
+          for (int k = 4; k != NUM_CONTROL && fine; ++k)
+          {
+            double lon, lat;
+            interpolate(cell, cell.x0 + CONTROL_U[k] * (cell.x1 - cell.x0),
+              cell.y0 + CONTROL_V[k] * (cell.y1 - cell.y0), lon, lat);
+            fine = errorMeters(cx[base + k], cy[base + k], lon, lat) <= maxError;
+          }
+        }
+
+        if (fine)
+        {
+          for (size_t i = cell.begin; i != cell.end; ++i)
+          {
+            const size_t p = order[i];
+            interpolate(cell, x[p], y[p], x[p], y[p]);
+            success[p] = TRUE;
+          }
+          continue;
+        }
+
+        if (depth == MAX_DEPTH || cell.end - cell.begin < 4 * NUM_CONTROL)
+        {
+          exact.insert(exact.end(), order.begin() + cell.begin, order.begin() + cell.end);
+          continue;
+        }
+
+        // Split the points between the quarters, leaving out empty ones.
+        const double xm = (cell.x0 + cell.x1) / 2.0;
+        const double ym = (cell.y0 + cell.y1) / 2.0;
+        auto first = order.begin() + cell.begin;
+        auto last = order.begin() + cell.end;
+        auto east = partition(first, last, [x, xm](size_t p) { return x[p] < xm; });
+        auto westNorth = partition(first, east, [y, ym](size_t p) { return y[p] < ym; });
+        auto eastNorth = partition(east, last, [y, ym](size_t p) { return y[p] < ym; });
+        const Cell quarters[4] = {
+          Cell{ cell.x0, cell.y0, xm, ym, {}, {}, cell.begin, size_t(westNorth - order.begin()) },
+          Cell{ cell.x0, ym, xm, cell.y1, {}, {}, size_t(westNorth - order.begin()), size_t(east - order.begin()) },
+          Cell{ xm, cell.y0, cell.x1, ym, {}, {}, size_t(east - order.begin()), size_t(eastNorth - order.begin()) },
+          Cell{ xm, ym, cell.x1, cell.y1, {}, {}, size_t(eastNorth - order.begin()), cell.end } };
+        for (const Cell& quarter : quarters)
+        {
+          if (quarter.end > quarter.begin) next.push_back(quarter);
+        }
+      }
+      level.swap(next);
+    }
+
+    if (exact.empty()) return;
+    vector<double> ex, ey;
+    ex.reserve(exact.size());
+    ey.reserve(exact.size());
+    for (size_t p : exact)
+    {
+      ex.push_back(x[p]);
+      ey.push_back(y[p]);
+    }
+    ok.assign(exact.size(), TRUE);
+    trans->TransformEx(static_cast<int>(ex.size()), ex.data(), ey.data(), nullptr, ok.data());
+    for (size_t k = 0; k != exact.size(); ++k)
+    {
+      x[exact[k]] = ex[k];
+      y[exact[k]] = ey[k];
+      success[exact[k]] = ok[k];
+    }
+  }
+
+  // Call curve for each line or ring and point for each point in geometry.
+  template<class Curve, class Point>
+  void forEachPart(OGRGeometry& geometry, Curve curve, Point point)
+  {
+    switch (wkbFlatten(geometry.getGeometryType()))
+    {
+    case wkbPoint:
+      point(static_cast<OGRPoint&>(geometry));
+      break;
+
+    case wkbLineString:
+    case wkbLinearRing:
+      curve(static_cast<OGRSimpleCurve&>(geometry));
+      break;
+
+    case wkbPolygon:
+    {
+      OGRPolygon& poly = static_cast<OGRPolygon&>(geometry);
+      if (poly.getExteriorRing() != nullptr) curve(*poly.getExteriorRing());
+      for (int i = 0; i != poly.getNumInteriorRings(); ++i) curve(*poly.getInteriorRing(i));
+      break;
+    }
+
+    case wkbMultiPoint:
+    case wkbMultiLineString:
+    case wkbMultiPolygon:
+    case wkbGeometryCollection:
+    {
+      OGRGeometryCollection& coll = static_cast<OGRGeometryCollection&>(geometry);
+      for (int i = 0; i != coll.getNumGeometries(); ++i)
+      {
+        forEachPart(*coll.getGeometryRef(i), curve, point);
+      }
+      break;
+    }
+
+    default:
+      // PlaceFile::addOGRGeometry reports anything it cannot handle.
+      break;
+    }
+  }
+}
+
+TransformCache::TransformCache()
+{
+  target_.SetWellKnownGeogCS("WGS84");
+}
+
+TransformCache::~TransformCache()
+{
+  for (auto& entry : transforms_)
+  {
+    for (OGRCoordinateTransformation* trans : entry.second)
+    {
+      if (trans != nullptr) OGRCoordinateTransformation::DestroyCT(trans);
+    }
+  }
+}
+
+OGRCoordinateTransformation* TransformCache::get(OGRSpatialReference* srs, size_t worker)
+{
+  if (srs == nullptr || srs->IsSame(&target_)) return nullptr;
+
+  char* wkt = nullptr;
+  if (srs->exportToWkt(&wkt) != OGRERR_NONE || wkt == nullptr)
+  {
+    CPLFree(wkt);
+    return nullptr;
+  }
+  const string key(wkt);
+  CPLFree(wkt);
+
+  // Failures are kept too, so they are not tried again. There is no way to
+  // copy a transformation, so each worker's is made from the same pair.
+  vector<OGRCoordinateTransformation*>& perWorker = transforms_[key];
+  while (perWorker.size() <= worker)
+  {
+    if (!perWorker.empty() && perWorker.front() == nullptr) return nullptr;
+    perWorker.push_back(OGRCreateCoordinateTransformation(srs, &target_));
+  }
+  return perWorker[worker];
+}
+
+size_t PFB::countVertices(const OGRGeometry& geometry)
+{
+  size_t count = 0;
+  forEachPart(const_cast<OGRGeometry&>(geometry),
+    [&count](OGRSimpleCurve& curve) { count += curve.getNumPoints(); },
+    [&count](OGRPoint&) { ++count; });
+  return count;
+}
+
+vector<bool> PFB::transformAll(const vector<OGRGeometry*>& geometries,
+  OGRCoordinateTransformation* trans, double maxErrorMeters)
+{
+  vector<bool> transformed(geometries.size(), true);
+  if (trans == nullptr) return transformed;
+
+  // Copy out every vertex, remembering where each geometry starts.
+  vector<double> x, y;
+  vector<size_t> starts;
+  starts.reserve(geometries.size() + 1);
+  for (OGRGeometry* geometry : geometries)
+  {
+    starts.push_back(x.size());
+    forEachPart(*geometry,
+      [&x, &y](OGRSimpleCurve& curve)
+      {
+        for (int i = 0; i != curve.getNumPoints(); ++i)
+        {
+          x.push_back(curve.getX(i));
+          y.push_back(curve.getY(i));
+        }
+      },
+      [&x, &y](OGRPoint& pnt)
+      {
+        x.push_back(pnt.getX());
+        y.push_back(pnt.getY());
+      });
+  }
+  starts.push_back(x.size());
+  if (x.empty()) return transformed;
+
+  vector<int> success(x.size(), TRUE);
+  if (maxErrorMeters > 0.0)
+  {
+    approxTransform(trans, x.size(), x.data(), y.data(), success.data(), maxErrorMeters);
+  }
+  else
+  {
+    trans->TransformEx(static_cast<int>(x.size()), x.data(), y.data(), nullptr, success.data());
+  }
+
+  // Copy the vertices back in the same order.
+  for (size_t g = 0; g != geometries.size(); ++g)
+  {
+    transformed[g] = all_of(success.begin() + starts[g], success.begin() + starts[g + 1],
+      [](int ok) { return ok != FALSE; });
+    if (!transformed[g]) continue;
+
+    size_t next = starts[g];
+    forEachPart(*geometries[g],
+      [&x, &y, &next](OGRSimpleCurve& curve)
+      {
+        const int numPoints = curve.getNumPoints();
+        if (numPoints == 0) return;
+        curve.setPoints(numPoints, &x[next], &y[next]);
+        next += numPoints;
+      },
+      [&x, &y, &next](OGRPoint& pnt)
+      {
+        pnt.setX(x[next]);
+        pnt.setY(y[next]);
+        ++next;
+      });
+  }
+
+  return transformed;
+}
+
+vector<bool> PFB::transformAllParallel(const vector<OGRGeometry*>& geometries,
+  TransformCache& cache, OGRSpatialReference* srs, unsigned int numThreads, 
+  double maxErrorMeters)
+{
+  OGRCoordinateTransformation* trans = cache.get(srs);
+  if (trans == nullptr) return vector<bool>(geometries.size(), true);
+
+  vector<size_t> vertices;
+  vertices.reserve(geometries.size());
+  size_t total = 0;
+  for (const OGRGeometry* geometry : geometries)
+  {
+    vertices.push_back(countVertices(*geometry));
+    total += vertices.back();
+  }
+
+  // Only use as many threads as have enough work. Their transformations are
+  // made here, the cache is not safe to use from the workers.
+  size_t numWorkers = max<size_t>(1, min<size_t>(numThreads, total / MIN_THREAD_VERTICES));
+  vector<OGRCoordinateTransformation*> workerTrans{ trans };
+  while (workerTrans.size() < numWorkers)
+  {
+    OGRCoordinateTransformation* next = cache.get(srs, workerTrans.size());
+    if (next == nullptr) break;
+    workerTrans.push_back(next);
+  }
+  numWorkers = workerTrans.size();
+  if (numWorkers == 1) return transformAll(geometries, trans, maxErrorMeters);
+
+  // Runs of geometries with about the same number of vertices.
+  vector<size_t> starts{ 0 };
+  size_t sum = 0;
+  for (size_t g = 0; g != geometries.size() && starts.size() < numWorkers; ++g)
+  {
+    sum += vertices[g];
+    if (sum * numWorkers >= total * starts.size()) starts.push_back(g + 1);
+  }
+  starts.push_back(geometries.size());
+
+  auto transformRun = [&geometries, &starts, &workerTrans, maxErrorMeters](size_t run)
+  {
+    const vector<OGRGeometry*> part(geometries.begin() + starts[run],
+      geometries.begin() + starts[run + 1]);
+    return transformAll(part, workerTrans[run], maxErrorMeters);
+  };
+
+  // The first run is done on this thread while the others are.
+  vector<future<vector<bool>>> others;
+  for (size_t run = 1; run + 1 < starts.size(); ++run)
+  {
+    others.push_back(async(launch::async, transformRun, run));
+  }
+  vector<bool> transformed = transformRun(0);
+  for (auto& other : others)
+  {
+    const vector<bool> part = other.get();
+    transformed.insert(transformed.end(), part.begin(), part.end());
+  }
+
+  return transformed;
+}
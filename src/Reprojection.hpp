@@ -0,0 +1,78 @@
+/*
+Transforms the vertices of source geometry to WGS84 latitude and longitude.
+
+Layers that share a spatial reference share one transformation, kept in a
+TransformCache for the length of a save, and layers already in WGS84 latitude
+and longitude are not transformed at all. Rather than calling transform on
+each geometry, which goes into PROJ once for every ring and part, the
+vertices of a batch of geometries are copied into contiguous x and y arrays
+and transformed with one call.
+
+Transformations are not thread safe, so to use more than one core the cache
+keeps a separate transformation for each worker thread, all for the same
+pair of spatial references. A batch is split into runs with about the same
+number of vertices, and each worker transforms one run with its own.
+
+At the scale of a radar display the exact math is more than needed for a
+projected source, so points can instead be interpolated between exactly
+transformed control points on a grid that is refined until the error is
+within a tolerance in meters.
+
+Revisions:
+2026/10/16 - Initial version.
+
+*/
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "ogrsf_frmts.h"
+
+namespace PFB
+{
+  class TransformCache
+  {
+  public:
+    TransformCache();
+    ~TransformCache();
+
+    TransformCache(const TransformCache&) = delete;
+    TransformCache& operator=(const TransformCache&) = delete;
+
+    /// The transformation from srs to WGS84 latitude and longitude. Null if
+    /// srs is null, is already WGS84 latitude and longitude, or cannot be
+    /// transformed. The cache owns it. Each worker thread gets its own
+    /// transformation, and must only use that one.
+    OGRCoordinateTransformation* get(OGRSpatialReference* srs, size_t worker = 0);
+
+    /// WGS84 latitude and longitude.
+    OGRSpatialReference& target() { return target_; }
+
+  private:
+    OGRSpatialReference target_;
+    // By the WKT of the source, then by worker.
+    std::unordered_map<std::string, std::vector<OGRCoordinateTransformation*>> transforms_;
+  };
+
+  /// Number of vertices in points, lines, polygon rings, and the parts of
+  /// collections of them.
+  size_t countVertices(const OGRGeometry& geometry);
+
+  /// Transform all the vertices of the geometries with one call to trans.
+  /// Geometries with a vertex that fails to transform are left as they were,
+  /// and false is returned for them. If maxErrorMeters is more than zero,
+  /// vertices are interpolated from control points where that is off by no
+  /// more than that, and transformed exactly elsewhere.
+  std::vector<bool> transformAll(const std::vector<OGRGeometry*>& geometries,
+    OGRCoordinateTransformation* trans, double maxErrorMeters = 0.0);
+
+  /// Like transformAll, but the geometries are split into runs and
+  /// transformed on up to numThreads threads, each with the transformation
+  /// from srs that the cache keeps for it. Results are in the same order.
+  std::vector<bool> transformAllParallel(const std::vector<OGRGeometry*>& geometries,
+    TransformCache& cache, OGRSpatialReference* srs, unsigned int numThreads, 
+    double maxErrorMeters = 0.0);
+}
@@ -0,0 +1,267 @@
+#include "Simplify.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <queue>
+#include <utility>
+
+using namespace std;
+using PFB::EARTH_RADIUS_METERS;
+using PFB::PI;
+using PFB::point;
+
+namespace
+{
+  const double METERS_PER_NM = 1852.0;
+  const double PIXELS_ACROSS = 1000.0;
+
+  // Scratch space for one line, reused between calls on the same thread.
+  struct Workspace
+  {
+    vector<double> x, y;  // Meters in a local equirectangular projection
+    vector<double> value; // Distance or area of each point from the kernels
+    vector<char> keep;
+    vector<size_t> prev, next;
+  };
+
+  Workspace& workspace()
+  {
+    thread_local Workspace ws;
+    return ws;
+  }
+
+  void project(const vector<point>& pts, Workspace& ws)
+  {
+    const size_t n = pts.size();
+    double latSum = 0.0;
+    for (size_t i = 0; i != n; ++i) latSum += pts[i].latitude;
+
+    const double ky = EARTH_RADIUS_METERS * PI / 180.0;
+    const double kx = ky * cos(latSum / n * PI / 180.0);
+
+    ws.x.resize(n);
+    ws.y.resize(n);
+    double *x = ws.x.data();
+    double *y = ws.y.data();
+    const point *p = pts.data();
+    for (size_t i = 0; i != n; ++i)
+    {
+      x[i] = p[i].longitude * kx;
+      y[i] = p[i].latitude * ky;
+    }
+  }
+
+  // Squared distance from each point between a and b, exclusive, to the
+  // segment from a to b. If a and b are the same point it is the distance to
+  // that point.
+  void segmentDistances(const double* x, const double* y, size_t a, size_t b,
+    double* dist)
+  {
+    const double ax = x[a];
+    const double ay = y[a];
+    const double dx = x[b] - ax;
+    const double dy = y[b] - ay;
+    const double len2 = dx * dx + dy * dy;
+    const double inv = len2 > 0.0 ? 1.0 / len2 : 0.0;
+
+    for (size_t i = a + 1; i < b; ++i)
+    {
+      const double px = x[i] - ax;
+      const double py = y[i] - ay;
+      double t = (px * dx + py * dy) * inv;
+      t = t < 0.0 ? 0.0 : (t > 1.0 ? 1.0 : t);
+      const double ex = px - t * dx;
+      const double ey = py - t * dy;
+      dist[i] = ex * ex + ey * ey;
+    }
+  }
+
+  // Index of the largest value between a and b, exclusive.
+  size_t farthest(const double* dist, size_t a, size_t b)
+  {
+    size_t far = a + 1;
+    for (size_t i = a + 2; i < b; ++i)
+    {
+      if (dist[i] > dist[far]) far = i;
+    }
+    return far;
+  }
+
+  // Mark the points between first and last that are needed to stay within
+  // the tolerance. Uses a stack instead of recursion so very long lines do
+  // not overflow the call stack.
+  void douglasPeucker(Workspace& ws, size_t first, size_t last, double tol2)
+  {
+    const double *x = ws.x.data();
+    const double *y = ws.y.data();
+    double *dist = ws.value.data();
+
+    vector<pair<size_t, size_t>> spans{ make_pair(first, last) };
+    while (!spans.empty())
+    {
+      const size_t a = spans.back().first;
+      const size_t b = spans.back().second;
+      spans.pop_back();
+      if (b - a < 2) continue;
+
+      segmentDistances(x, y, a, b, dist);
+      const size_t far = farthest(dist, a, b);
+      if (dist[far] <= tol2) continue;
+
+      ws.keep[far] = 1;
+      spans.push_back(make_pair(a, far));
+      spans.push_back(make_pair(far, b));
+    }
+  }
+
+  double triangleArea(const double* x, const double* y, size_t a, size_t b, size_t c)
+  {
+    return 0.5 * fabs((x[b] - x[a]) * (y[c] - y[a]) - (x[c] - x[a]) * (y[b] - y[a]));
+  }
+
+  // Remove the points between the ends in order of the area of the triangle
+  // each makes with its neighbors, while that area is below minArea or there
+  // are more than maxPoints, but never leave fewer than minPoints.
+  void visvalingamWhyatt(Workspace& ws, size_t n, double minArea,
+    size_t maxPoints, size_t minPoints)
+  {
+    const double *x = ws.x.data();
+    const double *y = ws.y.data();
+    double *area = ws.value.data();
+
+    ws.keep.assign(n, 1);
+    ws.prev.resize(n);
+    ws.next.resize(n);
+    for (size_t i = 0; i != n; ++i)
+    {
+      ws.prev[i] = i - 1;
+      ws.next[i] = i + 1;
+    }
+
+    for (size_t i = 1; i + 1 < n; ++i)
+    {
+      area[i] = 0.5 * fabs((x[i] - x[i - 1]) * (y[i + 1] - y[i - 1]) -
+        (x[i + 1] - x[i - 1]) * (y[i] - y[i - 1]));
+    }
+
+    // Entries go stale when a neighbor is removed, they are skipped when
+    // their area no longer matches.
+    using Entry = pair<double, size_t>;
+    vector<Entry> entries;
+    entries.reserve(n);
+    for (size_t i = 1; i + 1 < n; ++i) entries.push_back(make_pair(area[i], i));
+    priority_queue<Entry, vector<Entry>, greater<Entry>> heap(greater<Entry>(),
+      move(entries));
+
+    size_t remaining = n;
+    while (!heap.empty() && remaining > minPoints)
+    {
+      const Entry top = heap.top();
+      const size_t i = top.second;
+      if (!ws.keep[i] || top.first != area[i])
+      {
+        heap.pop();
+        continue;
+      }
+      if (top.first >= minArea && remaining <= maxPoints) break;
+      heap.pop();
+
+      ws.keep[i] = 0;
+      --remaining;
+      const size_t p = ws.prev[i];
+      const size_t nx = ws.next[i];
+      ws.next[p] = nx;
+      ws.prev[nx] = p;
+
+      // A neighbor is never less significant than the point removed before
+      // it, so the order of removal does not jump around.
+      if (p > 0)
+      {
+        area[p] = max(triangleArea(x, y, ws.prev[p], p, nx), top.first);
+        heap.push(make_pair(area[p], p));
+      }
+      if (nx + 1 < n)
+      {
+        area[nx] = max(triangleArea(x, y, p, nx, ws.next[nx]), top.first);
+        heap.push(make_pair(area[nx], nx));
+      }
+    }
+  }
+
+  // Keep only the marked points, returns how many are left.
+  size_t compact(vector<point>& pts, const vector<char>& keep)
+  {
+    size_t out = 0;
+    for (size_t i = 0; i != pts.size(); ++i)
+    {
+      if (keep[i]) pts[out++] = pts[i];
+    }
+    pts.resize(out);
+    return out;
+  }
+}
+
+double PFB::toleranceForThreshold(int displayThreshold)
+{
+  return displayThreshold > 0 ? displayThreshold * METERS_PER_NM / PIXELS_ACROSS : 0.0;
+}
+
+void PFB::simplifyLine(vector<point>& pts, SimplifyMethod method,
+  double toleranceMeters, size_t maxPoints)
+{
+  size_t n = pts.size();
+  const bool closed = n > 3 && pts.front().latitude == pts.back().latitude &&
+    pts.front().longitude == pts.back().longitude;
+  const size_t minPoints = closed ? 4 : 2;
+  if (n <= minPoints) return;
+
+  const bool useTolerance = method != SimplifyMethod::NONE && toleranceMeters > 0.0;
+  if (maxPoints == 0) maxPoints = n;
+  maxPoints = max(maxPoints, minPoints);
+  if (!useTolerance && n <= maxPoints) return;
+
+  Workspace& ws = workspace();
+  project(pts, ws);
+  ws.value.resize(n);
+
+  const double tol2 = toleranceMeters * toleranceMeters;
+  if (useTolerance && method == SimplifyMethod::DOUGLAS_PEUCKER)
+  {
+    ws.keep.assign(n, 0);
+    ws.keep[0] = ws.keep[n - 1] = 1;
+    if (closed)
+    {
+      // The ends are the same point, so split the ring at the point farthest
+      // from them and simplify each half.
+      segmentDistances(ws.x.data(), ws.y.data(), 0, n - 1, ws.value.data());
+      const size_t far = farthest(ws.value.data(), 0, n - 1);
+      ws.keep[far] = 1;
+      douglasPeucker(ws, 0, far, tol2);
+      douglasPeucker(ws, far, n - 1, tol2);
+    }
+    else
+    {
+      douglasPeucker(ws, 0, n - 1, tol2);
+    }
+
+    const size_t kept = static_cast<size_t>(count(ws.keep.begin(), ws.keep.end(), 1));
+    if (kept < minPoints)
+    {
+      // The ring collapsed, keep its most significant points instead.
+      visvalingamWhyatt(ws, n, 0.0, minPoints, minPoints);
+    }
+    else if (kept > maxPoints)
+    {
+      n = compact(pts, ws.keep);
+      project(pts, ws);
+      visvalingamWhyatt(ws, n, 0.0, maxPoints, minPoints);
+    }
+  }
+  else
+  {
+    visvalingamWhyatt(ws, n, useTolerance ? tol2 : 0.0, maxPoints, minPoints);
+  }
+
+  compact(pts, ws.keep);
+}
@@ -0,0 +1,85 @@
+/*
+Simplification of lines and polygon rings as they are loaded.
+
+Vertices that add less detail than a tolerance in meters are removed with
+either the Douglas-Peucker or the Visvalingam-Whyatt algorithm. Distances are
+measured in a local equirectangular projection centered on the line, which is
+plenty accurate at the scale of a single feature. The coordinates are copied
+into separate x and y arrays so the inner loops run over contiguous doubles and
+can be vectorized by the compiler.
+
+Lines and rings that still have too many vertices for GRLevelX to handle are
+reduced to the limit by removing the least significant vertices first, rather
+than keeping every Nth vertex.
+
+Revisions:
+2026/10/16 - Initial version.
+2026/10/16 - Added detail levels by display threshold.
+
+*/
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+#include "point.hpp"
+
+namespace PFB
+{
+  enum class SimplifyMethod { NONE, DOUGLAS_PEUCKER, VISVALINGAM_WHYATT };
+
+  /// How the geometry of a layer is reduced as it is loaded.
+  struct GeometryOptions
+  {
+    SimplifyMethod simplify = SimplifyMethod::NONE;
+
+    /// Douglas-Peucker removes vertices closer than this to the simplified
+    /// line, Visvalingam-Whyatt removes vertices that make a triangle with
+    /// their neighbors smaller than this squared.
+    double toleranceMeters = 0.0;
+
+    /// Most vertices kept in a Line: or in each ring of a Polygon:.
+    size_t maxLinePoints = 10000;
+    size_t maxRingPoints = 5000;
+
+    /// Display thresholds where more detail is added, see
+    /// PlaceFile::addOGRGeometry. Empty writes each feature once.
+    std::vector<int> detailThresholds;
+
+    /// Simplify the lines and polygons of a layer together so boundaries
+    /// they share are simplified the same way, see PlaceFile::endLayer.
+    bool preserveTopology = false;
+
+    /// When polygons are drawn as lines, write each boundary they share
+    /// once instead of once for each polygon. The lines get the label of the
+    /// polygon that owns them, the first to use them, if labelSharedEdges is
+    /// set, otherwise no label.
+    bool shareEdges = false;
+    bool labelSharedEdges = false;
+
+    /// Join lines that meet end to end and have the same label and style,
+    /// see mergeLines. They are held until PlaceFile::endLayer. Joined lines
+    /// with more than maxLinePoints are split, see splitLine, not reduced.
+    bool mergeLines = false;
+
+    /// Round vertices to snapDecimals places and remove the ones that do not
+    /// change the shape before simplifying, see VertexCleaner. If
+    /// snapDecimals is negative PlaceFile::addOGRGeometry uses the places the
+    /// layer is written with.
+    bool cleanVertices = false;
+    int snapDecimals = -1;
+  };
+
+  /// Tolerance for geometry shown when zoomed out as far as this display
+  /// threshold, about one pixel when the view is roughly 1000 pixels across
+  /// that many nautical miles.
+  double toleranceForThreshold(int displayThreshold);
+
+  /// Simplify a line in place, or a ring if the first and last points are
+  /// the same. If more than maxPoints are left after removing those within
+  /// the tolerance, the least significant are removed until maxPoints are
+  /// left, zero means no limit. The end points are always kept, and a ring
+  /// keeps at least 4 points including the closing one.
+  void simplifyLine(std::vector<point>& pts, SimplifyMethod method,
+    double toleranceMeters, size_t maxPoints);
+}
@@ -0,0 +1,150 @@
+#include "SpatialIndex.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <utility>
+
+#include "ClipRegion.hpp"
+
+using namespace std;
+using PFB::Bounds;
+using PFB::EARTH_RADIUS_MILES;
+using PFB::PI;
+using PFB::SpatialIndex;
+
+namespace
+{
+  inline double centerLat(const SpatialIndex::Entry& entry)
+  {
+    return entry.bounds.south + entry.bounds.north;
+  }
+
+  inline double centerLon(const SpatialIndex::Entry& entry)
+  {
+    return entry.bounds.west + entry.bounds.east;
+  }
+
+  // Great circle distance in miles.
+  double distanceMiles(double lat1, double lon1, double lat2, double lon2)
+  {
+    const double toRad = PI / 180.0;
+    const double sinLat = sin((lat2 - lat1) * toRad / 2.0);
+    const double sinLon = sin((lon2 - lon1) * toRad / 2.0);
+    const double a = sinLat * sinLat + cos(lat1 * toRad) * cos(lat2 * toRad) * sinLon * sinLon;
+    return 2.0 * EARTH_RADIUS_MILES * asin(sqrt(min(a, 1.0)));
+  }
+}
+
+void SpatialIndex::build(vector<Entry>&& entries)
+{
+  clear();
+  const size_t n = entries.size();
+  if (n == 0) return;
+
+  // Sort-Tile-Recursive, slices of whole leaf nodes by longitude, then by
+  // latitude within each slice.
+  const size_t leafNodes = (n + NODE_SIZE - 1) / NODE_SIZE;
+  const size_t slices = static_cast<size_t>(ceil(sqrt(static_cast<double>(leafNodes))));
+  const size_t sliceSize = slices * NODE_SIZE;
+  sort(entries.begin(), entries.end(), [](const Entry& lhs, const Entry& rhs)
+  {
+    return centerLon(lhs) < centerLon(rhs);
+  });
+  for (size_t start = 0; start < n; start += sliceSize)
+  {
+    sort(entries.begin() + start, entries.begin() + min(start + sliceSize, n),
+      [](const Entry& lhs, const Entry& rhs) { return centerLat(lhs) < centerLat(rhs); });
+  }
+
+  // A level has 1/NODE_SIZE as many boxes as the one below it.
+  boxes_.reserve(n + n / (NODE_SIZE - 1) + 2);
+  keys_.reserve(n);
+  levels_.push_back(0);
+  for (const Entry& entry : entries)
+  {
+    boxes_.push_back(entry.bounds);
+    keys_.push_back(entry.key);
+  }
+
+  // Pack each level into full nodes until there is a single root.
+  size_t start = 0;
+  size_t count = n;
+  while (count > 1)
+  {
+    levels_.push_back(boxes_.size());
+    for (size_t i = 0; i < count; i += NODE_SIZE)
+    {
+      Bounds node;
+      for (size_t j = i; j < min(i + NODE_SIZE, count); ++j) node.extend(boxes_[start + j]);
+      boxes_.push_back(node);
+    }
+    start = levels_.back();
+    count = boxes_.size() - start;
+  }
+}
+
+void SpatialIndex::clear()
+{
+  boxes_.clear();
+  levels_.clear();
+  keys_.clear();
+}
+
+template<class Visit>
+void SpatialIndex::search_(const Bounds& box, Visit visit) const
+{
+  if (keys_.empty()) return;
+
+  // Pairs of level and box index, starting at the root.
+  vector<pair<size_t, size_t>> stack;
+  stack.push_back(make_pair(levels_.size() - 1, boxes_.size() - 1));
+  while (!stack.empty())
+  {
+    const size_t level = stack.back().first;
+    const size_t node = stack.back().second;
+    stack.pop_back();
+    if (!boxes_[node].intersects(box)) continue;
+
+    if (level == 0)
+    {
+      visit(node);
+      continue;
+    }
+
+    const size_t first = levels_[level - 1] + (node - levels_[level]) * NODE_SIZE;
+    const size_t last = min(first + NODE_SIZE, levels_[level]);
+    for (size_t child = first; child < last; ++child)
+    {
+      stack.push_back(make_pair(level - 1, child));
+    }
+  }
+}
+
+void SpatialIndex::query(const Bounds& box, vector<size_t>& keys) const
+{
+  search_(box, [this, &keys](size_t leaf) { keys.push_back(keys_[leaf]); });
+}
+
+void SpatialIndex::queryRadius(const point& center, double radiusMiles, 
+  vector<size_t>& keys) const
+{
+  const ClipRegion region = ClipRegion::around(center, radiusMiles);
+  Bounds box;
+  box.south = region.south();
+  box.west = region.west();
+  box.north = region.north();
+  box.east = region.east();
+
+  // The box around the circle finds candidates, then the closest point of
+  // each box is checked against the radius.
+  search_(box, [this, &keys, &center, radiusMiles](size_t leaf)
+  {
+    const Bounds& bounds = boxes_[leaf];
+    const double lat = max(bounds.south, min(center.latitude, bounds.north));
+    const double lon = max(bounds.west, min(center.longitude, bounds.east));
+    if (distanceMiles(center.latitude, center.longitude, lat, lon) <= radiusMiles)
+    {
+      keys.push_back(keys_[leaf]);
+    }
+  });
+}
@@ -0,0 +1,64 @@
+/*
+A packed R-tree over the bounding boxes of features.
+
+Finds the features in a region or near a point without looking at every
+one, each feature given by a box and a key chosen by the caller. The tree is
+bulk loaded once all the boxes are known with the Sort-Tile-Recursive method. The boxes are
+sorted into vertical slices by longitude, each slice is sorted by latitude,
+and runs of boxes are packed into full nodes. The nodes of every level are
+kept in one flat array, so building the tree is a sort and a pass per level,
+and there are no pointers to follow when searching it.
+
+Revisions:
+2026/10/16 - Initial version.
+
+*/
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+#include "point.hpp"
+
+namespace PFB
+{
+  class SpatialIndex
+  {
+  public:
+    /// A feature key and the box around it.
+    struct Entry
+    {
+      Bounds bounds;
+      size_t key;
+    };
+
+    /// Replace the contents of the index with these entries.
+    void build(std::vector<Entry>&& entries);
+
+    void clear();
+
+    size_t size() const { return keys_.size(); }
+    bool empty() const { return keys_.empty(); }
+
+    /// Append the keys of entries whose boxes intersect box to keys, in no
+    /// particular order.
+    void query(const Bounds& box, std::vector<size_t>& keys) const;
+
+    /// Append the keys of entries with some part of their box within
+    /// radiusMiles of center to keys, in no particular order.
+    void queryRadius(const point& center, double radiusMiles, std::vector<size_t>& keys) const;
+
+  private:
+    static const size_t NODE_SIZE = 16;
+
+    // The leaves first, one per entry, then each level of nodes up to the
+    // root. Level i starts at levels_[i].
+    std::vector<Bounds> boxes_;
+    std::vector<size_t> levels_;
+    std::vector<size_t> keys_;
+
+    // Call visit with the index of each leaf whose box intersects box.
+    template<class Visit>
+    void search_(const Bounds& box, Visit visit) const;
+  };
+}
@@ -0,0 +1,103 @@
+#include "SpillFile.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+
+#include "cpl_conv.h"
+#include "cpl_multiproc.h"
+#include "cpl_string.h"
+
+using namespace std;
+using PFB::SpillFile;
+
+namespace
+{
+  const string STEM = "PlaceFileBuilder_";
+
+  string tempDirectory()
+  {
+    for (const char *option : { "CPL_TMPDIR", "TMPDIR", "TEMP", "TMP" })
+    {
+      const char *dir = CPLGetConfigOption(option, nullptr);
+      if (dir != nullptr && *dir != '\0') return dir;
+    }
+    return "/tmp";
+  }
+}
+
+SpillFile::SpillFile(const string& prefix)
+{
+  // Files from earlier saves can still be in use, so skip past them.
+  VSIStatBufL stat;
+  for (unsigned int number = 0; path_.empty() || VSIStatL(path_.c_str(), &stat) == 0; ++number)
+  {
+    path_ = prefix + to_string(number) + ".tmp";
+  }
+
+  file_ = VSIFOpenL(path_.c_str(), "w+b");
+  if (!file_)
+  {
+    throw runtime_error(("Error creating temporary file: " + path_).c_str());
+  }
+}
+
+SpillFile::~SpillFile()
+{
+  VSIFCloseL(file_);
+  VSIUnlink(path_.c_str());
+}
+
+string SpillFile::tempPrefix()
+{
+  const string name = STEM + to_string(CPLGetPID());
+  return CPLFormFilename(tempDirectory().c_str(), name.c_str(), nullptr);
+}
+
+void SpillFile::removeStale()
+{
+  const string dir = tempDirectory();
+  char **names = VSIReadDir(dir.c_str());
+  for (char **name = names; name != nullptr && *name != nullptr; ++name)
+  {
+    const string file = *name;
+    if (file.size() > STEM.size() + 4 && file.compare(0, STEM.size(), STEM) == 0 &&
+      file.compare(file.size() - 4, 4, ".tmp") == 0)
+    {
+      VSIUnlink(CPLFormFilename(dir.c_str(), file.c_str(), nullptr));
+    }
+  }
+  CSLDestroy(names);
+}
+
+uint64_t SpillFile::append(const char* data, size_t size)
+{
+  const uint64_t offset = size_;
+  if (VSIFSeekL(file_, size_, SEEK_SET) != 0 ||
+    VSIFWriteL(data, 1, size, file_) != size)
+  {
+    throw runtime_error(("Error writing temporary file: " + path_).c_str());
+  }
+  size_ += size;
+  return offset;
+}
+
+void SpillFile::read(uint64_t offset, uint64_t size,
+  const function<void(const char*, size_t)>& write)
+{
+  if (VSIFSeekL(file_, offset, SEEK_SET) != 0)
+  {
+    throw runtime_error(("Error reading temporary file: " + path_).c_str());
+  }
+
+  buffer_.resize(BUFFER_SIZE);
+  while (size > 0)
+  {
+    const size_t count = static_cast<size_t>(min<uint64_t>(size, buffer_.size()));
+    if (VSIFReadL(buffer_.data(), 1, count, file_) != count)
+    {
+      throw runtime_error(("Error reading temporary file: " + path_).c_str());
+    }
+    write(buffer_.data(), count);
+    size -= count;
+  }
+}
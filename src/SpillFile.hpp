@@ -0,0 +1,76 @@
+/*
+A temporary file that formatted text is moved out to while a place file is
+built.
+
+The text of every layer would otherwise stay in memory until the file is
+written, which for the largest sources is several GB. Text is appended to the
+end of the file as each layer is formatted and read back by offset when the
+place file is written. The file is opened through the GDAL virtual file
+system, like the gzip output, so offsets past 4 GB work everywhere. It is
+removed when the last piece of text in it is no longer needed.
+
+Files go in the system temporary directory, named for the process that made
+them, and any left there by a run that did not exit cleanly are removed at
+the next start with removeStale.
+
+Revisions:
+2026/10/16 - Initial version.
+
+*/
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "cpl_vsi.h"
+
+namespace PFB
+{
+  class SpillFile
+  {
+  public:
+    /// Create a file named prefix plus a number and ".tmp", with a number not
+    /// in use. Throws runtime_error if it cannot be created.
+    explicit SpillFile(const std::string& prefix);
+
+    /// A prefix for files of this process in the system temporary directory,
+    /// the CPL_TMPDIR, TMPDIR, TEMP or TMP setting, or /tmp.
+    static std::string tempPrefix();
+
+    /// Remove files in the system temporary directory made by any process.
+    /// Files another process still has open stay readable through its
+    /// handle, or are left in place where the system does not allow that.
+    static void removeStale();
+
+    /// Close and remove the file.
+    ~SpillFile();
+
+    SpillFile(const SpillFile&) = delete;
+    SpillFile& operator=(const SpillFile&) = delete;
+
+    /// Append text, returning the offset it starts at. Throws runtime_error
+    /// if it cannot be written.
+    uint64_t append(const char* data, size_t size);
+
+    /// Call write with the size bytes from offset, a buffer at a time.
+    /// Throws runtime_error if they cannot be read.
+    void read(uint64_t offset, uint64_t size,
+      const std::function<void(const char*, size_t)>& write);
+
+    /// Bytes appended so far.
+    uint64_t size() const { return size_; }
+
+    const std::string& path() const { return path_; }
+
+  private:
+    static const size_t BUFFER_SIZE = 1 << 20;
+
+    std::string path_;
+    VSILFILE *file_ = nullptr;
+    uint64_t size_ = 0;
+    std::vector<char> buffer_;
+  };
+}
@@ -0,0 +1,94 @@
+#include "VertexCleanup.hpp"
+
+#include <cmath>
+
+using namespace std;
+using PFB::point;
+using PFB::PointEqual;
+using PFB::VertexCleaner;
+
+namespace
+{
+  // Beyond this many places rounding does nothing visible, and longitudes no
+  // longer scale to exact integers.
+  const int MAX_DECIMALS = 12;
+
+  // Sine of the largest bend between two segments still counted as straight.
+  const double STRAIGHT = 1.0e-9;
+
+  // True if b lies on the straight line through a and c, either along the
+  // way from a to c or at the tip of a spike that doubles back.
+  inline bool redundant(const point& a, const point& b, const point& c)
+  {
+    const double ux = b.longitude - a.longitude;
+    const double uy = b.latitude - a.latitude;
+    const double vx = c.longitude - b.longitude;
+    const double vy = c.latitude - b.latitude;
+    const double cross = ux * vy - uy * vx;
+    return fabs(cross) <= STRAIGHT * sqrt((ux * ux + uy * uy) * (vx * vx + vy * vy));
+  }
+}
+
+VertexCleaner::VertexCleaner(vector<point>& out, int decimals, bool duplicatesOnly) :
+  out_(out), scale_(0.0), duplicatesOnly_(duplicatesOnly)
+{
+  out_.clear();
+  if (decimals >= 0) scale_ = pow(10.0, decimals < MAX_DECIMALS ? decimals : MAX_DECIMALS);
+}
+
+void VertexCleaner::add(double latitude, double longitude)
+{
+  ++added_;
+  if (scale_ > 0.0)
+  {
+    latitude = round(latitude * scale_) / scale_;
+    longitude = round(longitude * scale_) / scale_;
+  }
+  const point pnt(latitude, longitude);
+
+  if (!duplicatesOnly_)
+  {
+    // Removing one vertex can leave the one before it in a straight run too,
+    // but a line is never cut back to just its first vertex.
+    while (out_.size() >= 2 && redundant(out_[out_.size() - 2], out_.back(), pnt) &&
+      (out_.size() > 2 || !PointEqual()(out_.front(), pnt)))
+    {
+      out_.pop_back();
+    }
+  }
+
+  if (!out_.empty() && PointEqual()(out_.back(), pnt)) return;
+  out_.push_back(pnt);
+}
+
+size_t VertexCleaner::finish(bool fixedEnds)
+{
+  // Every vertex was the same point.
+  if (out_.size() == 1 && added_ > 1) out_.push_back(out_.front());
+
+  const size_t n = out_.size();
+  const bool ring = n >= 4 && PointEqual()(out_.front(), out_.back());
+  if (ring && !fixedEnds && !duplicatesOnly_)
+  {
+    // The vertex before the first is the one before the closing vertex.
+    size_t first = 0;
+    while (n - first > 4 && redundant(out_[n - 2], out_[first], out_[first + 1])) ++first;
+    if (first != 0)
+    {
+      out_.erase(out_.begin(), out_.begin() + first);
+      out_.back() = out_.front();
+    }
+  }
+
+  return added_ - out_.size();
+}
+
+size_t PFB::cleanVertices(vector<point>& pts, int decimals, bool fixedEnds)
+{
+  thread_local vector<point> cleaned;
+  VertexCleaner cleaner(cleaned, decimals);
+  for (const point& pnt : pts) cleaner.add(pnt.latitude, pnt.longitude);
+  const size_t removed = cleaner.finish(fixedEnds);
+  pts.swap(cleaned);
+  return removed;
+}
@@ -0,0 +1,52 @@
+/*
+Removes redundant vertices from lines and polygon rings as they are copied.
+
+Digitized data is full of repeated points, zero length segments, and runs of
+vertices along a perfectly straight line, none of which change what is drawn.
+Each vertex is first rounded to the number of decimal places it will be written
+with, then dropped if it is the same as the one before it. A vertex is also
+dropped once the next one shows it is in the middle of a straight run, or at
+the tip of a spike where the line doubles back on itself. Everything is done in
+one pass as the vertices are added, looking back at most two vertices.
+
+Revisions:
+2026/10/16 - Initial version.
+
+*/
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+#include "point.hpp"
+
+namespace PFB
+{
+  class VertexCleaner
+  {
+  public:
+    /// Vertices are appended to out, which is cleared first. They are rounded
+    /// to decimals places, a negative value leaves them as they are. If
+    /// duplicatesOnly is set only repeated vertices are dropped, which keeps
+    /// the junctions between neighboring polygons for ArcTopology.
+    VertexCleaner(std::vector<point>& out, int decimals, bool duplicatesOnly = false);
+
+    /// Add the next vertex.
+    void add(double latitude, double longitude);
+
+    /// Done adding vertices. The first vertex of a ring is checked as well
+    /// unless fixedEnds is set. A line is never left with fewer than 2
+    /// vertices. Returns the number of vertices removed.
+    size_t finish(bool fixedEnds = false);
+
+  private:
+    std::vector<point>& out_;
+    double scale_;  // 10^decimals, zero if not rounding
+    bool duplicatesOnly_;
+    size_t added_ = 0;
+  };
+
+  /// Clean up a line or ring already in memory, see VertexCleaner. Returns the
+  /// number of vertices removed.
+  size_t cleanVertices(std::vector<point>& pts, int decimals, bool fixedEnds = false);
+}
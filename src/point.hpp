@@ -5,12 +5,26 @@ Author: Ryan Leach
 
 Revisions:
 2015/10/15 - Initial version. RNL
+2026/10/16 - Added hashing for unordered containers.
+2026/10/16 - Added bounding boxes.
+2026/10/16 - Added constants for distances on the earth.
 
 */
 #pragma once
 
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
 namespace PFB
 {
+  const double PI = 3.14159265358979323846;
+
+  /// The earth as a sphere. In miles the same as OGR_RangeRing, in meters
+  /// the mean radius.
+  const double EARTH_RADIUS_MILES = 3959.0;
+  const double EARTH_RADIUS_METERS = 6371008.8;
+
   class point
   {
   public:
@@ -27,4 +41,65 @@ namespace PFB
 
     point(double lat, double lon) :latitude{ lat }, longitude{ lon } {}
   };
+
+  /// A latitude-longitude bounding box. The default box is empty, extending
+  /// it by a point makes it just that point.
+  struct Bounds
+  {
+    double south = 90.0, west = 180.0, north = -90.0, east = -180.0;
+
+    bool isEmpty() const { return south > north; }
+
+    void extend(const point& pnt)
+    {
+      if (pnt.latitude < south) south = pnt.latitude;
+      if (pnt.latitude > north) north = pnt.latitude;
+      if (pnt.longitude < west) west = pnt.longitude;
+      if (pnt.longitude > east) east = pnt.longitude;
+    }
+
+    void extend(const Bounds& other)
+    {
+      if (other.south < south) south = other.south;
+      if (other.north > north) north = other.north;
+      if (other.west < west) west = other.west;
+      if (other.east > east) east = other.east;
+    }
+
+    bool intersects(const Bounds& other) const
+    {
+      return south <= other.north && north >= other.south && 
+        west <= other.east && east >= other.west;
+    }
+  };
+
+  /// Hash and exact equality of points for unordered containers, used to find
+  /// vertices shared by features.
+  struct PointHash
+  {
+    size_t operator()(const point& pnt) const
+    {
+      uint64_t h = bits_(pnt.latitude) * 0x9E3779B97F4A7C15ULL ^ bits_(pnt.longitude);
+      h *= 0xC2B2AE3D27D4EB4FULL;
+      return static_cast<size_t>(h ^ (h >> 29));
+    }
+
+  private:
+    // Adding zero turns -0.0 into 0.0 so they hash the same.
+    static uint64_t bits_(double val)
+    {
+      val += 0.0;
+      uint64_t out;
+      std::memcpy(&out, &val, sizeof(out));
+      return out;
+    }
+  };
+
+  struct PointEqual
+  {
+    bool operator()(const point& lhs, const point& rhs) const
+    {
+      return lhs.latitude == rhs.latitude && lhs.longitude == rhs.longitude;
+    }
+  };
 }
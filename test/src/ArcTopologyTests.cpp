@@ -0,0 +1,163 @@
+#include "catch.hpp"
+
+#include <algorithm>
+#include <vector>
+
+#include "../../src/ArcTopology.hpp"
+#include "TestGeometry.hpp"
+
+using namespace std;
+using PFB::ArcTopology;
+using PFB::point;
+using PFBTest::same;
+using PFBTest::samePath;
+
+namespace
+{
+  // Closed rings with the same vertices in the same order, from any start.
+  bool sameRing(const vector<point>& lhs, const vector<point>& rhs)
+  {
+    if (lhs.size() != rhs.size() || lhs.size() < 4) return false;
+    if (!same(lhs.front(), lhs.back()) || !same(rhs.front(), rhs.back())) return false;
+
+    const size_t n = lhs.size() - 1;
+    for (size_t shift = 0; shift != n; ++shift)
+    {
+      size_t i = 0;
+      while (i != n && same(lhs[i], rhs[(i + shift) % n])) ++i;
+      if (i == n) return true;
+    }
+    return false;
+  }
+
+  vector<point> ring(const vector<point>& corners)
+  {
+    vector<point> pts = corners;
+    pts.push_back(corners.front());
+    return pts;
+  }
+
+  // Arcs used by more than one path.
+  size_t sharedArcs(const ArcTopology& topology)
+  {
+    size_t shared = 0;
+    for (size_t i = 0; i != topology.arcs().size(); ++i)
+    {
+      if (topology.arcUses(i) > 1) ++shared;
+    }
+    return shared;
+  }
+}
+
+TEST_CASE("Neighboring polygons share the arc between them", "[ArcTopology]")
+{
+  // Two squares side by side, the shared side has a vertex in the middle.
+  const vector<vector<point>> paths{
+    ring({ point(0, 0), point(0, 1), point(0.5, 1), point(1, 1), point(1, 0) }),
+    ring({ point(0, 1), point(0, 2), point(1, 2), point(1, 1), point(0.5, 1) }) };
+  const ArcTopology topology(paths);
+
+  REQUIRE(topology.arcs().size() == 3);
+  CHECK(sharedArcs(topology) == 1);
+  CHECK(topology.pathArcs(0).size() == 2);
+  CHECK(topology.pathArcs(1).size() == 2);
+
+  for (size_t i = 0; i != topology.arcs().size(); ++i)
+  {
+    if (topology.arcUses(i) > 1)
+    {
+      CHECK(topology.arcOwner(i) == 0);
+      CHECK(samePath(topology.arcs()[i], { point(0, 1), point(0.5, 1), point(1, 1) }));
+    }
+  }
+
+  SECTION("The paths are rebuilt as they were")
+  {
+    CHECK(sameRing(topology.buildPath(0), paths[0]));
+    CHECK(sameRing(topology.buildPath(1), paths[1]));
+  }
+
+  SECTION("Changing a shared arc changes both paths the same way")
+  {
+    ArcTopology changed(paths);
+    for (size_t i = 0; i != changed.arcs().size(); ++i)
+    {
+      vector<point>& arc = changed.arcs()[i];
+      if (changed.arcUses(i) > 1) arc.erase(arc.begin() + 1);
+    }
+
+    const vector<point> first = changed.buildPath(0);
+    const vector<point> second = changed.buildPath(1);
+    CHECK(first.size() == paths[0].size() - 1);
+    CHECK(second.size() == paths[1].size() - 1);
+    auto hasMiddle = [](const vector<point>& pts)
+    {
+      return any_of(pts.begin(), pts.end(),
+        [](const point& pnt) { return same(pnt, point(0.5, 1)); });
+    };
+    CHECK_FALSE(hasMiddle(first));
+    CHECK_FALSE(hasMiddle(second));
+  }
+}
+
+TEST_CASE("An island and the hole it fills share one arc", "[ArcTopology]")
+{
+  const vector<point> island = ring({ point(1, 1), point(1, 2), point(2, 2), point(2, 1) });
+  vector<point> hole = island;
+  reverse(hole.begin(), hole.end());
+
+  // The hole starts from a different vertex too.
+  rotate(hole.begin(), hole.begin() + 2, hole.end() - 1);
+  hole.back() = hole.front();
+
+  const vector<vector<point>> paths{
+    ring({ point(0, 0), point(0, 3), point(3, 3), point(3, 0) }), hole, island };
+  const ArcTopology topology(paths);
+
+  REQUIRE(topology.arcs().size() == 2);
+  REQUIRE(topology.pathArcs(1).size() == 1);
+  REQUIRE(topology.pathArcs(2).size() == 1);
+  const ArcTopology::ArcRef holeArc = topology.pathArcs(1)[0];
+  const ArcTopology::ArcRef islandArc = topology.pathArcs(2)[0];
+  CHECK((holeArc == islandArc || holeArc == ~islandArc));
+  CHECK(topology.arcUses(holeArc >= 0 ? holeArc : ~holeArc) == 2);
+  CHECK(topology.arcOwner(holeArc >= 0 ? holeArc : ~holeArc) == 1);
+
+  for (size_t i = 0; i != paths.size(); ++i)
+  {
+    CHECK(sameRing(topology.buildPath(i), paths[i]));
+  }
+}
+
+TEST_CASE("Lines are cut where they meet", "[ArcTopology]")
+{
+  // Two lines that run together through the middle, in opposite directions.
+  const vector<vector<point>> paths{
+    { point(0, 0), point(1, 1), point(1, 2), point(1, 3), point(0, 4) },
+    { point(2, 4), point(1, 3), point(1, 2), point(1, 1), point(2, 0) } };
+  const ArcTopology topology(paths);
+
+  CHECK(topology.arcs().size() == 5);
+  CHECK(sharedArcs(topology) == 1);
+  CHECK(topology.pathArcs(0).size() == 3);
+  CHECK(topology.pathArcs(1).size() == 3);
+
+  // The shared middle is used forward by one and backward by the other.
+  CHECK(topology.pathArcs(0)[1] == ~topology.pathArcs(1)[1]);
+
+  CHECK(samePath(topology.buildPath(0), paths[0]));
+  CHECK(samePath(topology.buildPath(1), paths[1]));
+}
+
+TEST_CASE("Paths that share nothing keep one arc each", "[ArcTopology]")
+{
+  const vector<vector<point>> paths{
+    { point(0, 0), point(0, 1), point(0, 2) },
+    ring({ point(5, 5), point(5, 6), point(6, 6), point(6, 5) }) };
+  const ArcTopology topology(paths);
+
+  CHECK(topology.arcs().size() == 2);
+  CHECK(sharedArcs(topology) == 0);
+  CHECK(samePath(topology.buildPath(0), paths[0]));
+  CHECK(sameRing(topology.buildPath(1), paths[1]));
+}
@@ -0,0 +1,191 @@
+#include "catch.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <vector>
+
+#include "../../src/ClipRegion.hpp"
+#include "TestGeometry.hpp"
+
+using namespace std;
+using PFB::ClipRegion;
+using PFB::PI;
+using PFB::point;
+using PFBTest::same;
+using PFBTest::samePath;
+
+namespace
+{
+  bool onEdge(const ClipRegion& region, const point& pnt)
+  {
+    return region.contains(pnt) && (pnt.latitude == region.south() ||
+      pnt.latitude == region.north() || pnt.longitude == region.west() ||
+      pnt.longitude == region.east());
+  }
+
+  // Inside the region, allowing for rounding where a segment was cut.
+  bool nearlyContains(const ClipRegion& region, const point& pnt)
+  {
+    const double eps = 1.0e-9;
+    return pnt.latitude >= region.south() - eps && pnt.latitude <= region.north() + eps &&
+      pnt.longitude >= region.west() - eps && pnt.longitude <= region.east() + eps;
+  }
+
+  // Twice the signed area of a ring, in square degrees.
+  double ringArea2(const vector<point>& ring)
+  {
+    double sum = 0.0;
+    for (size_t i = 1; i < ring.size(); ++i)
+    {
+      sum += ring[i - 1].longitude * ring[i].latitude - ring[i].longitude * ring[i - 1].latitude;
+    }
+    return sum;
+  }
+}
+
+TEST_CASE("ClipRegion boxes", "[ClipRegion]")
+{
+  CHECK_FALSE(ClipRegion().isSet());
+
+  const ClipRegion region(36.0, -96.0, 35.0, -98.0);
+  REQUIRE(region.isSet());
+  CHECK(region.south() == 35.0);
+  CHECK(region.north() == 36.0);
+  CHECK(region.west() == -98.0);
+  CHECK(region.east() == -96.0);
+
+  CHECK(region.contains(point(35.5, -97.0)));
+  CHECK(region.contains(point(35.0, -98.0)));
+  CHECK_FALSE(region.contains(point(36.1, -97.0)));
+  CHECK_FALSE(region.contains(point(35.5, -95.9)));
+
+  CHECK(region.intersects(35.5, -99.0, 37.0, -97.0));
+  CHECK(region.intersects(34.0, -99.0, 37.0, -95.0));
+  CHECK(region.intersects(36.0, -96.0, 37.0, -95.0));
+  CHECK_FALSE(region.intersects(36.1, -97.0, 37.0, -96.5));
+  CHECK_FALSE(region.intersects(35.0, -100.0, 36.0, -98.1));
+}
+
+TEST_CASE("ClipRegion around a point holds the circle", "[ClipRegion]")
+{
+  const point center(35.3331, -97.2778);
+  const double radiusMiles = 230.0;
+  const ClipRegion region = ClipRegion::around(center, radiusMiles);
+  const double delta = radiusMiles / PFB::EARTH_RADIUS_MILES;
+  const double lat1 = center.latitude * PI / 180.0;
+
+  CHECK(region.north() - center.latitude == Approx(delta * 180.0 / PI));
+  CHECK(center.latitude - region.south() == Approx(delta * 180.0 / PI));
+  CHECK(region.east() - center.longitude == Approx(center.longitude - region.west()));
+
+  // Points on the circle by the destination formula, just inside the box.
+  for (int bearing = 0; bearing < 360; bearing += 5)
+  {
+    const double theta = bearing * PI / 180.0;
+    const double lat2 = asin(sin(lat1) * cos(delta) + cos(lat1) * sin(delta) * cos(theta));
+    const double dLon = atan2(sin(theta) * sin(delta) * cos(lat1),
+      cos(delta) - sin(lat1) * sin(lat2));
+    INFO("bearing " << bearing);
+    CHECK(nearlyContains(region, point(lat2 * 180.0 / PI, center.longitude + dLon * 180.0 / PI)));
+  }
+
+  SECTION("All the way around near a pole")
+  {
+    const ClipRegion polar = ClipRegion::around(point(89.0, 0.0), 200.0);
+    CHECK(polar.west() == -180.0);
+    CHECK(polar.east() == 180.0);
+  }
+}
+
+TEST_CASE("clipLine cuts lines at the edge", "[ClipRegion]")
+{
+  const ClipRegion region(35.0, -98.0, 36.0, -96.0);
+
+  SECTION("A line inside is unchanged")
+  {
+    const vector<point> line{ point(35.2, -97.8), point(35.5, -97.0), point(35.8, -96.2) };
+    const vector<vector<point>> pieces = region.clipLine(line);
+    REQUIRE(pieces.size() == 1);
+    CHECK(samePath(pieces[0], line));
+  }
+
+  SECTION("A line outside is removed")
+  {
+    CHECK(region.clipLine({ point(34.0, -99.0), point(34.5, -95.0) }).empty());
+    CHECK(region.clipLine({ point(37.0, -99.0), point(37.0, -95.0), point(34.0, -95.0) }).empty());
+  }
+
+  SECTION("A line across is cut at both sides")
+  {
+    const vector<vector<point>> pieces =
+      region.clipLine({ point(35.5, -99.0), point(35.5, -97.0), point(35.5, -95.0) });
+    REQUIRE(pieces.size() == 1);
+    CHECK(samePath(pieces[0], { point(35.5, -98.0), point(35.5, -97.0), point(35.5, -96.0) }));
+  }
+
+  SECTION("A line that leaves and comes back is two pieces")
+  {
+    const vector<vector<point>> pieces = region.clipLine({ point(35.2, -97.5),
+      point(37.2, -97.5), point(37.2, -96.5), point(35.2, -96.5) });
+    REQUIRE(pieces.size() == 2);
+    CHECK(samePath(pieces[0], { point(35.2, -97.5), point(36.0, -97.5) }));
+    CHECK(samePath(pieces[1], { point(36.0, -96.5), point(35.2, -96.5) }));
+  }
+
+  SECTION("Random lines stay in the box and end on its edge")
+  {
+    mt19937 gen(1016);
+    uniform_real_distribution<double> lat(34.0, 37.0);
+    uniform_real_distribution<double> lon(-99.0, -95.0);
+    for (int i = 0; i < 500; ++i)
+    {
+      vector<point> line;
+      for (int j = 0; j < 20; ++j) line.push_back(point(lat(gen), lon(gen)));
+      for (const vector<point>& piece : region.clipLine(line))
+      {
+        REQUIRE(piece.size() >= 2);
+        for (const point& pnt : piece) CHECK(nearlyContains(region, pnt));
+        if (!region.contains(line.front())) CHECK(onEdge(region, piece.front()));
+      }
+    }
+  }
+}
+
+TEST_CASE("clipRing cuts polygons to the box", "[ClipRegion]")
+{
+  const ClipRegion region(35.0, -98.0, 36.0, -96.0);
+
+  SECTION("A ring inside is unchanged")
+  {
+    const vector<point> ring{ point(35.2, -97.8), point(35.8, -97.8), point(35.8, -96.2),
+      point(35.2, -97.8) };
+    CHECK(samePath(region.clipRing(ring), ring));
+  }
+
+  SECTION("A ring outside is removed")
+  {
+    CHECK(region.clipRing({ point(37.0, -99.0), point(38.0, -99.0), point(38.0, -97.0),
+      point(37.0, -99.0) }).empty());
+  }
+
+  SECTION("A ring around the box becomes the box")
+  {
+    const vector<point> clipped = region.clipRing({ point(34.0, -99.0), point(37.0, -99.0),
+      point(37.0, -95.0), point(34.0, -95.0), point(34.0, -99.0) });
+    REQUIRE(clipped.size() == 5);
+    CHECK(same(clipped.front(), clipped.back()));
+    for (const point& pnt : clipped) CHECK(onEdge(region, pnt));
+    CHECK(fabs(ringArea2(clipped)) == Approx(4.0));
+  }
+
+  SECTION("A ring over one side is cut along it")
+  {
+    const vector<point> clipped = region.clipRing({ point(35.5, -97.0), point(37.0, -97.0),
+      point(37.0, -96.5), point(35.5, -96.5), point(35.5, -97.0) });
+    REQUIRE(clipped.size() == 5);
+    CHECK(same(clipped.front(), clipped.back()));
+    for (const point& pnt : clipped) CHECK(region.contains(pnt));
+    CHECK(fabs(ringArea2(clipped)) == Approx(0.5));
+  }
+}
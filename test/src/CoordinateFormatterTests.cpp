@@ -0,0 +1,223 @@
+#include "catch.hpp"
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <limits>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "../../src/CoordinateFormatter.hpp"
+
+using namespace std;
+using PFB::CoordinateFormatter;
+using PFB::point;
+
+namespace
+{
+  string format(const CoordinateFormatter& fmt, double val)
+  {
+    char buf[CoordinateFormatter::MAX_VALUE_CHARS];
+    return string(buf, fmt.formatValue(val, buf));
+  }
+
+  string printfFormat(double val, int precision)
+  {
+    char buf[CoordinateFormatter::MAX_VALUE_CHARS];
+    snprintf(buf, sizeof(buf), "%.*f", precision, val);
+    return buf;
+  }
+
+  // printf output with the trailing zeros removed, and no sign on zero.
+  string shortestFormat(double val, int precision)
+  {
+    string text = printfFormat(val, precision);
+    if (text.find('.') != string::npos)
+    {
+      text.erase(text.find_last_not_of('0') + 1);
+      if (text.back() == '.') text.pop_back();
+    }
+    if (text == "-0") text = "0";
+    return text;
+  }
+
+  // Check every precision in both forms.
+  void checkValue(double val)
+  {
+    for (int precision = 0; precision <= CoordinateFormatter::MAX_PRECISION; ++precision)
+    {
+      INFO("value " << printfFormat(val, 20) << " precision " << precision);
+      CHECK(format(CoordinateFormatter(precision, false), val) ==
+        printfFormat(val, precision));
+      CHECK(format(CoordinateFormatter(precision, true), val) ==
+        shortestFormat(val, precision));
+    }
+  }
+}
+
+TEST_CASE("formatValue matches printf for coordinates", "[CoordinateFormatter]")
+{
+  mt19937_64 gen(20261016);
+  uniform_real_distribution<double> lat(-90.0, 90.0);
+  uniform_real_distribution<double> lon(-180.0, 180.0);
+  for (int i = 0; i < 2000; ++i)
+  {
+    checkValue(lat(gen));
+    checkValue(lon(gen));
+  }
+
+  for (double val : { 0.0, 1.0, -1.0, 0.1, -0.1, 35.0, -97.5, 179.9999999999, 1.0e-12 })
+  {
+    checkValue(val);
+  }
+}
+
+TEST_CASE("formatValue matches printf near rounding ties", "[CoordinateFormatter]")
+{
+  SECTION("Ties that are exact in binary")
+  {
+    for (double val : { 0.5, 1.5, 2.5, -0.5, -2.5, 0.125, 0.375, -0.625, 35.25, -97.75 })
+    {
+      checkValue(val);
+    }
+  }
+
+  SECTION("Ties written in decimal, and the doubles either side")
+  {
+    mt19937_64 gen(1016);
+    uniform_int_distribution<int> whole(-180, 180);
+    for (int precision = 0; precision <= 10; ++precision)
+    {
+      const double step = pow(10.0, -precision);
+      for (int i = 0; i < 200; ++i)
+      {
+        const double tie = whole(gen) + (i % 97 + 0.5) * step;
+        checkValue(tie);
+        checkValue(nextafter(tie, numeric_limits<double>::infinity()));
+        checkValue(nextafter(tie, -numeric_limits<double>::infinity()));
+      }
+    }
+  }
+
+  SECTION("Well known cases")
+  {
+    CHECK(format(CoordinateFormatter(2), 2.675) == "2.67");
+    CHECK(format(CoordinateFormatter(2), 1.005) == "1.00");
+    CHECK(format(CoordinateFormatter(1), 0.25) == "0.2");
+    CHECK(format(CoordinateFormatter(10), 1.00000000005) == printfFormat(1.00000000005, 10));
+  }
+}
+
+TEST_CASE("formatValue keeps the sign of negative zero like printf", "[CoordinateFormatter]")
+{
+  CHECK(format(CoordinateFormatter(10), -0.0) == "-0.0000000000");
+  CHECK(format(CoordinateFormatter(0), -0.0) == "-0");
+  CHECK(format(CoordinateFormatter(4), -0.00001) == "-0.0000");
+  checkValue(-0.0);
+  checkValue(-1.0e-11);
+  checkValue(-4.9e-5);
+
+  SECTION("But not in shortest form")
+  {
+    CHECK(format(CoordinateFormatter(10, true), -0.0) == "0");
+    CHECK(format(CoordinateFormatter(4, true), -0.00001) == "0");
+  }
+}
+
+TEST_CASE("formatValue matches printf for values too large to scale", "[CoordinateFormatter]")
+{
+  for (double val : { 4503599627.370496, 4.5035996273705e15, 1.0e16, 1.0e20, -1.0e20,
+    123456789012345678.0, 1.0e300, -1.0e300, numeric_limits<double>::max(),
+    -numeric_limits<double>::max() })
+  {
+    checkValue(val);
+  }
+
+  SECTION("The fallback fits in MAX_VALUE_CHARS")
+  {
+    const string text = format(CoordinateFormatter(CoordinateFormatter::MAX_PRECISION),
+      -numeric_limits<double>::max());
+    CHECK(text.size() <= CoordinateFormatter::MAX_VALUE_CHARS);
+  }
+}
+
+TEST_CASE("appendPoints leaves out repeated vertices in shortest form", "[CoordinateFormatter]")
+{
+  const vector<point> pnts{ point(35.12341, -97.12341), point(35.12342, -97.12344),
+    point(35.5, -97.5) };
+
+  CoordinateFormatter fmt(4, true);
+  string out;
+  fmt.appendPoints(pnts, out);
+  CHECK(out == "  35.1234,-97.1234\n  35.5,-97.5\n");
+  CHECK(fmt.getPointsDropped() == 1);
+
+  SECTION("Unless it is the last point and keepLast is set")
+  {
+    CoordinateFormatter keep(4, true);
+    string kept;
+    keep.appendPoints(pnts.data(), 2, kept, nullptr, true);
+    CHECK(kept == "  35.1234,-97.1234\n  35.1234,-97.1234\n");
+  }
+
+  SECTION("Full precision writes every vertex")
+  {
+    CoordinateFormatter full(10);
+    string all;
+    full.appendPoints(pnts, all);
+    CHECK(all == "  35.1234100000,-97.1234100000\n  35.1234200000,-97.1234400000\n"
+      "  35.5000000000,-97.5000000000\n");
+    CHECK(full.getPointsDropped() == 0);
+  }
+}
+
+/*
+ * Hidden, run with the [benchmark] tag. Times formatting a million vertices
+ * with the formatter and with an ostream set up the way the PlaceFile was
+ * written before.
+ */
+TEST_CASE("Benchmark formatting coordinates", "[.][benchmark]")
+{
+  const size_t NUM_POINTS = 1000000;
+  mt19937_64 gen(42);
+  uniform_real_distribution<double> lat(25.0, 50.0);
+  uniform_real_distribution<double> lon(-125.0, -65.0);
+  vector<point> pnts;
+  pnts.reserve(NUM_POINTS);
+  for (size_t i = 0; i != NUM_POINTS; ++i) pnts.push_back(point(lat(gen), lon(gen)));
+
+  using Clock = chrono::steady_clock;
+  auto millis = [](Clock::time_point start)
+  {
+    return chrono::duration<double, milli>(Clock::now() - start).count();
+  };
+
+  Clock::time_point start = Clock::now();
+  ostringstream ost;
+  ost.precision(10);
+  ost << fixed;
+  for (const point& pnt : pnts) ost << "  " << pnt.latitude << "," << pnt.longitude << "\n";
+  const string streamed = ost.str();
+  const double streamMs = millis(start);
+
+  start = Clock::now();
+  CoordinateFormatter fmt(10);
+  string formatted;
+  formatted.reserve(streamed.size());
+  fmt.appendPoints(pnts, formatted);
+  const double fullMs = millis(start);
+
+  start = Clock::now();
+  CoordinateFormatter shortest(5, true);
+  string shortened;
+  shortest.appendPoints(pnts, shortened);
+  const double shortestMs = millis(start);
+
+  WARN("ostream, 10 places: " << streamMs << " ms");
+  WARN("CoordinateFormatter, 10 places: " << fullMs << " ms");
+  WARN("CoordinateFormatter, 5 places shortest form: " << shortestMs << " ms, " <<
+    shortened.size() << " of " << formatted.size() << " bytes");
+  CHECK(formatted == streamed);
+}
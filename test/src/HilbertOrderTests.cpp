@@ -0,0 +1,130 @@
+#include "catch.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+#include "../../src/HilbertOrder.hpp"
+
+using namespace std;
+using PFB::Bounds;
+using PFB::hilbertIndex;
+using PFB::hilbertOrder;
+using PFB::point;
+
+namespace
+{
+  Bounds pointBox(double latitude, double longitude)
+  {
+    Bounds bounds;
+    bounds.extend(point(latitude, longitude));
+    return bounds;
+  }
+
+  // Total distance in degrees from each box center to the next in order.
+  double pathLength(const vector<Bounds>& bounds, const vector<size_t>& order)
+  {
+    double length = 0.0;
+    for (size_t i = 1; i < order.size(); ++i)
+    {
+      const Bounds& a = bounds[order[i - 1]];
+      const Bounds& b = bounds[order[i]];
+      length += hypot((a.south + a.north - b.south - b.north) / 2.0,
+        (a.west + a.east - b.west - b.east) / 2.0);
+    }
+    return length;
+  }
+
+  bool isPermutation(vector<size_t> order, size_t size)
+  {
+    sort(order.begin(), order.end());
+    for (size_t i = 0; i != order.size(); ++i)
+    {
+      if (order[i] != i) return false;
+    }
+    return order.size() == size;
+  }
+}
+
+TEST_CASE("hilbertIndex visits neighboring cells in turn", "[HilbertOrder]")
+{
+  CHECK(hilbertIndex(0, 0) == 0);
+
+  // The curve fills the corner of the grid before leaving it, one cell
+  // after another.
+  const uint32_t SIDE = 64;
+  vector<pair<uint32_t, uint32_t>> cells(SIDE * SIDE, make_pair(SIDE, SIDE));
+  for (uint32_t x = 0; x != SIDE; ++x)
+  {
+    for (uint32_t y = 0; y != SIDE; ++y)
+    {
+      const uint32_t d = hilbertIndex(x, y);
+      REQUIRE(d < SIDE * SIDE);
+      REQUIRE(cells[d].first == SIDE);
+      cells[d] = make_pair(x, y);
+    }
+  }
+  for (size_t d = 1; d != cells.size(); ++d)
+  {
+    INFO("index " << d);
+    const int dx = abs(int(cells[d].first) - int(cells[d - 1].first));
+    const int dy = abs(int(cells[d].second) - int(cells[d - 1].second));
+    CHECK(dx + dy == 1);
+  }
+
+  SECTION("The far corner is at the end of the curve")
+  {
+    CHECK(hilbertIndex(65535, 0) == 0xFFFFFFFFu);
+  }
+}
+
+TEST_CASE("hilbertOrder keeps neighbors together", "[HilbertOrder]")
+{
+  // A grid of points in shuffled order.
+  vector<Bounds> bounds;
+  for (int i = 0; i != 100; ++i)
+  {
+    for (int j = 0; j != 100; ++j) bounds.push_back(pointBox(30.0 + 0.1 * i, -100.0 + 0.1 * j));
+  }
+  shuffle(bounds.begin(), bounds.end(), mt19937(1016));
+
+  vector<size_t> original(bounds.size());
+  for (size_t i = 0; i != original.size(); ++i) original[i] = i;
+
+  const vector<size_t> order = hilbertOrder(bounds);
+  REQUIRE(isPermutation(order, bounds.size()));
+
+  // A path through every point is at least 0.1 degree per step, the curve
+  // sometimes takes a longer step between cells of the grid.
+  const double shortest = 0.1 * (bounds.size() - 1);
+  CHECK(pathLength(bounds, order) < 1.5 * shortest);
+  CHECK(pathLength(bounds, original) > 10.0 * shortest);
+}
+
+TEST_CASE("hilbertOrder puts empty boxes last and keeps ties in order", "[HilbertOrder]")
+{
+  const vector<Bounds> bounds{ Bounds(), pointBox(35.0, -97.0), pointBox(36.0, -96.0),
+    Bounds(), pointBox(35.0, -97.0) };
+  const vector<size_t> order = hilbertOrder(bounds);
+  REQUIRE(isPermutation(order, bounds.size()));
+  CHECK(order[3] == 0);
+  CHECK(order[4] == 3);
+  const size_t first = find(order.begin(), order.end(), 1) - order.begin();
+  const size_t second = find(order.begin(), order.end(), 4) - order.begin();
+  CHECK(first < second);
+
+  SECTION("All in one place keeps the original order")
+  {
+    const vector<Bounds> same(10, pointBox(35.0, -97.0));
+    const vector<size_t> sameOrder = hilbertOrder(same);
+    for (size_t i = 0; i != sameOrder.size(); ++i) CHECK(sameOrder[i] == i);
+  }
+
+  SECTION("Nothing to order")
+  {
+    CHECK(hilbertOrder(vector<Bounds>()).empty());
+    CHECK(hilbertOrder(vector<Bounds>(3)) == (vector<size_t>{ 0, 1, 2 }));
+  }
+}
@@ -0,0 +1,149 @@
+#include "catch.hpp"
+
+#include <set>
+#include <string>
+#include <vector>
+
+#include "cpl_conv.h"
+#include "cpl_string.h"
+#include "cpl_vsi.h"
+#include "ogrsf_frmts.h"
+
+#include "../../src/ClipRegion.hpp"
+#include "../../src/LayerReader.hpp"
+#include "../../src/OGRDataSourceWrapper.hpp"
+
+using namespace std;
+using OGRWrapper::OGRDataSourceWrapper;
+using PFB::ClipRegion;
+using PFB::LayerReader;
+
+namespace
+{
+  const GIntBig NUM_RECORDS = 100000;
+
+  // Deleted records around where the layer is split for 4 workers, a run
+  // spanning one split, and a scattering through the rest.
+  bool isDeleted(GIntBig fid)
+  {
+    return (fid >= 24990 && fid < 25010) || (fid >= 49000 && fid < 51000) ||
+      fid == 75000 || fid % 13 == 0;
+  }
+
+  // A point shapefile with NUM_RECORDS records, the deleted ones still in
+  // the file. Removed with its directory when done.
+  struct DeletedRecordsShapefile
+  {
+    string dir;
+    string path;
+
+    DeletedRecordsShapefile()
+    {
+      OGRRegisterAll();
+      dir = CPLGenerateTempFilename("LayerReaderTests");
+      VSIMkdir(dir.c_str(), 0755);
+      path = CPLFormFilename(dir.c_str(), "points", "shp");
+
+      GDALDriver *driver = GetGDALDriverManager()->GetDriverByName("ESRI Shapefile");
+      REQUIRE(driver != nullptr);
+      {
+        OGRDataSourceWrapper created(driver->Create(path.c_str(), 0, 0, 0, GDT_Unknown,
+          nullptr));
+        REQUIRE(created);
+        OGRSpatialReference wgs84;
+        wgs84.SetWellKnownGeogCS("WGS84");
+        OGRLayer *layer = created->CreateLayer("points", &wgs84, wkbPoint, nullptr);
+        REQUIRE(layer != nullptr);
+        OGRFieldDefn field("id", OFTInteger);
+        REQUIRE(layer->CreateField(&field) == OGRERR_NONE);
+
+        for (GIntBig i = 0; i != NUM_RECORDS; ++i)
+        {
+          OGRFeature *feature = OGRFeature::CreateFeature(layer->GetLayerDefn());
+          feature->SetField("id", static_cast<int>(i));
+          OGRPoint pnt(-97.0 + i * 1.0e-5, 35.0);
+          feature->SetGeometry(&pnt);
+          const OGRErr err = layer->CreateFeature(feature);
+          OGRFeature::DestroyFeature(feature);
+          REQUIRE(err == OGRERR_NONE);
+        }
+      }
+
+      // Without AUTO_REPACK=NO the deleted records are packed away on close.
+      char **options = CSLSetNameValue(nullptr, "AUTO_REPACK", "NO");
+      OGRDataSourceWrapper update(static_cast<GDALDataset*>(GDALOpenEx(path.c_str(),
+        GDAL_OF_VECTOR | GDAL_OF_UPDATE, nullptr, options, nullptr)));
+      CSLDestroy(options);
+      REQUIRE(update);
+      OGRLayer *layer = update->GetLayer(0);
+      for (GIntBig fid = 0; fid != NUM_RECORDS; ++fid)
+      {
+        if (isDeleted(fid)) REQUIRE(layer->DeleteFeature(fid) == OGRERR_NONE);
+      }
+    }
+
+    ~DeletedRecordsShapefile()
+    {
+      GDALDriver *driver = GetGDALDriverManager()->GetDriverByName("ESRI Shapefile");
+      if (driver != nullptr) driver->Delete(path.c_str());
+      VSIRmdir(dir.c_str());
+    }
+  };
+
+  // The FIDs of every feature read with numThreads workers.
+  vector<GIntBig> readFids(const string& path, unsigned int numThreads)
+  {
+    OGRDataSourceWrapper src(path);
+    vector<GIntBig> fids;
+    {
+      LayerReader reader(ClipRegion(), 0.0);
+      reader.lend(path, &*src);
+      const size_t job = reader.addJob(LayerReader::Job{ path, "points", "points", "" });
+      reader.start(numThreads);
+
+      LayerReader::Batch batch;
+      while (reader.next(job, batch))
+      {
+        for (auto& feature : batch.features) fids.push_back(feature->GetFID());
+      }
+    }
+    return fids;
+  }
+}
+
+TEST_CASE("LayerReader reads a shapefile with deleted records in parts", "[LayerReader]")
+{
+  DeletedRecordsShapefile shapefile;
+
+  vector<GIntBig> expected;
+  for (GIntBig fid = 0; fid != NUM_RECORDS; ++fid)
+  {
+    if (!isDeleted(fid)) expected.push_back(fid);
+  }
+
+  SECTION("The deleted records are still in the file")
+  {
+    OGRDataSourceWrapper src(shapefile.path);
+    OGRLayer *layer = src->GetLayer(0);
+    OGRFeature *deleted = layer->GetFeature(25000);
+    CHECK(deleted == nullptr);
+    OGRFeature::DestroyFeature(deleted);
+    CHECK(layer->TestCapability(OLCFastSetNextByIndex));
+  }
+
+  SECTION("One worker")
+  {
+    CHECK(readFids(shapefile.path, 1) == expected);
+  }
+
+  SECTION("Split between workers, every feature once and in order")
+  {
+    for (unsigned int numThreads : { 2u, 3u, 4u, 7u })
+    {
+      INFO("threads " << numThreads);
+      const vector<GIntBig> fids = readFids(shapefile.path, numThreads);
+      CHECK(set<GIntBig>(fids.begin(), fids.end()).size() == fids.size());
+      CHECK(fids == expected);
+    }
+  }
+}
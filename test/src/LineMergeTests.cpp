@@ -0,0 +1,172 @@
+#include "catch.hpp"
+
+#include <algorithm>
+#include <vector>
+
+#include "../../src/LineMerge.hpp"
+#include "TestGeometry.hpp"
+
+using namespace std;
+using PFB::mergeLines;
+using PFB::point;
+using PFB::splitLine;
+using PFBTest::same;
+using PFBTest::samePath;
+
+namespace
+{
+  // The same line, or the same line reversed.
+  bool sameLine(const vector<point>& lhs, vector<point> rhs)
+  {
+    if (samePath(lhs, rhs)) return true;
+    reverse(rhs.begin(), rhs.end());
+    return samePath(lhs, rhs);
+  }
+
+  // A straight line of numPoints going east from start.
+  vector<point> eastward(const point& start, size_t numPoints)
+  {
+    vector<point> pts;
+    for (size_t i = 0; i != numPoints; ++i)
+    {
+      pts.push_back(point(start.latitude, start.longitude + 0.01 * i));
+    }
+    return pts;
+  }
+
+  // Cut a line into pieces of at most pieceSize points sharing end points.
+  vector<vector<point>> cut(const vector<point>& line, size_t pieceSize)
+  {
+    vector<vector<point>> pieces;
+    for (size_t first = 0; first + 1 < line.size(); first += pieceSize - 1)
+    {
+      const size_t last = min(first + pieceSize, line.size());
+      pieces.emplace_back(line.begin() + first, line.begin() + last);
+    }
+    return pieces;
+  }
+}
+
+TEST_CASE("mergeLines joins segments that meet end to end", "[LineMerge]")
+{
+  const vector<point> road = eastward(point(35.0, -97.0), 50);
+
+  SECTION("In order")
+  {
+    const vector<vector<point>> merged = mergeLines(cut(road, 5));
+    REQUIRE(merged.size() == 1);
+    CHECK(samePath(merged[0], road));
+  }
+
+  SECTION("Out of order, starting from the middle")
+  {
+    vector<vector<point>> pieces = cut(road, 5);
+    rotate(pieces.begin(), pieces.begin() + pieces.size() / 2, pieces.end());
+    const vector<vector<point>> merged = mergeLines(move(pieces));
+    REQUIRE(merged.size() == 1);
+    CHECK(samePath(merged[0], road));
+  }
+
+  SECTION("With some segments reversed")
+  {
+    vector<vector<point>> pieces = cut(road, 5);
+    for (size_t i = 0; i < pieces.size(); i += 3) reverse(pieces[i].begin(), pieces[i].end());
+    reverse(pieces.begin(), pieces.end());
+    const vector<vector<point>> merged = mergeLines(move(pieces));
+    REQUIRE(merged.size() == 1);
+    CHECK(sameLine(merged[0], road));
+  }
+
+  SECTION("A line that is not joined keeps its direction")
+  {
+    vector<point> single = road;
+    reverse(single.begin(), single.end());
+    const vector<vector<point>> merged = mergeLines({ single });
+    REQUIRE(merged.size() == 1);
+    CHECK(samePath(merged[0], single));
+  }
+}
+
+TEST_CASE("mergeLines keeps lines that do not meet apart", "[LineMerge]")
+{
+  const vector<point> north = eastward(point(36.0, -97.0), 20);
+  const vector<point> south = eastward(point(34.0, -97.0), 20);
+
+  vector<vector<point>> pieces = cut(north, 4);
+  for (vector<point>& piece : cut(south, 6)) pieces.push_back(move(piece));
+
+  // Lines too short to write are left out.
+  pieces.push_back({ point(30.0, -90.0) });
+  pieces.push_back({});
+
+  const vector<vector<point>> merged = mergeLines(move(pieces));
+  REQUIRE(merged.size() == 2);
+  const bool northFirst = same(merged[0].front(), north.front());
+  CHECK(samePath(merged[northFirst ? 0 : 1], north));
+  CHECK(samePath(merged[northFirst ? 1 : 0], south));
+}
+
+TEST_CASE("mergeLines uses every segment once where more than two meet", "[LineMerge]")
+{
+  // Three roads from one intersection.
+  const point center(35.0, -97.0);
+  const vector<vector<point>> roads{
+    { center, point(35.0, -96.9), point(35.0, -96.8) },
+    { center, point(35.1, -97.0), point(35.2, -97.0) },
+    { center, point(34.9, -97.0), point(34.8, -97.0) } };
+
+  const vector<vector<point>> merged = mergeLines(vector<vector<point>>(roads));
+  REQUIRE(merged.size() == 2);
+  CHECK(merged[0].size() + merged[1].size() == 8);
+  for (const vector<point>& road : roads)
+  {
+    const bool found = any_of(merged.begin(), merged.end(), [&](const vector<point>& line)
+    {
+      return any_of(line.begin(), line.end(), [&](const point& pnt)
+      {
+        return same(pnt, road.back());
+      });
+    });
+    CHECK(found);
+  }
+}
+
+TEST_CASE("splitLine makes even pieces sharing end points", "[LineMerge]")
+{
+  const vector<point> line = eastward(point(35.0, -97.0), 1001);
+
+  for (size_t maxPoints : { 2u, 3u, 10u, 100u, 999u, 1000u })
+  {
+    INFO("maxPoints " << maxPoints);
+    const vector<vector<point>> pieces = splitLine(vector<point>(line), maxPoints);
+
+    REQUIRE(pieces.size() >= 2);
+    const size_t segments = line.size() - 1;
+    CHECK(pieces.size() == (segments + maxPoints - 2) / (maxPoints - 1));
+
+    size_t smallest = line.size();
+    size_t largest = 0;
+    vector<point> joined{ pieces.front().front() };
+    for (size_t i = 0; i != pieces.size(); ++i)
+    {
+      CHECK(pieces[i].size() <= maxPoints);
+      CHECK(pieces[i].size() >= 2);
+      smallest = min(smallest, pieces[i].size());
+      largest = max(largest, pieces[i].size());
+      if (i != 0) CHECK(same(pieces[i].front(), pieces[i - 1].back()));
+      joined.insert(joined.end(), pieces[i].begin() + 1, pieces[i].end());
+    }
+    CHECK(largest - smallest <= 1);
+    CHECK(samePath(joined, line));
+  }
+
+  SECTION("A line that fits is returned whole")
+  {
+    for (size_t maxPoints : { 0u, 1u, 1001u, 5000u })
+    {
+      const vector<vector<point>> pieces = splitLine(vector<point>(line), maxPoints);
+      REQUIRE(pieces.size() == 1);
+      CHECK(samePath(pieces[0], line));
+    }
+  }
+}
@@ -0,0 +1,531 @@
+#include "catch.hpp"
+
+#include <memory>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+#include <sys/utime.h>
+#else
+#include <utime.h>
+#endif
+
+#include "cpl_vsi.h"
+#include "ogrsf_frmts.h"
+
+#include "../../src/ClipRegion.hpp"
+#include "../../src/LineFeature.hpp"
+#include "../../src/PlaceFile.hpp"
+#include "../../src/PointFeature.hpp"
+#include "TestFiles.hpp"
+#include "TestGeometry.hpp"
+
+using namespace std;
+using PFB::ClipRegion;
+using PFB::CoordinateFormatter;
+using PFB::GeometryOptions;
+using PFB::LineFeature;
+using PFB::PlaceFile;
+using PFB::PlaceFileColor;
+using PFB::point;
+using PFB::PointFeature;
+using PFBTest::readFile;
+using PFBTest::samePath;
+using PFBTest::TempDir;
+using PFBTest::writeFile;
+
+namespace
+{
+  // The vertices of each Line: in the text of a place file.
+  vector<vector<point>> linesIn(const string& text)
+  {
+    vector<vector<point>> lines;
+    istringstream in(text);
+    string row;
+    bool inLine = false;
+    while (getline(in, row))
+    {
+      if (row.compare(0, 5, "Line:") == 0)
+      {
+        lines.emplace_back();
+        inLine = true;
+      }
+      else if (row.compare(0, 4, "End:") == 0) inLine = false;
+      else if (inLine)
+      {
+        istringstream coords(row);
+        double latitude = 0.0;
+        double longitude = 0.0;
+        char comma = 0;
+        if (coords >> latitude >> comma >> longitude)
+        {
+          lines.back().push_back(point(latitude, longitude));
+        }
+      }
+    }
+    return lines;
+  }
+
+  // Rows that start a feature of the given kind, like "Polygon:".
+  size_t countRows(const string& text, const string& start)
+  {
+    size_t count = 0;
+    istringstream in(text);
+    string row;
+    while (getline(in, row))
+    {
+      if (row.compare(0, start.size(), start) == 0) ++count;
+    }
+    return count;
+  }
+
+  // Both ends on the same side of the region, so drawn along its edge.
+  bool alongEdge(const ClipRegion& region, const point& a, const point& b)
+  {
+    return (a.latitude == region.south() && b.latitude == region.south()) ||
+      (a.latitude == region.north() && b.latitude == region.north()) ||
+      (a.longitude == region.west() && b.longitude == region.west()) ||
+      (a.longitude == region.east() && b.longitude == region.east());
+  }
+
+  OGRLinearRing* ringOf(const vector<point>& corners)
+  {
+    OGRLinearRing *ring = new OGRLinearRing;
+    for (const point& pnt : corners) ring->addPoint(pnt.longitude, pnt.latitude);
+    ring->addPoint(corners.front().longitude, corners.front().latitude);
+    return ring;
+  }
+
+  // A square from south west to north east, with a square hole in the
+  // middle if hole is set.
+  OGRPolygon* square(double south, double west, double north, double east, bool hole = false)
+  {
+    OGRPolygon *poly = new OGRPolygon;
+    poly->addRingDirectly(ringOf({ point(south, west), point(north, west), point(north, east),
+      point(south, east) }));
+    if (hole)
+    {
+      const double dLat = (north - south) / 4.0;
+      const double dLon = (east - west) / 4.0;
+      poly->addRingDirectly(ringOf({ point(south + dLat, west + dLon),
+        point(south + dLat, east - dLon), point(north - dLat, east - dLon),
+        point(north - dLat, west + dLon) }));
+    }
+    return poly;
+  }
+
+  string textOf(const PlaceFile& pf)
+  {
+    ostringstream out;
+    out << pf;
+    return out.str();
+  }
+
+  const PlaceFileColor COLORS[3] = { PlaceFileColor(255, 0, 0), PlaceFileColor(0, 255, 0),
+    PlaceFileColor(0, 0, 255) };
+
+  // Lines, polygons and points with a mix of styles. The lines are enough to
+  // be formatted in several chunks, and in parts with a spill path.
+  void addLayers(PlaceFile& pf, unsigned int seed)
+  {
+    mt19937 gen(seed);
+    uniform_real_distribution<double> lat(33.0, 37.0);
+    uniform_real_distribution<double> lon(-100.0, -94.0);
+    uniform_real_distribution<double> step(-0.01, 0.01);
+
+    pf.beginLayer("roads");
+    for (int i = 0; i != 3000; ++i)
+    {
+      vector<point> pts;
+      point pnt(lat(gen), lon(gen));
+      for (int k = 0; k != 100; ++k)
+      {
+        pts.push_back(pnt);
+        pnt = point(pnt.latitude + step(gen), pnt.longitude + step(gen));
+      }
+      pf.addFeature(PlaceFile::FP(new LineFeature("road " + to_string(i), COLORS[i % 3], pts,
+        100 + 100 * (i % 2), 2)));
+    }
+
+    pf.beginLayer("counties", CoordinateFormatter::PRECISION_AUTO);
+    for (int i = 0; i != 300; ++i)
+    {
+      const double south = lat(gen);
+      const double west = lon(gen);
+      unique_ptr<OGRPolygon> poly(square(south, west, south + 0.2, west + 0.3, i % 4 == 0));
+      pf.addOGRGeometry("county " + to_string(i), COLORS[i % 2], *poly, nullptr, i % 3 == 0,
+        50 + 25 * (i % 3), 1);
+    }
+
+    pf.beginLayer("towns");
+    for (int i = 0; i != 500; ++i)
+    {
+      pf.addFeature(PlaceFile::FP(new PointFeature("town " + to_string(i), COLORS[(i / 7) % 3],
+        lat(gen), lon(gen), 50 + 10 * (i % 3))));
+    }
+  }
+
+  struct Options
+  {
+    bool group;
+    bool hilbert;
+    bool early;
+    bool spill;
+  };
+
+  void configure(PlaceFile& pf, const Options& opts, const TempDir& dir)
+  {
+    pf.setGroupByStyle(opts.group);
+    pf.setHilbertOrder(opts.hilbert);
+    pf.setFormatEarly(opts.early);
+    if (opts.spill) pf.setSpillPath(dir.file("spill"));
+    pf.setPrecision(4);
+    pf.setKeepFormattedLayers(true);
+  }
+
+  // A saved file, its statistics, and the text kept for each layer.
+  struct Saved
+  {
+    string text;
+    PlaceFile::SaveStats stats;
+    vector<PlaceFile::FormattedLayerPtr> kept;
+  };
+
+  Saved save(PlaceFile& pf, const TempDir& dir)
+  {
+    Saved saved;
+    const string path = dir.file("out.txt");
+    const uint64_t bytes = pf.saveFile(path);
+    saved.text = readFile(path);
+    saved.stats = pf.getSaveStats();
+    CHECK(bytes == saved.stats.bytesWritten);
+    CHECK(saved.text.size() == bytes);
+    for (size_t i = 0; i != saved.stats.layers.size(); ++i)
+    {
+      saved.kept.push_back(pf.getFormattedLayer(i));
+    }
+    return saved;
+  }
+
+  void checkSame(const Saved& expected, const Saved& actual)
+  {
+    // Not compared by Catch, which would print both files.
+    const bool sameText = actual.text == expected.text;
+    CHECK(sameText);
+    CHECK(actual.stats.bytesWritten == expected.stats.bytesWritten);
+    CHECK(actual.stats.styleBytesSaved == expected.stats.styleBytesSaved);
+    CHECK(actual.stats.hash == expected.stats.hash);
+    CHECK_FALSE(actual.stats.unchanged);
+    REQUIRE(actual.stats.layers.size() == expected.stats.layers.size());
+    for (size_t i = 0; i != expected.stats.layers.size(); ++i)
+    {
+      const PlaceFile::LayerStats& want = expected.stats.layers[i];
+      const PlaceFile::LayerStats& got = actual.stats.layers[i];
+      INFO("layer " << want.name);
+      CHECK(got.name == want.name);
+      CHECK(got.bytes == want.bytes);
+      CHECK(got.bytesSaved == want.bytesSaved);
+      CHECK(got.pointsDropped == want.pointsDropped);
+      CHECK(got.hash == want.hash);
+      CHECK(got.verticesIn == want.verticesIn);
+      CHECK(got.verticesOut == want.verticesOut);
+      CHECK(got.verticesCleaned == want.verticesCleaned);
+      CHECK(got.formatted == want.formatted);
+    }
+  }
+
+  // Save the layers kept by an earlier save again, without their features.
+  Saved resave(const Saved& earlier, const Options& opts, const TempDir& dir)
+  {
+    PlaceFile pf;
+    configure(pf, opts, dir);
+    for (size_t i = 0; i != earlier.kept.size(); ++i)
+    {
+      REQUIRE(earlier.kept[i]);
+      pf.addFormattedLayer(earlier.stats.layers[i].name, earlier.kept[i]);
+    }
+    return save(pf, dir);
+  }
+
+  // The layers of earlier as they would be saved again from kept text.
+  Saved asKept(Saved earlier)
+  {
+    for (PlaceFile::LayerStats& layer : earlier.stats.layers) layer.formatted = true;
+    return earlier;
+  }
+
+  // The roads from kept text with a point added after them, then layers from
+  // another seed.
+  Saved saveWithKept(PlaceFile::FormattedLayerPtr roads, const Options& opts,
+    const TempDir& dir)
+  {
+    PlaceFile pf;
+    configure(pf, opts, dir);
+    pf.addFormattedLayer("kept roads", roads);
+    pf.addFeature(PlaceFile::FP(new PointFeature("extra", PlaceFileColor(1, 2, 3), 30.0, -90.0,
+      20)));
+    addLayers(pf, 2);
+    return save(pf, dir);
+  }
+
+  // Seconds since 1970 the file was last changed, 0 if it does not exist.
+  int64_t mtimeOf(const string& path)
+  {
+    VSIStatBufL stat;
+    return VSIStatL(path.c_str(), &stat) == 0 ? static_cast<int64_t>(stat.st_mtime) : 0;
+  }
+
+  // Set the time a file was changed well into the past, so rewriting it now
+  // is seen without waiting for the clock to tick.
+  const int64_t LONG_AGO = 1000000000;
+
+  void changedLongAgo(const string& path)
+  {
+    utimbuf times;
+    times.actime = static_cast<time_t>(LONG_AGO);
+    times.modtime = static_cast<time_t>(LONG_AGO);
+    REQUIRE(utime(path.c_str(), &times) == 0);
+  }
+}
+
+TEST_CASE("Polygons drawn as lines are cut without drawing the clip region", "[PlaceFile]")
+{
+  const ClipRegion region(35.0, -98.0, 36.0, -96.0);
+  const PlaceFileColor color(255, 0, 0);
+
+  PlaceFile pf;
+  pf.setClipRegion(region);
+  GeometryOptions geo;
+
+  SECTION("A polygon over the south edge keeps the three sides inside")
+  {
+    unique_ptr<OGRPolygon> poly(square(34.5, -97.5, 35.5, -96.5));
+    pf.addOGRGeometry("county", color, *poly, nullptr, true, 999, 2, geo);
+    const vector<vector<point>> lines = linesIn(textOf(pf));
+    REQUIRE(lines.size() == 1);
+    CHECK(samePath(lines[0], { point(35.0, -97.5), point(35.5, -97.5), point(35.5, -96.5),
+      point(35.0, -96.5) }));
+  }
+
+  SECTION("Holes are cut the same way")
+  {
+    unique_ptr<OGRPolygon> poly(square(34.0, -97.5, 35.5, -96.5, true));
+    pf.addOGRGeometry("county", color, *poly, nullptr, true, 999, 2, geo);
+    const vector<vector<point>> lines = linesIn(textOf(pf));
+    CHECK(lines.size() == 2);
+    for (const vector<point>& line : lines)
+    {
+      for (size_t i = 1; i < line.size(); ++i)
+      {
+        CHECK_FALSE(alongEdge(region, line[i - 1], line[i]));
+      }
+    }
+  }
+
+  SECTION("A multipolygon keeps the whole parts inside as they are")
+  {
+    OGRMultiPolygon multi;
+    multi.addGeometryDirectly(square(35.2, -97.8, 35.8, -97.2));
+    multi.addGeometryDirectly(square(35.5, -96.5, 36.5, -95.5));
+    multi.addGeometryDirectly(square(37.0, -97.0, 37.5, -96.5));
+    pf.addOGRGeometry("county", color, multi, nullptr, true, 999, 2, geo);
+    const vector<vector<point>> lines = linesIn(textOf(pf));
+    REQUIRE(lines.size() == 2);
+    CHECK(lines[0].size() + lines[1].size() == 8);
+    for (const vector<point>& line : lines)
+    {
+      for (size_t i = 1; i < line.size(); ++i)
+      {
+        CHECK_FALSE(alongEdge(region, line[i - 1], line[i]));
+      }
+    }
+  }
+
+  SECTION("Neighbors sharing edges write the edges inside once")
+  {
+    geo.shareEdges = true;
+    unique_ptr<OGRPolygon> west(square(34.5, -97.5, 35.5, -97.0));
+    unique_ptr<OGRPolygon> east(square(34.5, -97.0, 35.5, -96.5));
+    pf.addOGRGeometry("west", color, *west, nullptr, true, 999, 2, geo);
+    pf.addOGRGeometry("east", color, *east, nullptr, true, 999, 2, geo);
+    pf.endLayer();
+
+    // The outline and the shared side, each inside the region.
+    const vector<vector<point>> lines = linesIn(textOf(pf));
+    size_t segments = 0;
+    for (const vector<point>& line : lines)
+    {
+      REQUIRE(line.size() >= 2);
+      segments += line.size() - 1;
+      for (const point& pnt : line) CHECK(region.contains(pnt));
+      for (size_t i = 1; i < line.size(); ++i)
+      {
+        CHECK_FALSE(alongEdge(region, line[i - 1], line[i]));
+      }
+    }
+    CHECK(segments == 5);
+  }
+
+  SECTION("Filled polygons are still closed along the edge")
+  {
+    unique_ptr<OGRPolygon> poly(square(34.5, -97.5, 35.5, -96.5));
+    pf.addOGRGeometry("county", color, *poly, nullptr, false, 999, 2, geo);
+    const string text = textOf(pf);
+    CHECK(countRows(text, "Polygon:") == 1);
+    CHECK(linesIn(text).empty());
+  }
+}
+
+TEST_CASE("Formatting early, in parts or from kept text writes the same file", "[PlaceFile]")
+{
+  TempDir dir;
+  {
+    for (const bool group : { false, true })
+    {
+      for (const bool hilbert : { false, true })
+      {
+        INFO("group " << group << " hilbert " << hilbert);
+
+        // The serial, in-memory path everything else is compared with.
+        const Options serial{ group, hilbert, false, false };
+        PlaceFile pf;
+        configure(pf, serial, dir);
+        addLayers(pf, 1);
+        const Saved expected = save(pf, dir);
+        REQUIRE(expected.stats.layers.size() == 3);
+        for (const PlaceFile::LayerStats& layer : expected.stats.layers) CHECK(layer.bytes > 0);
+        CHECK((group ? expected.stats.styleBytesSaved > 0 : expected.stats.styleBytesSaved == 0));
+
+        const Saved kept = saveWithKept(expected.kept[0], serial, dir);
+        checkSame(asKept(expected), resave(expected, serial, dir));
+
+        for (const bool spill : { false, true })
+        {
+          INFO("spill " << spill);
+          const Options early{ group, hilbert, true, spill };
+          PlaceFile earlyPf;
+          configure(earlyPf, early, dir);
+          addLayers(earlyPf, 1);
+          const Saved actual = save(earlyPf, dir);
+          checkSame(expected, actual);
+
+          checkSame(asKept(expected), resave(actual, early, dir));
+          checkSame(asKept(expected), resave(actual, serial, dir));
+          checkSame(kept, saveWithKept(actual.kept[0], early, dir));
+        }
+      }
+    }
+  }
+
+  // Spill files go once nothing uses their text.
+  CHECK(dir.tempFiles() == 0);
+}
+
+TEST_CASE("saveFile leaves files that would not change alone", "[PlaceFile]")
+{
+  TempDir dir;
+  const string path = dir.file("out.txt");
+  const string gzip = PlaceFile::gzipPath(path);
+  const PlaceFile::Output output = PlaceFile::Output::PLAIN_AND_GZIP;
+
+  PlaceFile first;
+  first.setKeepFormattedLayers(true);
+  addLayers(first, 3);
+  const uint64_t bytes = first.saveFile(path, output);
+  const PlaceFile::SaveStats saved = first.getSaveStats();
+  const string text = readFile(path);
+  CHECK_FALSE(saved.unchanged);
+  CHECK(text.size() == bytes);
+  CHECK(saved.gzipBytesWritten > 0);
+  const bool gzipSame = readFile("/vsigzip/" + gzip) == text;
+  CHECK(gzipSame);
+  CHECK(dir.files().size() == 2);
+
+  changedLongAgo(path);
+  changedLongAgo(gzip);
+
+  // The same layers again, from features or from the text kept by the first.
+  auto saveAgain = [&](bool fromKept, uint64_t previousHash)
+  {
+    PlaceFile pf;
+    if (fromKept)
+    {
+      for (size_t i = 0; i != saved.layers.size(); ++i)
+      {
+        pf.addFormattedLayer(saved.layers[i].name, first.getFormattedLayer(i));
+      }
+    }
+    else addLayers(pf, 3);
+    CHECK(pf.saveFile(path, output, previousHash) == bytes);
+    const PlaceFile::SaveStats stats = pf.getSaveStats();
+    CHECK(stats.hash == saved.hash);
+    CHECK(stats.bytesWritten == saved.bytesWritten);
+    CHECK(dir.tempFiles() == 0);
+    return stats;
+  };
+
+  SECTION("The same hash skips the save")
+  {
+    for (const bool fromKept : { false, true })
+    {
+      INFO("from kept layers " << fromKept);
+      const PlaceFile::SaveStats stats = saveAgain(fromKept, saved.hash);
+      CHECK(stats.unchanged);
+      CHECK(stats.gzipBytesWritten == saved.gzipBytesWritten);
+      CHECK(mtimeOf(path) == LONG_AGO);
+      CHECK(mtimeOf(gzip) == LONG_AGO);
+    }
+  }
+
+  SECTION("A different hash saves")
+  {
+    for (const bool fromKept : { false, true })
+    {
+      INFO("from kept layers " << fromKept);
+      changedLongAgo(path);
+      changedLongAgo(gzip);
+      CHECK_FALSE(saveAgain(fromKept, saved.hash + 1).unchanged);
+      CHECK(mtimeOf(path) != LONG_AGO);
+      CHECK(mtimeOf(gzip) != LONG_AGO);
+    }
+  }
+
+  SECTION("A deleted plain file is written again")
+  {
+    for (const bool fromKept : { false, true })
+    {
+      INFO("from kept layers " << fromKept);
+      REQUIRE(VSIUnlink(path.c_str()) == 0);
+      CHECK_FALSE(saveAgain(fromKept, saved.hash).unchanged);
+      CHECK((readFile(path) == text));
+    }
+  }
+
+  SECTION("A resized plain file is written again")
+  {
+    for (const bool fromKept : { false, true })
+    {
+      INFO("from kept layers " << fromKept);
+      REQUIRE(writeFile(path, text + "\n"));
+      changedLongAgo(path);
+      CHECK_FALSE(saveAgain(fromKept, saved.hash).unchanged);
+      CHECK((readFile(path) == text));
+      CHECK(mtimeOf(path) != LONG_AGO);
+    }
+  }
+
+  SECTION("A deleted gzip file is written again")
+  {
+    for (const bool fromKept : { false, true })
+    {
+      INFO("from kept layers " << fromKept);
+      REQUIRE(VSIUnlink(gzip.c_str()) == 0);
+      const PlaceFile::SaveStats stats = saveAgain(fromKept, saved.hash);
+      CHECK_FALSE(stats.unchanged);
+      CHECK(stats.gzipBytesWritten > 0);
+      CHECK((readFile("/vsigzip/" + gzip) == text));
+    }
+  }
+}
@@ -0,0 +1,169 @@
+#include "catch.hpp"
+
+#include <algorithm>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "cpl_vsi.h"
+
+#include "../../src/PlaceFileWriter.hpp"
+#include "TestFiles.hpp"
+
+using namespace std;
+using PFB::PlaceFileWriter;
+using PFBTest::readFile;
+using PFBTest::TempDir;
+using PFBTest::writeFile;
+
+namespace
+{
+  // Lines of text, many times the size of the small buffers used below.
+  string someText()
+  {
+    string text;
+    for (int i = 0; i != 20000; ++i)
+    {
+      text += "Line: 2, 0, \"road " + to_string(i) + "\"\n 35." + to_string(i) + ", -97.5\n";
+    }
+    return text;
+  }
+
+  void write(PlaceFileWriter& out, const string& text)
+  {
+    ostream ost(&out);
+    ost << text.substr(0, 100) << text.substr(100);
+    ost.flush();
+  }
+
+  vector<string> sorted(vector<string> names)
+  {
+    sort(names.begin(), names.end());
+    return names;
+  }
+}
+
+TEST_CASE("PlaceFileWriter writes the plain and gzip files", "[PlaceFileWriter]")
+{
+  TempDir dir;
+  const string text = someText();
+  const string plain = dir.file("out.txt");
+  const string gzip = dir.file("out.txt.gz");
+
+  SECTION("Both")
+  {
+    PlaceFileWriter out(plain, gzip, 4096);
+    write(out, text);
+    out.close();
+    CHECK(dir.tempFiles() == 2);
+    out.publish();
+
+    CHECK(out.bytesWritten() == text.size());
+    CHECK(out.gzipBytesWritten() > 0);
+    CHECK(out.gzipBytesWritten() < text.size());
+    CHECK((readFile(plain) == text));
+    CHECK((readFile("/vsigzip/" + gzip) == text));
+
+    VSIStatBufL stat;
+    REQUIRE(VSIStatL(gzip.c_str(), &stat) == 0);
+    CHECK(static_cast<uint64_t>(stat.st_size) == out.gzipBytesWritten());
+    CHECK((sorted(dir.files()) == vector<string>{ "out.txt", "out.txt.gz" }));
+  }
+
+  SECTION("Only gzip")
+  {
+    PlaceFileWriter out(string(), gzip, 4096);
+    write(out, text);
+    out.close();
+    out.publish();
+    CHECK((readFile("/vsigzip/" + gzip) == text));
+    CHECK((dir.files() == vector<string>{ "out.txt.gz" }));
+  }
+
+  SECTION("Over older files")
+  {
+    REQUIRE(writeFile(plain, "old"));
+    REQUIRE(writeFile(gzip, "old"));
+    PlaceFileWriter out(plain, gzip);
+    write(out, text);
+    out.close();
+    out.publish();
+    CHECK((readFile(plain) == text));
+    CHECK((readFile("/vsigzip/" + gzip) == text));
+    CHECK(dir.files().size() == 2);
+  }
+}
+
+TEST_CASE("PlaceFileWriter leaves the old files when not published", "[PlaceFileWriter]")
+{
+  TempDir dir;
+  const string plain = dir.file("out.txt");
+  const string gzip = dir.file("out.txt.gz");
+  REQUIRE(writeFile(plain, "old"));
+  REQUIRE(writeFile(gzip, "old gzip"));
+
+  SECTION("Discarded")
+  {
+    PlaceFileWriter out(plain, gzip, 4096);
+    write(out, someText());
+    out.close();
+    out.discard();
+  }
+
+  SECTION("Never closed")
+  {
+    PlaceFileWriter out(plain, gzip, 4096);
+    write(out, someText());
+  }
+
+  CHECK(readFile(plain) == "old");
+  CHECK(readFile(gzip) == "old gzip");
+  CHECK(dir.files().size() == 2);
+}
+
+TEST_CASE("PlaceFileWriter puts the old gzip file back if the plain one fails",
+  "[PlaceFileWriter]")
+{
+  TempDir dir;
+  const string text = someText();
+  const string plain = dir.file("out.txt");
+  const string gzip = dir.file("out.txt.gz");
+
+  // A directory with something in it cannot be replaced by a file.
+  REQUIRE(VSIMkdir(plain.c_str(), 0755) == 0);
+  const string blocker = plain + "/keep";
+  REQUIRE(writeFile(blocker, "keep"));
+
+  SECTION("An old gzip file is restored")
+  {
+    REQUIRE(writeFile(gzip, "old gzip"));
+    PlaceFileWriter out(plain, gzip, 4096);
+    write(out, text);
+    out.close();
+    try
+    {
+      out.publish();
+      FAIL("publish did not throw");
+    }
+    catch (const runtime_error& err)
+    {
+      CHECK(string(err.what()).find("no longer matches") == string::npos);
+    }
+    CHECK(readFile(gzip) == "old gzip");
+    CHECK((sorted(dir.files()) == vector<string>{ "out.txt", "out.txt.gz" }));
+  }
+
+  SECTION("A new gzip file is removed")
+  {
+    PlaceFileWriter out(plain, gzip, 4096);
+    write(out, text);
+    out.close();
+    CHECK_THROWS_AS(out.publish(), runtime_error);
+    CHECK((dir.files() == vector<string>{ "out.txt" }));
+  }
+
+  CHECK(readFile(blocker) == "keep");
+  VSIUnlink(blocker.c_str());
+  VSIRmdir(plain.c_str());
+}
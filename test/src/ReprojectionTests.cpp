@@ -0,0 +1,340 @@
+#include "catch.hpp"
+
+#include <cmath>
+#include <memory>
+#include <random>
+#include <vector>
+
+#include "ogrsf_frmts.h"
+
+#include "../../src/point.hpp"
+#include "../../src/Reprojection.hpp"
+
+using namespace std;
+using PFB::countVertices;
+using PFB::EARTH_RADIUS_METERS;
+using PFB::PI;
+using PFB::TransformCache;
+using PFB::transformAll;
+using PFB::transformAllParallel;
+
+namespace
+{
+  using Geometries = vector<unique_ptr<OGRGeometry>>;
+
+  // Web Mercator meters around Oklahoma, about 500 km across.
+  const double WEST = -10.9e6;
+  const double EAST = -10.4e6;
+  const double SOUTH = 3.8e6;
+  const double NORTH = 4.3e6;
+
+  OGRSpatialReference mercator()
+  {
+    OGRSpatialReference srs;
+    REQUIRE(srs.importFromEPSG(3857) == OGRERR_NONE);
+    return srs;
+  }
+
+  // The x and y of every vertex in geometry, in the order transformAll
+  // visits them.
+  void addVertices(const OGRGeometry& geometry, vector<double>& xy)
+  {
+    switch (wkbFlatten(geometry.getGeometryType()))
+    {
+    case wkbPoint:
+    {
+      const OGRPoint& pnt = static_cast<const OGRPoint&>(geometry);
+      xy.push_back(pnt.getX());
+      xy.push_back(pnt.getY());
+      break;
+    }
+
+    case wkbLineString:
+    case wkbLinearRing:
+    {
+      const OGRSimpleCurve& curve = static_cast<const OGRSimpleCurve&>(geometry);
+      for (int i = 0; i != curve.getNumPoints(); ++i)
+      {
+        xy.push_back(curve.getX(i));
+        xy.push_back(curve.getY(i));
+      }
+      break;
+    }
+
+    case wkbPolygon:
+    {
+      const OGRPolygon& poly = static_cast<const OGRPolygon&>(geometry);
+      addVertices(*poly.getExteriorRing(), xy);
+      for (int i = 0; i != poly.getNumInteriorRings(); ++i)
+      {
+        addVertices(*poly.getInteriorRing(i), xy);
+      }
+      break;
+    }
+
+    default:
+    {
+      const OGRGeometryCollection& coll = static_cast<const OGRGeometryCollection&>(geometry);
+      for (int i = 0; i != coll.getNumGeometries(); ++i)
+      {
+        addVertices(*coll.getGeometryRef(i), xy);
+      }
+      break;
+    }
+    }
+  }
+
+  vector<double> verticesOf(const Geometries& geometries)
+  {
+    vector<double> xy;
+    for (const auto& geometry : geometries) addVertices(*geometry, xy);
+    return xy;
+  }
+
+  vector<OGRGeometry*> pointers(const Geometries& geometries)
+  {
+    vector<OGRGeometry*> ptrs;
+    for (const auto& geometry : geometries) ptrs.push_back(geometry.get());
+    return ptrs;
+  }
+
+  Geometries copyOf(const Geometries& geometries)
+  {
+    Geometries copies;
+    for (const auto& geometry : geometries) copies.emplace_back(geometry->clone());
+    return copies;
+  }
+
+  OGRLinearRing* ring(double x0, double y0, double x1, double y1)
+  {
+    OGRLinearRing *pts = new OGRLinearRing;
+    pts->addPoint(x0, y0);
+    pts->addPoint(x0, y1);
+    pts->addPoint(x1, y1);
+    pts->addPoint(x1, y0);
+    pts->addPoint(x0, y0);
+    return pts;
+  }
+
+  // Points, lines, polygons with holes and collections of each, numLines
+  // lines of 100 vertices wandering over the area.
+  Geometries mixed(size_t numLines)
+  {
+    mt19937 gen(1016);
+    uniform_real_distribution<double> x(WEST, EAST);
+    uniform_real_distribution<double> y(SOUTH, NORTH);
+    uniform_real_distribution<double> step(-2000.0, 2000.0);
+
+    Geometries geometries;
+    for (size_t i = 0; i != numLines; ++i)
+    {
+      OGRLineString *line = new OGRLineString;
+      double px = x(gen), py = y(gen);
+      for (int k = 0; k != 100; ++k)
+      {
+        line->addPoint(px, py);
+        px += step(gen);
+        py += step(gen);
+      }
+
+      switch (i % 5)
+      {
+      case 0:
+        geometries.emplace_back(line);
+        break;
+
+      case 1:
+      {
+        OGRMultiLineString *lines = new OGRMultiLineString;
+        lines->addGeometryDirectly(line);
+        lines->addGeometryDirectly(line->clone());
+        geometries.emplace_back(lines);
+        break;
+      }
+
+      case 2:
+      {
+        OGRPolygon *poly = new OGRPolygon;
+        poly->addRingDirectly(ring(px, py, px + 5000.0, py + 5000.0));
+        poly->addRingDirectly(ring(px + 1000.0, py + 1000.0, px + 2000.0, py + 2000.0));
+        geometries.emplace_back(poly);
+        delete line;
+        break;
+      }
+
+      case 3:
+      {
+        OGRMultiPolygon *polys = new OGRMultiPolygon;
+        for (int k = 0; k != 2; ++k)
+        {
+          OGRPolygon *poly = new OGRPolygon;
+          poly->addRingDirectly(ring(px + k * 6000.0, py, px + k * 6000.0 + 5000.0,
+            py + 5000.0));
+          polys->addGeometryDirectly(poly);
+        }
+        geometries.emplace_back(polys);
+        delete line;
+        break;
+      }
+
+      default:
+      {
+        geometries.emplace_back(new OGRPoint(px, py));
+        OGRMultiPoint *pts = new OGRMultiPoint;
+        for (int k = 0; k != line->getNumPoints(); k += 10)
+        {
+          pts->addGeometryDirectly(new OGRPoint(line->getX(k), line->getY(k)));
+        }
+        geometries.emplace_back(pts);
+        delete line;
+        break;
+      }
+      }
+    }
+    return geometries;
+  }
+
+  // Distance between two latitude and longitude pairs, close enough for
+  // the small differences compared here.
+  double errorMeters(double lon0, double lat0, double lon1, double lat1)
+  {
+    const double perDegree = EARTH_RADIUS_METERS * PI / 180.0;
+    const double dy = (lat1 - lat0) * perDegree;
+    const double dx = (lon1 - lon0) * perDegree * cos(lat0 * PI / 180.0);
+    return sqrt(dx * dx + dy * dy);
+  }
+
+  // The largest distance between the same vertex in exact and approx.
+  double maxErrorMeters(const vector<double>& exact, const vector<double>& approx)
+  {
+    REQUIRE(exact.size() == approx.size());
+    double worst = 0.0;
+    for (size_t i = 0; i + 1 < exact.size(); i += 2)
+    {
+      worst = max(worst, errorMeters(exact[i], exact[i + 1], approx[i], approx[i + 1]));
+    }
+    return worst;
+  }
+}
+
+TEST_CASE("countVertices counts every part", "[Reprojection]")
+{
+  const Geometries geometries = mixed(10);
+  size_t total = 0;
+  for (const auto& geometry : geometries) total += countVertices(*geometry);
+  CHECK(total * 2 == verticesOf(geometries).size());
+}
+
+TEST_CASE("transformAll matches transforming each geometry", "[Reprojection]")
+{
+  OGRSpatialReference srs = mercator();
+  TransformCache cache;
+  OGRCoordinateTransformation *trans = cache.get(&srs);
+  REQUIRE(trans != nullptr);
+  CHECK(cache.get(&cache.target()) == nullptr);
+  CHECK(cache.get(nullptr) == nullptr);
+
+  // Enough vertices for transformAllParallel to use more than one thread.
+  const Geometries source = mixed(1000);
+  REQUIRE(verticesOf(source).size() / 2 > 2 * (1 << 14));
+
+  Geometries expected = copyOf(source);
+  for (auto& geometry : expected) REQUIRE(geometry->transform(trans) == OGRERR_NONE);
+  const vector<double> want = verticesOf(expected);
+
+  SECTION("In one batch")
+  {
+    Geometries actual = copyOf(source);
+    const vector<bool> ok = transformAll(pointers(actual), trans);
+    CHECK(ok == vector<bool>(source.size(), true));
+    CHECK((verticesOf(actual) == want));
+  }
+
+  SECTION("On several threads")
+  {
+    for (unsigned int numThreads : { 1u, 2u, 3u, 8u })
+    {
+      INFO("threads " << numThreads);
+      Geometries actual = copyOf(source);
+      const vector<bool> ok = transformAllParallel(pointers(actual), cache, &srs, numThreads);
+      CHECK(ok == vector<bool>(source.size(), true));
+      CHECK((verticesOf(actual) == want));
+    }
+  }
+
+  SECTION("Already latitude and longitude")
+  {
+    Geometries actual = copyOf(source);
+    const vector<bool> ok = transformAllParallel(pointers(actual), cache, &cache.target(), 2);
+    CHECK(ok == vector<bool>(source.size(), true));
+    CHECK((verticesOf(actual) == verticesOf(source)));
+  }
+}
+
+TEST_CASE("Interpolated vertices are within the tolerance", "[Reprojection]")
+{
+  OGRSpatialReference srs = mercator();
+  TransformCache cache;
+  OGRCoordinateTransformation *trans = cache.get(&srs);
+  REQUIRE(trans != nullptr);
+
+  // A regular grid of points over the area, and lines across it.
+  Geometries source;
+  const int steps = 150;
+  for (int i = 0; i <= steps; ++i)
+  {
+    for (int j = 0; j <= steps; ++j)
+    {
+      source.emplace_back(new OGRPoint(WEST + (EAST - WEST) * i / steps,
+        SOUTH + (NORTH - SOUTH) * j / steps));
+    }
+  }
+  for (auto& geometry : mixed(200)) source.push_back(move(geometry));
+
+  Geometries expected = copyOf(source);
+  REQUIRE(transformAll(pointers(expected), trans) == vector<bool>(source.size(), true));
+  const vector<double> want = verticesOf(expected);
+
+  for (double tolerance : { 0.01, 1.0, 10.0, 100.0 })
+  {
+    INFO("tolerance " << tolerance << " m");
+    Geometries actual = copyOf(source);
+    CHECK(transformAll(pointers(actual), trans, tolerance) ==
+      vector<bool>(source.size(), true));
+    CHECK(maxErrorMeters(want, verticesOf(actual)) <= tolerance);
+
+    Geometries parallel = copyOf(source);
+    CHECK(transformAllParallel(pointers(parallel), cache, &srs, 2, tolerance) ==
+      vector<bool>(source.size(), true));
+    CHECK(maxErrorMeters(want, verticesOf(parallel)) <= tolerance);
+  }
+}
+
+TEST_CASE("Points too close together to split are transformed exactly", "[Reprojection]")
+{
+  OGRSpatialReference srs = mercator();
+  TransformCache cache;
+  OGRCoordinateTransformation *trans = cache.get(&srs);
+  REQUIRE(trans != nullptr);
+
+  // A tight cluster with the same point many times over, and one point far
+  // away. Splitting as deep as it goes leaves the cluster in one cell, and
+  // no cell that small can be interpolated within a micrometer.
+  Geometries source;
+  mt19937 gen(1016);
+  uniform_real_distribution<double> offset(0.0, 1.0);
+  for (int i = 0; i != 1000; ++i)
+  {
+    source.emplace_back(new OGRPoint(WEST + offset(gen), SOUTH + offset(gen)));
+    source.emplace_back(new OGRPoint(WEST + 0.5, SOUTH + 0.5));
+  }
+  source.emplace_back(new OGRPoint(WEST, SOUTH));
+  source.emplace_back(new OGRPoint(EAST, NORTH));
+
+  Geometries expected = copyOf(source);
+  REQUIRE(transformAll(pointers(expected), trans) == vector<bool>(source.size(), true));
+
+  Geometries actual = copyOf(source);
+  CHECK(transformAll(pointers(actual), trans, 1.0e-6) == vector<bool>(source.size(), true));
+  CHECK((verticesOf(actual) == verticesOf(expected)));
+}
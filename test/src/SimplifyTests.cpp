@@ -0,0 +1,210 @@
+#include "catch.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <vector>
+
+#include "../../src/Simplify.hpp"
+#include "TestGeometry.hpp"
+
+using namespace std;
+using PFB::PI;
+using PFB::point;
+using PFB::SimplifyMethod;
+using PFB::simplifyLine;
+using PFBTest::same;
+
+namespace
+{
+  const double METERS_PER_DEGREE = PFB::EARTH_RADIUS_METERS * PI / 180.0;
+
+  // A wandering line near Oklahoma City with about 100 m between vertices.
+  vector<point> randomWalk(size_t numPoints, unsigned int seed)
+  {
+    mt19937 gen(seed);
+    normal_distribution<double> step(0.0, 0.001);
+    vector<point> pts{ point(35.4, -97.5) };
+    while (pts.size() < numPoints)
+    {
+      const point& last = pts.back();
+      pts.push_back(point(last.latitude + step(gen), last.longitude + 0.0005 + step(gen)));
+    }
+    return pts;
+  }
+
+  vector<point> circle(size_t numPoints, double radiusDegrees)
+  {
+    vector<point> pts;
+    for (size_t i = 0; i != numPoints; ++i)
+    {
+      const double angle = 2.0 * PI * i / numPoints;
+      pts.push_back(point(35.0 + radiusDegrees * sin(angle),
+        -97.0 + radiusDegrees * cos(angle)));
+    }
+    pts.push_back(pts.front());
+    return pts;
+  }
+
+  // Distance in meters from pnt to the segment from a to b, in the same kind
+  // of local projection the simplification uses.
+  double segmentDistance(const point& pnt, const point& a, const point& b)
+  {
+    const double kx = METERS_PER_DEGREE * cos(pnt.latitude * PI / 180.0);
+    const double px = pnt.longitude * kx, py = pnt.latitude * METERS_PER_DEGREE;
+    const double ax = a.longitude * kx, ay = a.latitude * METERS_PER_DEGREE;
+    const double bx = b.longitude * kx, by = b.latitude * METERS_PER_DEGREE;
+    const double dx = bx - ax, dy = by - ay;
+    const double len2 = dx * dx + dy * dy;
+    double t = len2 > 0.0 ? ((px - ax) * dx + (py - ay) * dy) / len2 : 0.0;
+    t = max(0.0, min(1.0, t));
+    return hypot(px - ax - t * dx, py - ay - t * dy);
+  }
+
+  // Each point of the simplified line must be one of the original points,
+  // in the same order.
+  bool isSubsequence(const vector<point>& simplified, const vector<point>& original)
+  {
+    size_t j = 0;
+    for (const point& pnt : original)
+    {
+      if (j != simplified.size() && same(pnt, simplified[j])) ++j;
+    }
+    return j == simplified.size();
+  }
+}
+
+TEST_CASE("Douglas-Peucker keeps every vertex within the tolerance", "[Simplify]")
+{
+  const vector<point> original = randomWalk(2000, 1);
+  vector<point> pts = original;
+  const double tolerance = 50.0;
+  simplifyLine(pts, SimplifyMethod::DOUGLAS_PEUCKER, tolerance, 0);
+
+  REQUIRE(pts.size() >= 2);
+  CHECK(pts.size() < original.size());
+  CHECK(same(pts.front(), original.front()));
+  CHECK(same(pts.back(), original.back()));
+  REQUIRE(isSubsequence(pts, original));
+
+  // Every removed vertex lies between the two kept ones around it.
+  size_t k = 0;
+  for (size_t i = 0; i != original.size(); ++i)
+  {
+    if (same(original[i], pts[k]))
+    {
+      if (k + 1 < pts.size()) ++k;
+      continue;
+    }
+    CHECK(segmentDistance(original[i], pts[k - 1], pts[k]) <= tolerance * 1.001);
+  }
+}
+
+TEST_CASE("Straight runs are removed and corners kept", "[Simplify]")
+{
+  for (SimplifyMethod method :
+    { SimplifyMethod::DOUGLAS_PEUCKER, SimplifyMethod::VISVALINGAM_WHYATT })
+  {
+    vector<point> pts;
+    for (int i = 0; i <= 10; ++i) pts.push_back(point(35.0, -97.0 + i * 0.01));
+    for (int i = 1; i <= 10; ++i) pts.push_back(point(35.0 + i * 0.01, -96.9));
+
+    simplifyLine(pts, method, 10.0, 0);
+    REQUIRE(pts.size() == 3);
+    CHECK(same(pts[0], point(35.0, -97.0)));
+    CHECK(same(pts[1], point(35.0, -96.9)));
+    CHECK(same(pts[2], point(35.1, -96.9)));
+  }
+}
+
+TEST_CASE("Visvalingam-Whyatt reduces a line to kept vertices", "[Simplify]")
+{
+  const vector<point> original = randomWalk(2000, 2);
+  vector<point> pts = original;
+  simplifyLine(pts, SimplifyMethod::VISVALINGAM_WHYATT, 50.0, 0);
+
+  CHECK(pts.size() >= 2);
+  CHECK(pts.size() < original.size());
+  CHECK(same(pts.front(), original.front()));
+  CHECK(same(pts.back(), original.back()));
+  CHECK(isSubsequence(pts, original));
+
+  SECTION("A bigger tolerance removes more")
+  {
+    vector<point> coarser = original;
+    simplifyLine(coarser, SimplifyMethod::VISVALINGAM_WHYATT, 500.0, 0);
+    CHECK(coarser.size() < pts.size());
+  }
+}
+
+TEST_CASE("Lines over the limit are reduced to it", "[Simplify]")
+{
+  const vector<point> original = randomWalk(5000, 3);
+  for (SimplifyMethod method : { SimplifyMethod::NONE, SimplifyMethod::DOUGLAS_PEUCKER,
+    SimplifyMethod::VISVALINGAM_WHYATT })
+  {
+    vector<point> pts = original;
+    simplifyLine(pts, method, 1.0, 100);
+    CHECK(pts.size() == 100);
+    CHECK(same(pts.front(), original.front()));
+    CHECK(same(pts.back(), original.back()));
+    CHECK(isSubsequence(pts, original));
+  }
+
+  SECTION("Without a method or a limit nothing changes")
+  {
+    vector<point> pts = original;
+    simplifyLine(pts, SimplifyMethod::NONE, 100.0, 0);
+    CHECK(pts.size() == original.size());
+    simplifyLine(pts, SimplifyMethod::DOUGLAS_PEUCKER, 0.0, 0);
+    CHECK(pts.size() == original.size());
+  }
+}
+
+TEST_CASE("Rings stay closed with at least 4 points", "[Simplify]")
+{
+  const vector<SimplifyMethod> methods{ SimplifyMethod::DOUGLAS_PEUCKER,
+    SimplifyMethod::VISVALINGAM_WHYATT };
+
+  SECTION("A ring much bigger than the tolerance")
+  {
+    for (SimplifyMethod method : methods)
+    {
+      vector<point> pts = circle(360, 0.1);
+      simplifyLine(pts, method, 100.0, 0);
+      CHECK(pts.size() >= 4);
+      CHECK(pts.size() < 361);
+      CHECK(same(pts.front(), pts.back()));
+    }
+  }
+
+  SECTION("A ring smaller than the tolerance")
+  {
+    for (SimplifyMethod method : methods)
+    {
+      vector<point> pts = circle(36, 0.0001);
+      simplifyLine(pts, method, 1000.0, 0);
+      CHECK(pts.size() == 4);
+      CHECK(same(pts.front(), pts.back()));
+    }
+  }
+
+  SECTION("A ring over the limit")
+  {
+    for (SimplifyMethod method : methods)
+    {
+      vector<point> pts = circle(1000, 0.1);
+      simplifyLine(pts, method, 1.0, 50);
+      CHECK(pts.size() == 50);
+      CHECK(same(pts.front(), pts.back()));
+    }
+  }
+}
+
+TEST_CASE("Tolerance grows with the display threshold", "[Simplify]")
+{
+  CHECK(PFB::toleranceForThreshold(0) == 0.0);
+  CHECK(PFB::toleranceForThreshold(-5) == 0.0);
+  CHECK(PFB::toleranceForThreshold(100) == Approx(185.2));
+  CHECK(PFB::toleranceForThreshold(50) < PFB::toleranceForThreshold(500));
+}
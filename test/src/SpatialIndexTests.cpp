@@ -0,0 +1,280 @@
+#include "catch.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <random>
+#include <vector>
+
+#include "../../src/SpatialIndex.hpp"
+
+using namespace std;
+using PFB::Bounds;
+using PFB::EARTH_RADIUS_MILES;
+using PFB::PI;
+using PFB::point;
+using PFB::SpatialIndex;
+
+namespace
+{
+  Bounds box(double south, double west, double north, double east)
+  {
+    Bounds bounds;
+    bounds.south = south;
+    bounds.west = west;
+    bounds.north = north;
+    bounds.east = east;
+    return bounds;
+  }
+
+  Bounds pointBox(const point& pnt)
+  {
+    return box(pnt.latitude, pnt.longitude, pnt.latitude, pnt.longitude);
+  }
+
+  double distanceMiles(const point& a, const point& b)
+  {
+    const double toRad = PI / 180.0;
+    const double sinLat = sin((b.latitude - a.latitude) * toRad / 2.0);
+    const double sinLon = sin((b.longitude - a.longitude) * toRad / 2.0);
+    const double h = sinLat * sinLat +
+      cos(a.latitude * toRad) * cos(b.latitude * toRad) * sinLon * sinLon;
+    return 2.0 * EARTH_RADIUS_MILES * asin(sqrt(min(h, 1.0)));
+  }
+
+  // Random points over the lower 48 states, keyed by their position.
+  vector<point> randomPoints(size_t numPoints, unsigned int seed)
+  {
+    mt19937_64 gen(seed);
+    uniform_real_distribution<double> lat(25.0, 50.0);
+    uniform_real_distribution<double> lon(-125.0, -65.0);
+    vector<point> pnts;
+    pnts.reserve(numPoints);
+    for (size_t i = 0; i != numPoints; ++i) pnts.push_back(point(lat(gen), lon(gen)));
+    return pnts;
+  }
+
+  vector<SpatialIndex::Entry> pointEntries(const vector<point>& pnts)
+  {
+    vector<SpatialIndex::Entry> entries;
+    entries.reserve(pnts.size());
+    for (size_t i = 0; i != pnts.size(); ++i)
+    {
+      entries.push_back(SpatialIndex::Entry{ pointBox(pnts[i]), i });
+    }
+    return entries;
+  }
+
+  vector<size_t> bruteQuery(const vector<SpatialIndex::Entry>& entries, const Bounds& query)
+  {
+    vector<size_t> keys;
+    for (const SpatialIndex::Entry& entry : entries)
+    {
+      if (entry.bounds.intersects(query)) keys.push_back(entry.key);
+    }
+    return keys;
+  }
+
+  vector<size_t> bruteRadius(const vector<point>& pnts, const point& center, double miles)
+  {
+    vector<size_t> keys;
+    for (size_t i = 0; i != pnts.size(); ++i)
+    {
+      if (distanceMiles(center, pnts[i]) <= miles) keys.push_back(i);
+    }
+    return keys;
+  }
+
+  vector<size_t> sorted(vector<size_t> keys)
+  {
+    sort(keys.begin(), keys.end());
+    return keys;
+  }
+}
+
+TEST_CASE("An empty SpatialIndex finds nothing", "[SpatialIndex]")
+{
+  SpatialIndex index;
+  vector<size_t> keys;
+  index.query(box(-90.0, -180.0, 90.0, 180.0), keys);
+  index.queryRadius(point(35.0, -97.0), 1000.0, keys);
+  CHECK(keys.empty());
+  CHECK(index.empty());
+
+  index.build(vector<SpatialIndex::Entry>());
+  CHECK(index.empty());
+
+  SECTION("clear empties a built index")
+  {
+    index.build(pointEntries(randomPoints(100, 1)));
+    CHECK(index.size() == 100);
+    index.clear();
+    CHECK(index.empty());
+    index.query(box(-90.0, -180.0, 90.0, 180.0), keys);
+    CHECK(keys.empty());
+  }
+}
+
+TEST_CASE("SpatialIndex box queries match a brute force scan", "[SpatialIndex]")
+{
+  mt19937_64 gen(1016);
+  uniform_real_distribution<double> lat(24.0, 51.0);
+  uniform_real_distribution<double> lon(-126.0, -64.0);
+  uniform_real_distribution<double> size(0.0, 3.0);
+
+  // Sizes around the node size, where the levels of the tree are ragged.
+  for (size_t numEntries : { 1u, 15u, 16u, 17u, 255u, 257u, 5000u, 50000u })
+  {
+    INFO("entries " << numEntries);
+
+    // Boxes of many sizes, some of them points.
+    vector<SpatialIndex::Entry> entries;
+    for (size_t i = 0; i != numEntries; ++i)
+    {
+      const double south = lat(gen);
+      const double west = lon(gen);
+      const double grow = i % 3 == 0 ? 0.0 : size(gen) * size(gen) / 3.0;
+      entries.push_back(SpatialIndex::Entry{ box(south, west, south + grow, west + grow), i });
+    }
+    SpatialIndex index;
+    index.build(vector<SpatialIndex::Entry>(entries));
+    REQUIRE(index.size() == numEntries);
+
+    for (int i = 0; i < 200; ++i)
+    {
+      const double south = lat(gen);
+      const double west = lon(gen);
+      const Bounds query = box(south, west, south + size(gen), west + size(gen));
+      vector<size_t> keys;
+      index.query(query, keys);
+      CHECK(sorted(keys) == bruteQuery(entries, query));
+    }
+
+    vector<size_t> all;
+    index.query(box(-90.0, -180.0, 90.0, 180.0), all);
+    CHECK(all.size() == numEntries);
+  }
+
+  SECTION("Boxes that only touch are found")
+  {
+    SpatialIndex index;
+    index.build({ SpatialIndex::Entry{ box(35.0, -98.0, 36.0, -97.0), 7 } });
+    vector<size_t> keys;
+    index.query(box(36.0, -97.0, 37.0, -96.0), keys);
+    CHECK(keys == vector<size_t>{ 7 });
+  }
+}
+
+TEST_CASE("SpatialIndex radius queries match a brute force scan", "[SpatialIndex]")
+{
+  const vector<point> pnts = randomPoints(100000, 2);
+  SpatialIndex index;
+  index.build(pointEntries(pnts));
+
+  mt19937_64 gen(17);
+  uniform_real_distribution<double> lat(25.0, 50.0);
+  uniform_real_distribution<double> lon(-125.0, -65.0);
+  for (double miles : { 1.0, 25.0, 230.0, 1000.0 })
+  {
+    for (int i = 0; i < 50; ++i)
+    {
+      const point center(lat(gen), lon(gen));
+      INFO("miles " << miles << " center " << center.latitude << "," << center.longitude);
+      vector<size_t> keys;
+      index.queryRadius(center, miles, keys);
+      CHECK(sorted(keys) == bruteRadius(pnts, center, miles));
+    }
+  }
+
+  SECTION("A box partly within the radius is found")
+  {
+    SpatialIndex boxes;
+    boxes.build({ SpatialIndex::Entry{ box(35.0, -99.0, 36.0, -97.1), 3 },
+      SpatialIndex::Entry{ box(35.0, -96.9, 36.0, -95.0), 4 } });
+    vector<size_t> keys;
+    boxes.queryRadius(point(35.5, -97.0), 10.0, keys);
+    CHECK((sorted(keys) == vector<size_t>{ 3, 4 }));
+    keys.clear();
+    boxes.queryRadius(point(35.5, -96.0), 10.0, keys);
+    CHECK(keys == vector<size_t>{ 4 });
+  }
+}
+
+/*
+ * Hidden, run with the [benchmark] tag. Times building the index over a
+ * million point features and the queries of a radar sized area against it,
+ * and the same queries as a scan of every feature.
+ */
+TEST_CASE("Benchmark SpatialIndex on a million points", "[.][benchmark]")
+{
+  const size_t NUM_POINTS = 1000000;
+  const int NUM_QUERIES = 10000;
+  const int NUM_SCANS = 20;
+  const vector<point> pnts = randomPoints(NUM_POINTS, 42);
+  const vector<SpatialIndex::Entry> entries = pointEntries(pnts);
+
+  using Clock = chrono::steady_clock;
+  auto millis = [](Clock::time_point start)
+  {
+    return chrono::duration<double, milli>(Clock::now() - start).count();
+  };
+
+  Clock::time_point start = Clock::now();
+  SpatialIndex index;
+  index.build(vector<SpatialIndex::Entry>(entries));
+  const double buildMs = millis(start);
+
+  mt19937_64 gen(7);
+  uniform_real_distribution<double> lat(27.0, 48.0);
+  uniform_real_distribution<double> lon(-123.0, -67.0);
+  vector<point> centers;
+  for (int i = 0; i != NUM_QUERIES; ++i) centers.push_back(point(lat(gen), lon(gen)));
+
+  // Boxes 3 degrees on a side and circles of 115 miles, about the range of
+  // a radar.
+  const double halfSize = 1.5;
+  vector<size_t> keys;
+  size_t boxFound = 0;
+  size_t firstFound = 0;  // By the queries that are also scanned
+  start = Clock::now();
+  for (int i = 0; i != NUM_QUERIES; ++i)
+  {
+    const point& center = centers[i];
+    keys.clear();
+    index.query(box(center.latitude - halfSize, center.longitude - halfSize,
+      center.latitude + halfSize, center.longitude + halfSize), keys);
+    boxFound += keys.size();
+    if (i < NUM_SCANS) firstFound += keys.size();
+  }
+  const double boxMs = millis(start);
+
+  size_t radiusFound = 0;
+  start = Clock::now();
+  for (const point& center : centers)
+  {
+    keys.clear();
+    index.queryRadius(center, 115.0, keys);
+    radiusFound += keys.size();
+  }
+  const double radiusMs = millis(start);
+
+  size_t scanFound = 0;
+  start = Clock::now();
+  for (int i = 0; i != NUM_SCANS; ++i)
+  {
+    const point& center = centers[i];
+    scanFound += bruteQuery(entries, box(center.latitude - halfSize,
+      center.longitude - halfSize, center.latitude + halfSize,
+      center.longitude + halfSize)).size();
+  }
+  const double scanMs = millis(start);
+
+  WARN("Build over " << NUM_POINTS << " points: " << buildMs << " ms");
+  WARN("Box queries: " << NUM_QUERIES / boxMs * 1000.0 << " per second, " <<
+    boxFound / NUM_QUERIES << " points each");
+  WARN("Radius queries: " << NUM_QUERIES / radiusMs * 1000.0 << " per second, " <<
+    radiusFound / NUM_QUERIES << " points each");
+  WARN("Box queries by scanning: " << NUM_SCANS / scanMs * 1000.0 << " per second");
+  CHECK(scanFound > 0);
+  CHECK(scanFound == firstFound);
+}
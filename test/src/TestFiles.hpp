@@ -0,0 +1,89 @@
+/*
+Temporary files shared by the unit tests that write to disk.
+
+*/
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include "cpl_conv.h"
+#include "cpl_string.h"
+#include "cpl_vsi.h"
+
+namespace PFBTest
+{
+  /// A directory for the files of one test, removed with them when done.
+  struct TempDir
+  {
+    std::string path;
+
+    TempDir() : path(CPLGenerateTempFilename("PFBTest"))
+    {
+      VSIMkdir(path.c_str(), 0755);
+    }
+
+    ~TempDir()
+    {
+      for (const std::string& name : files()) VSIUnlink(file(name).c_str());
+      VSIRmdir(path.c_str());
+    }
+
+    TempDir(const TempDir&) = delete;
+    TempDir& operator=(const TempDir&) = delete;
+
+    std::string file(const std::string& name) const
+    {
+      return CPLFormFilename(path.c_str(), name.c_str(), nullptr);
+    }
+
+    /// Names of the files in the directory.
+    std::vector<std::string> files() const
+    {
+      std::vector<std::string> names;
+      char **list = VSIReadDir(path.c_str());
+      for (int i = 0; list != nullptr && list[i] != nullptr; ++i)
+      {
+        const std::string name = list[i];
+        if (name != "." && name != "..") names.push_back(name);
+      }
+      CSLDestroy(list);
+      return names;
+    }
+
+    /// Files left in the directory ending in ".tmp".
+    size_t tempFiles() const
+    {
+      size_t count = 0;
+      for (const std::string& name : files())
+      {
+        if (name.size() > 4 && name.compare(name.size() - 4, 4, ".tmp") == 0) ++count;
+      }
+      return count;
+    }
+  };
+
+  /// The whole file, through the GDAL virtual file system so "/vsigzip/"
+  /// paths are decompressed. Empty if it cannot be opened.
+  inline std::string readFile(const std::string& path)
+  {
+    std::string text;
+    VSILFILE *file = VSIFOpenL(path.c_str(), "rb");
+    if (file == nullptr) return text;
+    std::vector<char> buf(1 << 16);
+    size_t n = 0;
+    while ((n = VSIFReadL(buf.data(), 1, buf.size(), file)) != 0) text.append(buf.data(), n);
+    VSIFCloseL(file);
+    return text;
+  }
+
+  /// Replace the file with text.
+  inline bool writeFile(const std::string& path, const std::string& text)
+  {
+    VSILFILE *file = VSIFOpenL(path.c_str(), "wb");
+    if (file == nullptr) return false;
+    const bool ok = VSIFWriteL(text.data(), 1, text.size(), file) == text.size();
+    return VSIFCloseL(file) == 0 && ok;
+  }
+}
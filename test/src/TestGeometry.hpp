@@ -0,0 +1,26 @@
+/*
+Comparisons of points and paths shared by the unit tests.
+
+*/
+#pragma once
+
+#include <algorithm>
+#include <vector>
+
+#include "../../src/point.hpp"
+
+namespace PFBTest
+{
+  /// Exactly the same coordinates.
+  inline bool same(const PFB::point& lhs, const PFB::point& rhs)
+  {
+    return PFB::PointEqual()(lhs, rhs);
+  }
+
+  /// The same points in the same order.
+  inline bool samePath(const std::vector<PFB::point>& lhs,
+    const std::vector<PFB::point>& rhs)
+  {
+    return lhs.size() == rhs.size() && std::equal(lhs.begin(), lhs.end(), rhs.begin(), same);
+  }
+}
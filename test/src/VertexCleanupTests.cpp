@@ -0,0 +1,127 @@
+#include "catch.hpp"
+
+#include <algorithm>
+#include <vector>
+
+#include "../../src/VertexCleanup.hpp"
+#include "TestGeometry.hpp"
+
+using namespace std;
+using PFB::cleanVertices;
+using PFB::point;
+using PFB::VertexCleaner;
+using PFBTest::same;
+using PFBTest::samePath;
+
+TEST_CASE("Repeated vertices are dropped", "[VertexCleanup]")
+{
+  vector<point> pts{ point(35.0, -97.0), point(35.0, -97.0), point(35.1, -97.0),
+    point(35.1, -97.0), point(35.1, -97.0), point(35.1, -96.9) };
+  CHECK(cleanVertices(pts, -1) == 3);
+  CHECK(samePath(pts, { point(35.0, -97.0), point(35.1, -97.0), point(35.1, -96.9) }));
+
+  SECTION("Every vertex the same leaves a line of 2")
+  {
+    vector<point> dot(5, point(35.0, -97.0));
+    CHECK(cleanVertices(dot, -1) == 3);
+    CHECK(samePath(dot, { point(35.0, -97.0), point(35.0, -97.0) }));
+  }
+
+  SECTION("A single vertex is left alone")
+  {
+    vector<point> one{ point(35.0, -97.0) };
+    CHECK(cleanVertices(one, -1) == 0);
+    CHECK(one.size() == 1);
+  }
+}
+
+TEST_CASE("Vertices are rounded to the places written", "[VertexCleanup]")
+{
+  vector<point> pts{ point(35.12341, -97.12341), point(35.12344, -97.12339),
+    point(35.5, -97.12338) };
+  CHECK(cleanVertices(pts, 4) == 1);
+  REQUIRE(pts.size() == 2);
+  CHECK(pts[0].latitude == Approx(35.1234).epsilon(1.0e-12));
+  CHECK(pts[0].longitude == Approx(-97.1234).epsilon(1.0e-12));
+  CHECK(pts[1].latitude == Approx(35.5).epsilon(1.0e-12));
+
+  SECTION("Not when decimals is negative")
+  {
+    vector<point> exact{ point(35.12341, -97.12341), point(35.12344, -97.12339) };
+    CHECK(cleanVertices(exact, -1) == 0);
+    CHECK(samePath(exact, { point(35.12341, -97.12341), point(35.12344, -97.12339) }));
+  }
+}
+
+TEST_CASE("Straight runs and spikes are removed, corners kept", "[VertexCleanup]")
+{
+  SECTION("Straight runs")
+  {
+    vector<point> pts;
+    for (int i = 0; i <= 10; ++i) pts.push_back(point(35.0, -97.0 + i * 0.25));
+    for (int i = 1; i <= 10; ++i) pts.push_back(point(35.0 + i * 0.25, -94.5));
+    CHECK(cleanVertices(pts, 6) == 18);
+    CHECK(samePath(pts, { point(35.0, -97.0), point(35.0, -94.5), point(37.5, -94.5) }));
+  }
+
+  SECTION("A spike that doubles back")
+  {
+    vector<point> pts{ point(35.0, -97.0), point(35.0, -96.0), point(35.0, -96.5),
+      point(36.0, -96.5) };
+    CHECK(cleanVertices(pts, -1) == 1);
+    CHECK(samePath(pts, { point(35.0, -97.0), point(35.0, -96.5), point(36.0, -96.5) }));
+  }
+
+  SECTION("A line is not cut back to its first vertex")
+  {
+    vector<point> pts{ point(35.0, -97.0), point(35.0, -96.0), point(35.0, -97.0) };
+    cleanVertices(pts, -1);
+    CHECK(pts.size() >= 2);
+    CHECK(same(pts.front(), point(35.0, -97.0)));
+  }
+}
+
+TEST_CASE("A ring can lose its first vertex", "[VertexCleanup]")
+{
+  // A square starting halfway along a side.
+  const vector<point> square{ point(0, 1), point(0, 2), point(2, 2), point(2, 0),
+    point(0, 0), point(0, 1) };
+
+  vector<point> pts = square;
+  CHECK(cleanVertices(pts, -1) == 1);
+  CHECK(samePath(pts, { point(0, 2), point(2, 2), point(2, 0), point(0, 0), point(0, 2) }));
+
+  SECTION("Unless the ends are fixed")
+  {
+    vector<point> fixed = square;
+    CHECK(cleanVertices(fixed, -1, true) == 0);
+    CHECK(samePath(fixed, square));
+  }
+
+  SECTION("A ring with no area is not emptied")
+  {
+    vector<point> flat{ point(0, 1), point(0, 2), point(0, 3), point(0, 0), point(0, 1) };
+    cleanVertices(flat, -1);
+    CHECK(flat.size() >= 2);
+  }
+}
+
+TEST_CASE("VertexCleaner can drop only duplicates", "[VertexCleanup]")
+{
+  vector<point> out;
+  VertexCleaner cleaner(out, 4, true);
+  for (int i = 0; i <= 4; ++i)
+  {
+    cleaner.add(35.0, -97.0 + i * 0.5);
+    cleaner.add(35.00001, -97.0 + i * 0.5);
+  }
+  CHECK(cleaner.finish() == 5);
+  REQUIRE(out.size() == 5);
+  for (int i = 0; i <= 4; ++i) CHECK(out[i].longitude == Approx(-97.0 + i * 0.5));
+
+  SECTION("The output is cleared first")
+  {
+    VertexCleaner again(out, 4);
+    CHECK(out.empty());
+  }
+}